@@ -21,7 +21,7 @@ stage1.bin: boot/stage1/boot.asm
 stage2.bin: boot/stage2/stage2.asm
 	$(AS) -f bin $< -o $@
 
-kernel.bin: kernel/src/boot.s kernel/src/kernel.c kernel/src/memory.h kernel/src/pmm.h kernel/src/pmm.c kernel/src/idt.h kernel/src/idt.c kernel/src/idt_asm.s kernel/src/pic.h kernel/src/pic.c kernel/src/timer.h kernel/src/timer.c kernel/src/exceptions.c kernel/src/paging.h kernel/src/paging.c kernel/src/process.h kernel/src/process.c kernel/src/process_asm.s kernel/src/scheduler.h kernel/src/scheduler.c kernel/src/gdt.h kernel/src/gdt.c kernel/src/syscall.h kernel/src/syscall.c kernel/src/syscall_asm.s kernel/src/elf.h kernel/src/elf.c kernel/src/vfs.h kernel/src/vfs.c kernel/src/ata.h kernel/src/ata.c kernel/src/fs_simple.h kernel/src/fs_simple.c kernel/src/heap.h kernel/src/heap.c kernel/src/keyboard.h kernel/src/keyboard.c kernel/src/vga.h kernel/src/vga.c kernel/src/shell.h kernel/src/shell.c kernel/src/ipc.h kernel/src/ipc.c kernel/src/serial.h kernel/src/serial.c
+kernel.bin: kernel/src/boot.s kernel/src/kernel.c kernel/src/memory.h kernel/src/pmm.h kernel/src/pmm.c kernel/src/idt.h kernel/src/idt.c kernel/src/idt_asm.s kernel/src/pic.h kernel/src/pic.c kernel/src/timer.h kernel/src/timer.c kernel/src/exceptions.c kernel/src/paging.h kernel/src/paging.c kernel/src/process.h kernel/src/process.c kernel/src/process_asm.s kernel/src/scheduler.h kernel/src/scheduler.c kernel/src/gdt.h kernel/src/gdt.c kernel/src/syscall.h kernel/src/syscall.c kernel/src/syscall_asm.s kernel/src/elf.h kernel/src/elf.c kernel/src/vfs.h kernel/src/vfs.c kernel/src/ata.h kernel/src/ata.c kernel/src/fs_simple.h kernel/src/fs_simple.c kernel/src/heap.h kernel/src/heap.c kernel/src/keyboard.h kernel/src/keyboard.c kernel/src/vga.h kernel/src/vga.c kernel/src/shell.h kernel/src/shell.c kernel/src/ipc.h kernel/src/ipc.c kernel/src/serial.h kernel/src/serial.c kernel/src/cpu.h kernel/src/bench.h kernel/src/bench.c kernel/src/slab.h kernel/src/slab.c kernel/src/string.h kernel/src/string.c kernel/src/string_asm.s kernel/src/fpu.h kernel/src/fpu.c kernel/src/vdso.h kernel/src/vdso.c kernel/src/ring.h kernel/src/ring.c kernel/src/systrace.h kernel/src/systrace.c kernel/src/dcache.h kernel/src/dcache.c kernel/src/pagecache.h kernel/src/pagecache.c kernel/src/journal.h kernel/src/journal.c
 	$(CC) $(CFLAGS) -c kernel/src/boot.s -o kernel/src/boot.o
 	$(CC) $(CFLAGS) -c kernel/src/kernel.c -o kernel/src/kernel.o
 	$(CC) $(CFLAGS) -c kernel/src/pmm.c -o kernel/src/pmm.o
@@ -47,7 +47,18 @@ kernel.bin: kernel/src/boot.s kernel/src/kernel.c kernel/src/memory.h kernel/src
 	$(CC) $(CFLAGS) -c kernel/src/shell.c -o kernel/src/shell.o
 	$(CC) $(CFLAGS) -c kernel/src/ipc.c -o kernel/src/ipc.o
 	$(CC) $(CFLAGS) -c kernel/src/serial.c -o kernel/src/serial.o
-	$(LD) $(LDFLAGS) -o $@ kernel/src/boot.o kernel/src/kernel.o kernel/src/pmm.o kernel/src/idt.o kernel/src/idt_asm.o kernel/src/pic.o kernel/src/timer.o kernel/src/exceptions.o kernel/src/paging.o kernel/src/process.o kernel/src/process_asm.o kernel/src/scheduler.o kernel/src/gdt.o kernel/src/syscall.o kernel/src/syscall_asm.o kernel/src/elf.o kernel/src/vfs.o kernel/src/ata.o kernel/src/fs_simple.o kernel/src/heap.o kernel/src/keyboard.o kernel/src/vga.o kernel/src/shell.o kernel/src/ipc.o kernel/src/serial.o
+	$(CC) $(CFLAGS) -c kernel/src/bench.c -o kernel/src/bench.o
+	$(CC) $(CFLAGS) -c kernel/src/slab.c -o kernel/src/slab.o
+	$(CC) $(CFLAGS) -c kernel/src/string.c -o kernel/src/string.o
+	$(CC) $(CFLAGS) -c kernel/src/string_asm.s -o kernel/src/string_asm.o
+	$(CC) $(CFLAGS) -c kernel/src/fpu.c -o kernel/src/fpu.o
+	$(CC) $(CFLAGS) -c kernel/src/vdso.c -o kernel/src/vdso.o
+	$(CC) $(CFLAGS) -c kernel/src/ring.c -o kernel/src/ring.o
+	$(CC) $(CFLAGS) -c kernel/src/systrace.c -o kernel/src/systrace.o
+	$(CC) $(CFLAGS) -c kernel/src/dcache.c -o kernel/src/dcache.o
+	$(CC) $(CFLAGS) -c kernel/src/pagecache.c -o kernel/src/pagecache.o
+	$(CC) $(CFLAGS) -c kernel/src/journal.c -o kernel/src/journal.o
+	$(LD) $(LDFLAGS) -o $@ kernel/src/boot.o kernel/src/kernel.o kernel/src/pmm.o kernel/src/idt.o kernel/src/idt_asm.o kernel/src/pic.o kernel/src/timer.o kernel/src/exceptions.o kernel/src/paging.o kernel/src/process.o kernel/src/process_asm.o kernel/src/scheduler.o kernel/src/gdt.o kernel/src/syscall.o kernel/src/syscall_asm.o kernel/src/elf.o kernel/src/vfs.o kernel/src/ata.o kernel/src/fs_simple.o kernel/src/heap.o kernel/src/keyboard.o kernel/src/vga.o kernel/src/shell.o kernel/src/ipc.o kernel/src/serial.o kernel/src/bench.o kernel/src/slab.o kernel/src/string.o kernel/src/string_asm.o kernel/src/fpu.o kernel/src/vdso.o kernel/src/ring.o kernel/src/systrace.o kernel/src/dcache.o kernel/src/pagecache.o kernel/src/journal.o
 	$(OBJCOPY) -O binary $@ kernel-stripped.bin
 	mv kernel-stripped.bin $@
 
@@ -76,12 +76,8 @@ void ata_init(void) {
     }
 }
 
-// Read sectors from ATA device
-int ata_read_sectors(unsigned int lba, unsigned int count, unsigned char* buffer) {
-    if (count == 0) {
-        return 0;
-    }
-    
+// Issue a READ SECTORS command (count 1-256; 256 is sent as 0)
+static int ata_start_read(unsigned int lba, unsigned int count) {
     // Wait for device to be ready
     if (ata_wait_ready() != 0) {
         return -1;
@@ -100,30 +96,65 @@ int ata_read_sectors(unsigned int lba, unsigned int count, unsigned char* buffer
     
     // Send read command
     outb(ATA_PRIMARY_COMMAND, ATA_CMD_READ_PIO);
+    return 0;
+}
+
+// Transfer one sector from the data port
+static int ata_read_data(unsigned char* buffer) {
+    // Wait for data
+    if (ata_wait_data() != 0) {
+        return -1;
+    }
+    
+    // Read 256 words (512 bytes = 1 sector)
+    unsigned short* buf = (unsigned short*)buffer;
+    for (int j = 0; j < 256; j++) {
+        buf[j] = inw(ATA_PRIMARY_DATA);
+    }
+    return 0;
+}
+
+// Read sectors from ATA device
+int ata_read_sectors(unsigned int lba, unsigned int count, unsigned char* buffer) {
+    if (count == 0 || count > ATA_MAX_SECTORS) {
+        return count ? -1 : 0;
+    }
+    
+    if (ata_start_read(lba, count) != 0) {
+        return -1;
+    }
     
     // Read sectors
     for (unsigned int i = 0; i < count; i++) {
-        // Wait for data
-        if (ata_wait_data() != 0) {
+        if (ata_read_data(buffer + (i * 512)) != 0) {
             return -1;
         }
-        
-        // Read 256 words (512 bytes = 1 sector)
-        unsigned short* buf = (unsigned short*)(buffer + (i * 512));
-        for (int j = 0; j < 256; j++) {
-            buf[j] = inw(ATA_PRIMARY_DATA);
-        }
     }
     
     return count;
 }
 
-// Write sectors to ATA device
-int ata_write_sectors(unsigned int lba, unsigned int count, unsigned char* buffer) {
-    if (count == 0) {
-        return 0;
+// Read sectors into separate buffers with a single command
+int ata_read_sectors_vec(unsigned int lba, unsigned int count, unsigned char** buffers) {
+    if (count == 0 || count > ATA_MAX_SECTORS) {
+        return count ? -1 : 0;
     }
     
+    if (ata_start_read(lba, count) != 0) {
+        return -1;
+    }
+    
+    for (unsigned int i = 0; i < count; i++) {
+        if (ata_read_data(buffers[i]) != 0) {
+            return -1;
+        }
+    }
+    
+    return count;
+}
+
+// Issue a WRITE SECTORS command (count 1-256; 256 is sent as 0)
+static int ata_start_write(unsigned int lba, unsigned int count) {
     // Wait for device to be ready
     if (ata_wait_ready() != 0) {
         return -1;
@@ -142,29 +173,79 @@ int ata_write_sectors(unsigned int lba, unsigned int count, unsigned char* buffe
     
     // Send write command
     outb(ATA_PRIMARY_COMMAND, ATA_CMD_WRITE_PIO);
+    return 0;
+}
+
+// Transfer one sector to the data port
+static int ata_write_data(const unsigned char* buffer) {
+    // Wait for data request
+    if (ata_wait_data() != 0) {
+        return -1;
+    }
+    
+    // Write 256 words (512 bytes = 1 sector)
+    const unsigned short* buf = (const unsigned short*)buffer;
+    for (int j = 0; j < 256; j++) {
+        outw(ATA_PRIMARY_DATA, buf[j]);
+    }
+    return 0;
+}
+
+// Wait for the last sector of a write, then flush the drive's write cache
+// Done once per command: the drive expects the sectors back to back
+static int ata_finish_write(void) {
+    if (ata_wait_ready() != 0) {
+        return -1;
+    }
+    
+    outb(ATA_PRIMARY_COMMAND, ATA_CMD_CACHE_FLUSH);
+    return ata_wait_ready();
+}
+
+// Write sectors to ATA device
+int ata_write_sectors(unsigned int lba, unsigned int count, unsigned char* buffer) {
+    if (count == 0 || count > ATA_MAX_SECTORS) {
+        return count ? -1 : 0;
+    }
+    
+    if (ata_start_write(lba, count) != 0) {
+        return -1;
+    }
     
     // Write sectors
     for (unsigned int i = 0; i < count; i++) {
-        // Wait for data request
-        if (ata_wait_data() != 0) {
+        if (ata_write_data(buffer + (i * 512)) != 0) {
             return -1;
         }
-        
-        // Write 256 words (512 bytes = 1 sector)
-        unsigned short* buf = (unsigned short*)(buffer + (i * 512));
-        for (int j = 0; j < 256; j++) {
-            outw(ATA_PRIMARY_DATA, buf[j]);
-        }
-        
-        // Flush cache
-        outb(ATA_PRIMARY_COMMAND, 0xE7);
-        
-        // Wait for completion
-        if (ata_wait_ready() != 0) {
+    }
+    
+    if (ata_finish_write() != 0) {
+        return -1;
+    }
+    
+    return count;
+}
+
+// Write sectors from separate buffers with a single command
+int ata_write_sectors_vec(unsigned int lba, unsigned int count, unsigned char** buffers) {
+    if (count == 0 || count > ATA_MAX_SECTORS) {
+        return count ? -1 : 0;
+    }
+    
+    if (ata_start_write(lba, count) != 0) {
+        return -1;
+    }
+    
+    for (unsigned int i = 0; i < count; i++) {
+        if (ata_write_data(buffers[i]) != 0) {
             return -1;
         }
     }
     
+    if (ata_finish_write() != 0) {
+        return -1;
+    }
+    
     return count;
 }
 
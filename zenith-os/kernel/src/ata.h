@@ -19,6 +19,7 @@
 #define ATA_CMD_WRITE_PIO      0x30
 #define ATA_CMD_WRITE_PIO_EXT  0x34
 #define ATA_CMD_IDENTIFY       0xEC
+#define ATA_CMD_CACHE_FLUSH    0xE7
 
 // ATA status bits
 #define ATA_SR_BSY     0x80    // Busy
@@ -30,15 +31,26 @@
 #define ATA_SR_IDX     0x02    // Index
 #define ATA_SR_ERR     0x01    // Error
 
+// Largest transfer a single command can do (sector count 0 means 256)
+#define ATA_MAX_SECTORS 256
+
 // Initialize ATA driver
 void ata_init(void);
 
 // Read sectors from ATA device
 int ata_read_sectors(unsigned int lba, unsigned int count, unsigned char* buffer);
 
+// Read sectors from ATA device, sector i going to buffers[i]
+// One command for the whole run, so scattered pages cost no extra seeks
+int ata_read_sectors_vec(unsigned int lba, unsigned int count, unsigned char** buffers);
+
 // Write sectors to ATA device
 int ata_write_sectors(unsigned int lba, unsigned int count, unsigned char* buffer);
 
+// Write sectors to ATA device, sector i coming from buffers[i]
+// Lets adjacent pages of a file go out as one long transfer
+int ata_write_sectors_vec(unsigned int lba, unsigned int count, unsigned char** buffers);
+
 // Get device information
 int ata_identify(unsigned char* buffer);
 
@@ -0,0 +1,381 @@
+#include "bench.h"
+#include "cpu.h"
+#include "pmm.h"
+#include "paging.h"
+#include "process.h"
+#include "vga.h"
+#include "serial.h"
+#include "string.h"
+#include "fpu.h"
+
+// Virtual address the scratch address spaces are populated at
+#define BENCH_USER_BASE 0x10000000
+
+// Benchmark table entry
+typedef struct {
+    const char* name;
+    const char* description;
+    int (*run)(void);
+} bench_t;
+
+// Local string compare (no libc in the kernel)
+static int bench_strcmp(const char* s1, const char* s2) {
+    while (*s1 && (*s1 == *s2)) {
+        s1++;
+        s2++;
+    }
+    return *(unsigned char*)s1 - *(unsigned char*)s2;
+}
+
+// Print a string to the screen and the serial console
+void bench_print(const char* str) {
+    vga_print(str);
+    serial_write(COM1_BASE, str);
+}
+
+// Print an unsigned decimal number
+void bench_print_uint(unsigned int value) {
+    char buf[16];
+    int i = 15;
+    buf[i] = '\0';
+    do {
+        buf[--i] = '0' + (value % 10);
+        value /= 10;
+    } while (value > 0);
+    bench_print(&buf[i]);
+}
+
+// Print a cycle count (falls back to Mcycles if it does not fit 32 bits)
+void bench_print_cycles(unsigned long long cycles) {
+    if (cycles >> 32) {
+        bench_print_uint((unsigned int)(cycles >> 20));
+        bench_print("M");
+    } else {
+        bench_print_uint((unsigned int)cycles);
+    }
+}
+
+// Build a scratch address space with `pages` private, written user pages
+// Returns NULL if memory runs out
+static page_directory_t* bench_make_space(unsigned int pages) {
+    unsigned long long dir_phys = pmm_alloc_page();
+    if (!dir_phys) {
+        return 0;
+    }
+    
+    page_directory_t* dir = (page_directory_t*)(unsigned int)dir_phys;
+    clear_page(dir);
+    dir->entries[0] = paging_get_directory()->entries[0];
+    
+    for (unsigned int i = 0; i < pages; i++) {
+        unsigned long long frame = pmm_alloc_page();
+        if (!frame || paging_map_page_dir(dir, BENCH_USER_BASE + i * PAGE_SIZE, (unsigned int)frame,
+                                          PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER) != 0) {
+            if (frame) {
+                pmm_free_page(frame);
+            }
+            process_free_user_space(dir);
+            pmm_free_page(dir_phys);
+            return 0;
+        }
+        pmm_get_page(frame)->flags |= PG_USER;
+        *(unsigned int*)(unsigned int)frame = i;
+    }
+    
+    return dir;
+}
+
+// Release a scratch address space
+static void bench_free_space(page_directory_t* dir) {
+    process_free_user_space(dir);
+    pmm_free_page((unsigned long long)(unsigned int)dir);
+}
+
+// Benchmark: fork address-space duplication, eager copy vs copy-on-write
+static int bench_fork(void) {
+    static const unsigned int sizes_mb[] = { 1, 4, 16 };
+    
+    bench_print("fork: cycles to duplicate a parent address space\n");
+    bench_print("  size   eager-copy   cow-clone   cow+touch-all\n");
+    
+    for (unsigned int s = 0; s < sizeof(sizes_mb) / sizeof(sizes_mb[0]); s++) {
+        unsigned int pages = sizes_mb[s] * 256;
+        
+        page_directory_t* parent = bench_make_space(pages);
+        page_directory_t* child = parent ? bench_make_space(0) : 0;
+        if (!child) {
+            if (parent) {
+                bench_free_space(parent);
+            }
+            bench_print("  out of memory\n");
+            return -1;
+        }
+        
+        // Eager: what process_fork used to do
+        unsigned long long t0 = cpu_rdtsc();
+        int err = process_clone_user_space(child, parent, 0);
+        unsigned long long eager = cpu_rdtsc() - t0;
+        process_free_user_space(child);
+        
+        // Copy-on-write: what process_fork does now
+        t0 = cpu_rdtsc();
+        err |= process_clone_user_space(child, parent, 1);
+        unsigned long long cow = cpu_rdtsc() - t0;
+        
+        // Worst case for COW: the child writes every page afterwards
+        page_directory_t* saved = paging_get_directory();
+        t0 = cpu_rdtsc();
+        paging_switch_directory(child);
+        for (unsigned int i = 0; i < pages; i++) {
+            *(volatile unsigned int*)(BENCH_USER_BASE + i * PAGE_SIZE) += 1;
+        }
+        paging_switch_directory(saved);
+        unsigned long long touch = cpu_rdtsc() - t0;
+        
+        bench_free_space(child);
+        bench_free_space(parent);
+        
+        if (err) {
+            bench_print("  out of memory\n");
+            return -1;
+        }
+        
+        bench_print("  ");
+        bench_print_uint(sizes_mb[s]);
+        bench_print("MB   ");
+        bench_print_cycles(eager);
+        bench_print("   ");
+        bench_print_cycles(cow);
+        bench_print("   ");
+        bench_print_cycles(cow + touch);
+        bench_print("\n");
+    }
+    
+    return 0;
+}
+
+// Memory benchmark buffer size (pages) and passes over it
+#define BENCH_MEM_PAGES 64
+#define BENCH_MEM_PASSES 4
+
+// Print bytes per cycle with two decimals
+static void bench_print_rate(unsigned int bytes, unsigned long long cycles) {
+    if (cycles == 0 || (cycles >> 32)) {
+        bench_print("n/a");
+        return;
+    }
+    unsigned int rate = (bytes * 100) / (unsigned int)cycles;
+    bench_print_uint(rate / 100);
+    bench_print(".");
+    if (rate % 100 < 10) {
+        bench_print("0");
+    }
+    bench_print_uint(rate % 100);
+}
+
+// Report one measured variant
+static void bench_mem_report(const char* name, unsigned int bytes, unsigned long long cycles) {
+    bench_print("  ");
+    bench_print(name);
+    bench_print(": ");
+    bench_print_rate(bytes, cycles);
+    bench_print(" bytes/cycle\n");
+}
+
+// Benchmark: memory primitives, every variant, in bytes per cycle
+static int bench_mem(void) {
+    const unsigned int size = BENCH_MEM_PAGES * PAGE_SIZE;
+    const unsigned int bytes = size * BENCH_MEM_PASSES;
+    
+    unsigned long long src_phys = pmm_alloc_pages(BENCH_MEM_PAGES);
+    unsigned long long dst_phys = pmm_alloc_pages(BENCH_MEM_PAGES);
+    if (!src_phys || !dst_phys) {
+        if (src_phys) {
+            pmm_free_pages(src_phys, BENCH_MEM_PAGES);
+        }
+        if (dst_phys) {
+            pmm_free_pages(dst_phys, BENCH_MEM_PAGES);
+        }
+        bench_print("mem: out of memory\n");
+        return -1;
+    }
+    
+    unsigned char* src = (unsigned char*)(unsigned int)src_phys;
+    unsigned char* dst = (unsigned char*)(unsigned int)dst_phys;
+    memset_rep(src, 0x5A, size);
+    memset_rep(dst, 0, size);
+    
+    bench_print("mem: ");
+    bench_print_uint(size / 1024);
+    bench_print("KB buffers, ");
+    bench_print(string_has_sse2() ? "SSE2 available\n" : "no SSE2\n");
+    
+    int variants = string_has_sse2() ? 2 : 1;
+    for (int v = 0; v < variants; v++) {
+        unsigned long long t0 = cpu_rdtsc();
+        for (int pass = 0; pass < BENCH_MEM_PASSES; pass++) {
+            if (v == 0) {
+                memcpy_rep(dst, src, size);
+            } else {
+                unsigned int flags = kernel_fpu_begin();
+                memcpy_sse2_nt(dst, src, size);
+                kernel_fpu_end(flags);
+            }
+        }
+        bench_mem_report(v == 0 ? "memcpy rep movsd     " : "memcpy sse2 nt       ", bytes, cpu_rdtsc() - t0);
+        
+        t0 = cpu_rdtsc();
+        for (int pass = 0; pass < BENCH_MEM_PASSES; pass++) {
+            if (v == 0) {
+                memset_rep(dst, 0, size);
+            } else {
+                unsigned int flags = kernel_fpu_begin();
+                memset_sse2_nt(dst, 0, size);
+                kernel_fpu_end(flags);
+            }
+        }
+        bench_mem_report(v == 0 ? "memset rep stosd     " : "memset sse2 nt       ", bytes, cpu_rdtsc() - t0);
+        
+        t0 = cpu_rdtsc();
+        for (int pass = 0; pass < BENCH_MEM_PASSES; pass++) {
+            for (unsigned int off = 0; off < size; off += PAGE_SIZE) {
+                if (v == 0) {
+                    copy_page_rep(dst + off, src + off);
+                } else {
+                    unsigned int flags = kernel_fpu_begin();
+                    copy_page_sse2_nt(dst + off, src + off);
+                    kernel_fpu_end(flags);
+                }
+            }
+        }
+        bench_mem_report(v == 0 ? "copy_page rep movsd  " : "copy_page sse2 nt    ", bytes, cpu_rdtsc() - t0);
+        
+        t0 = cpu_rdtsc();
+        for (int pass = 0; pass < BENCH_MEM_PASSES; pass++) {
+            for (unsigned int off = 0; off < size; off += PAGE_SIZE) {
+                if (v == 0) {
+                    clear_page_rep(dst + off);
+                } else {
+                    unsigned int flags = kernel_fpu_begin();
+                    clear_page_sse2_nt(dst + off);
+                    kernel_fpu_end(flags);
+                }
+            }
+        }
+        bench_mem_report(v == 0 ? "clear_page rep stosd " : "clear_page sse2 nt   ", bytes, cpu_rdtsc() - t0);
+    }
+    
+    // Byte loop baseline (what the kernel used before)
+    unsigned long long t0 = cpu_rdtsc();
+    for (int pass = 0; pass < BENCH_MEM_PASSES; pass++) {
+        for (unsigned int i = 0; i < size; i++) {
+            ((volatile unsigned char*)dst)[i] = src[i];
+        }
+    }
+    bench_mem_report("byte loop copy       ", bytes, cpu_rdtsc() - t0);
+    
+    pmm_free_pages(src_phys, BENCH_MEM_PAGES);
+    pmm_free_pages(dst_phys, BENCH_MEM_PAGES);
+    return 0;
+}
+
+// Yield ping-pong rounds per thread
+#define BENCH_YIELD_ROUNDS 10000
+
+// Ping-pong state (one done flag per thread so no read-modify-write is shared)
+static volatile unsigned int g_yield_done[2];
+static volatile unsigned long long g_yield_end;
+
+// Ping-pong thread: every yield hands the CPU to the other thread
+static void bench_yield_thread(void* arg) {
+    volatile unsigned int* done = (volatile unsigned int*)arg;
+    
+    for (unsigned int i = 0; i < BENCH_YIELD_ROUNDS; i++) {
+        process_yield();
+    }
+    
+    g_yield_end = cpu_rdtsc(); // Last thread to finish sets the final value
+    *done = 1;
+}
+
+// Context switch latency: two kernel threads yielding to each other
+static int bench_yield(void) {
+    if (process_get_current()) {
+        bench_print("yield: must be run from the kernel shell\n");
+        return -1;
+    }
+    
+    g_yield_done[0] = 0;
+    g_yield_done[1] = 0;
+    
+    process_t* a = kthread_create("yield-a", bench_yield_thread, (void*)&g_yield_done[0]);
+    process_t* b = a ? kthread_create("yield-b", bench_yield_thread, (void*)&g_yield_done[1]) : 0;
+    if (!b) {
+        if (a) {
+            process_destroy(a);
+        }
+        bench_print("yield: out of memory\n");
+        return -1;
+    }
+    
+    // The shell gets the CPU back once both threads have exited
+    unsigned long long t0 = cpu_rdtsc();
+    while (!g_yield_done[0] || !g_yield_done[1]) {
+        process_yield();
+    }
+    unsigned long long cycles = g_yield_end - t0;
+    
+    // Each round is one switch in each direction
+    unsigned int switches = 2 * BENCH_YIELD_ROUNDS;
+    
+    bench_print("yield: ");
+    bench_print_uint(switches);
+    bench_print(" switches in ");
+    bench_print_cycles(cycles);
+    bench_print(" cycles, ");
+    
+    // Scale down to 32 bits before dividing (no 64-bit division in the kernel)
+    while (cycles >> 32) {
+        cycles >>= 1;
+        switches >>= 1;
+    }
+    bench_print_uint((unsigned int)cycles / switches);
+    bench_print(" cycles/switch\n");
+    
+    return 0;
+}
+
+// Registered benchmarks
+static const bench_t g_benchmarks[] = {
+    { "fork",  "fork address-space copy: eager vs COW (1/4/16MB)", bench_fork },
+    { "mem",   "memcpy/memset/copy_page/clear_page bytes per cycle", bench_mem },
+    { "yield", "context switch latency (yield ping-pong, 2 kthreads)", bench_yield },
+};
+
+#define BENCH_COUNT (sizeof(g_benchmarks) / sizeof(g_benchmarks[0]))
+
+// List benchmarks
+void bench_list(void) {
+    bench_print("Benchmarks:\n");
+    for (unsigned int i = 0; i < BENCH_COUNT; i++) {
+        bench_print("  ");
+        bench_print(g_benchmarks[i].name);
+        bench_print(" - ");
+        bench_print(g_benchmarks[i].description);
+        bench_print("\n");
+    }
+}
+
+// Run a benchmark by name
+int bench_run(const char* name) {
+    for (unsigned int i = 0; i < BENCH_COUNT; i++) {
+        if (bench_strcmp(name, g_benchmarks[i].name) == 0) {
+            return g_benchmarks[i].run();
+        }
+    }
+    
+    bench_print("Unknown benchmark: ");
+    bench_print(name);
+    bench_print("\n");
+    return -1;
+}
@@ -0,0 +1,16 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Run a named in-kernel benchmark, printing results to VGA and COM1
+// Returns 0 on success, -1 if the benchmark does not exist or failed
+int bench_run(const char* name);
+
+// Print the list of available benchmarks
+void bench_list(void);
+
+// Print helpers shared by benchmark code (VGA and COM1)
+void bench_print(const char* str);
+void bench_print_uint(unsigned int value);
+void bench_print_cycles(unsigned long long cycles);
+
+#endif // BENCH_H
@@ -0,0 +1,93 @@
+#ifndef CPU_H
+#define CPU_H
+
+// Read the time-stamp counter (cycles since reset)
+static inline unsigned long long cpu_rdtsc(void) {
+    unsigned int lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+// CPUID feature bits (leaf 1, EDX)
+#define CPUID_EDX_FPU   (1 << 0)
+#define CPUID_EDX_TSC   (1 << 4)
+#define CPUID_EDX_MSR   (1 << 5)
+#define CPUID_EDX_SEP   (1 << 11)   // SYSENTER/SYSEXIT
+#define CPUID_EDX_FXSR  (1 << 24)   // FXSAVE/FXRSTOR
+#define CPUID_EDX_SSE   (1 << 25)
+#define CPUID_EDX_SSE2  (1 << 26)
+
+// Control register bits
+#define CR0_MP          (1 << 1)    // Monitor coprocessor
+#define CR0_EM          (1 << 2)    // x87 emulation
+#define CR0_TS          (1 << 3)    // Task switched
+#define CR4_OSFXSR      (1 << 9)    // OS supports FXSAVE/FXRSTOR (enables SSE)
+#define CR4_OSXMMEXCPT  (1 << 10)   // OS handles SIMD floating-point exceptions
+
+// Model-specific registers
+#define MSR_SYSENTER_CS   0x174     // Kernel CS for SYSENTER (SS = CS + 8)
+#define MSR_SYSENTER_ESP  0x175     // ESP loaded by SYSENTER
+#define MSR_SYSENTER_EIP  0x176     // Entry point for SYSENTER
+
+// Execute CPUID
+static inline void cpu_cpuid(unsigned int leaf, unsigned int* eax, unsigned int* ebx,
+                             unsigned int* ecx, unsigned int* edx) {
+    asm volatile ("cpuid"
+                  : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                  : "a"(leaf), "c"(0));
+}
+
+// Feature flags from CPUID leaf 1 EDX
+static inline unsigned int cpu_features_edx(void) {
+    unsigned int eax, ebx, ecx, edx;
+    cpu_cpuid(1, &eax, &ebx, &ecx, &edx);
+    return edx;
+}
+
+// Control register access
+static inline unsigned int cpu_read_cr0(void) {
+    unsigned int value;
+    asm volatile ("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static inline void cpu_write_cr0(unsigned int value) {
+    asm volatile ("mov %0, %%cr0" : : "r"(value));
+}
+
+static inline unsigned int cpu_read_cr4(void) {
+    unsigned int value;
+    asm volatile ("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+static inline void cpu_write_cr4(unsigned int value) {
+    asm volatile ("mov %0, %%cr4" : : "r"(value));
+}
+
+// Model-specific register access
+static inline unsigned long long cpu_rdmsr(unsigned int msr) {
+    unsigned int lo, hi;
+    asm volatile ("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+static inline void cpu_wrmsr(unsigned int msr, unsigned long long value) {
+    asm volatile ("wrmsr" : : "c"(msr), "a"((unsigned int)value), "d"((unsigned int)(value >> 32)));
+}
+
+// Disable interrupts, returning the previous EFLAGS for cpu_irq_restore
+static inline unsigned int cpu_irq_save(void) {
+    unsigned int flags;
+    asm volatile ("pushf\n\tpop %0\n\tcli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+// Re-enable interrupts if they were enabled when cpu_irq_save was called
+static inline void cpu_irq_restore(unsigned int flags) {
+    if (flags & 0x200) {
+        asm volatile ("sti" : : : "memory");
+    }
+}
+
+#endif // CPU_H
@@ -0,0 +1,202 @@
+#include "dcache.h"
+#include "string.h"
+#include "cpu.h"
+
+// Entry pool, hash table and LRU list (head = most recently used)
+static dentry_t g_dentries[DCACHE_ENTRIES];
+static dentry_t* g_buckets[DCACHE_BUCKETS];
+static dentry_t* g_lru_head = 0;
+static dentry_t* g_lru_tail = 0;
+
+static dcache_stats_t g_stats;
+
+// FNV-1a over the name, seeded with the parent pointer
+static unsigned int dcache_hash(vfs_node_t* parent, const char* name, unsigned int name_len) {
+    unsigned int hash = 2166136261u ^ ((unsigned int)parent >> 4);
+    for (unsigned int i = 0; i < name_len; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Unlink an entry from the LRU list
+static void lru_remove(dentry_t* d) {
+    if (d->lru_prev) {
+        d->lru_prev->lru_next = d->lru_next;
+    } else {
+        g_lru_head = d->lru_next;
+    }
+    if (d->lru_next) {
+        d->lru_next->lru_prev = d->lru_prev;
+    } else {
+        g_lru_tail = d->lru_prev;
+    }
+    d->lru_prev = 0;
+    d->lru_next = 0;
+}
+
+// Put an entry at the most-recently-used end
+static void lru_push_front(dentry_t* d) {
+    d->lru_prev = 0;
+    d->lru_next = g_lru_head;
+    if (g_lru_head) {
+        g_lru_head->lru_prev = d;
+    } else {
+        g_lru_tail = d;
+    }
+    g_lru_head = d;
+}
+
+// Unlink an entry from its hash bucket
+static void hash_remove(dentry_t* d) {
+    dentry_t** link = &g_buckets[d->hash & (DCACHE_BUCKETS - 1)];
+    while (*link) {
+        if (*link == d) {
+            *link = d->hash_next;
+            break;
+        }
+        link = &(*link)->hash_next;
+    }
+    d->hash_next = 0;
+}
+
+// Find the entry for (parent, name) in the hash table
+static dentry_t* dcache_find(vfs_node_t* parent, const char* name, unsigned int name_len, unsigned int hash) {
+    for (dentry_t* d = g_buckets[hash & (DCACHE_BUCKETS - 1)]; d; d = d->hash_next) {
+        if (d->hash == hash && d->parent == parent && d->name_len == name_len &&
+            memcmp(d->name, name, name_len) == 0) {
+            return d;
+        }
+    }
+    return 0;
+}
+
+// Release an entry back to the free end of the LRU list
+static void dcache_drop(dentry_t* d) {
+    hash_remove(d);
+    d->parent = 0;
+    d->node = 0;
+    g_stats.entries--;
+    
+    // Free entries sit at the tail so they are reused before live ones
+    lru_remove(d);
+    d->lru_prev = g_lru_tail;
+    if (g_lru_tail) {
+        g_lru_tail->lru_next = d;
+    } else {
+        g_lru_head = d;
+    }
+    g_lru_tail = d;
+}
+
+// Initialize the dentry cache
+void dcache_init(void) {
+    memset(g_dentries, 0, sizeof(g_dentries));
+    memset(g_buckets, 0, sizeof(g_buckets));
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_lru_head = 0;
+    g_lru_tail = 0;
+    
+    for (int i = 0; i < DCACHE_ENTRIES; i++) {
+        lru_push_front(&g_dentries[i]);
+    }
+}
+
+// Look up name in parent
+int dcache_lookup(vfs_node_t* parent, const char* name, unsigned int name_len, vfs_node_t** node) {
+    if (name_len > DCACHE_NAME_MAX) {
+        g_stats.misses++;
+        return 0;
+    }
+    
+    unsigned int flags = cpu_irq_save();
+    dentry_t* d = dcache_find(parent, name, name_len, dcache_hash(parent, name, name_len));
+    if (!d) {
+        g_stats.misses++;
+        cpu_irq_restore(flags);
+        return 0;
+    }
+    
+    // Move to the front of the LRU list
+    if (d != g_lru_head) {
+        lru_remove(d);
+        lru_push_front(d);
+    }
+    
+    if (d->node) {
+        g_stats.hits++;
+    } else {
+        g_stats.negative_hits++;
+    }
+    *node = d->node;
+    cpu_irq_restore(flags);
+    return 1;
+}
+
+// Insert or update (parent, name) -> node
+void dcache_add(vfs_node_t* parent, const char* name, unsigned int name_len, vfs_node_t* node) {
+    if (!parent || name_len > DCACHE_NAME_MAX) {
+        return;
+    }
+    
+    unsigned int flags = cpu_irq_save();
+    unsigned int hash = dcache_hash(parent, name, name_len);
+    
+    dentry_t* d = dcache_find(parent, name, name_len, hash);
+    if (d) {
+        // Existing entry (e.g. a negative one for a name just created)
+        d->node = node;
+        lru_remove(d);
+        lru_push_front(d);
+        cpu_irq_restore(flags);
+        return;
+    }
+    
+    // Recycle the least recently used entry
+    d = g_lru_tail;
+    if (d->parent) {
+        hash_remove(d);
+        g_stats.evictions++;
+    } else {
+        g_stats.entries++;
+    }
+    lru_remove(d);
+    
+    d->parent = parent;
+    d->node = node;
+    d->hash = hash;
+    d->name_len = name_len;
+    memcpy(d->name, name, name_len);
+    d->name[name_len] = '\0';
+    
+    unsigned int bucket = hash & (DCACHE_BUCKETS - 1);
+    d->hash_next = g_buckets[bucket];
+    g_buckets[bucket] = d;
+    lru_push_front(d);
+    
+    cpu_irq_restore(flags);
+}
+
+// Drop every entry that points at node or lives in node
+void dcache_invalidate_node(vfs_node_t* node) {
+    if (!node) {
+        return;
+    }
+    
+    unsigned int flags = cpu_irq_save();
+    for (int i = 0; i < DCACHE_ENTRIES; i++) {
+        dentry_t* d = &g_dentries[i];
+        if (d->parent && (d->node == node || d->parent == node)) {
+            dcache_drop(d);
+        }
+    }
+    cpu_irq_restore(flags);
+}
+
+// Get cache statistics
+void dcache_get_stats(dcache_stats_t* stats) {
+    if (stats) {
+        *stats = g_stats;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef DCACHE_H
+#define DCACHE_H
+
+#include "vfs.h"
+
+// Directory entry cache: maps (parent directory, name) to the child node
+// so path walks skip finddir scans. Misses are cached too (negative entries).
+
+#define DCACHE_ENTRIES   256          // Cached entries (LRU-evicted)
+#define DCACHE_BUCKETS   128          // Hash buckets (power of two)
+#define DCACHE_NAME_MAX  59           // Longer components bypass the cache
+
+// Cache entry
+typedef struct dentry {
+    vfs_node_t* parent;               // Directory the name lives in (NULL = free entry)
+    vfs_node_t* node;                 // Target node, NULL for a negative entry
+    unsigned int hash;                // Hash of (parent, name)
+    unsigned int name_len;            // Length of name
+    char name[DCACHE_NAME_MAX + 1];   // Component name
+    struct dentry* hash_next;         // Next entry in the bucket
+    struct dentry* lru_prev;          // More recently used entry
+    struct dentry* lru_next;          // Less recently used entry
+} dentry_t;
+
+// Cache statistics
+typedef struct {
+    unsigned int hits;                // Positive lookups served from the cache
+    unsigned int negative_hits;       // Lookups answered "does not exist" from the cache
+    unsigned int misses;              // Lookups that fell through to finddir
+    unsigned int evictions;           // Entries recycled by LRU
+    unsigned int entries;             // Entries currently in use
+} dcache_stats_t;
+
+// Initialize the dentry cache
+void dcache_init(void);
+
+// Look up name (name_len bytes, not NUL-terminated) in parent
+// Returns 1 on a hit with *node set (NULL for a negative entry), 0 on a miss
+int dcache_lookup(vfs_node_t* parent, const char* name, unsigned int name_len, vfs_node_t** node);
+
+// Insert or update (parent, name) -> node; node == NULL records a negative entry
+void dcache_add(vfs_node_t* parent, const char* name, unsigned int name_len, vfs_node_t* node);
+
+// Drop every entry that points at node or lives in node (before node is freed)
+void dcache_invalidate_node(vfs_node_t* node);
+
+// Get cache statistics
+void dcache_get_stats(dcache_stats_t* stats);
+
+#endif // DCACHE_H
@@ -2,6 +2,7 @@
 #include "paging.h"
 #include "pmm.h"
 #include "memory.h"
+#include "string.h"
 
 // Load an ELF executable
 unsigned int elf_load(void* elf_data, unsigned int size) {
@@ -60,19 +61,11 @@ unsigned int elf_load(void* elf_data, unsigned int size) {
                                PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER);
                 
                 // Clear page
-                unsigned char* page = (unsigned char*)page_vaddr;
-                for (unsigned int k = 0; k < PAGE_SIZE; k++) {
-                    page[k] = 0;
-                }
+                clear_page((void*)page_vaddr);
             }
             
             // Copy segment data
-            unsigned char* src = (unsigned char*)elf_data + phdr[i].p_offset;
-            unsigned char* dst = (unsigned char*)vaddr;
-            
-            for (unsigned int j = 0; j < filesz; j++) {
-                dst[j] = src[j];
-            }
+            memcpy((void*)vaddr, (unsigned char*)elf_data + phdr[i].p_offset, filesz);
         }
     }
     
@@ -1,5 +1,6 @@
 #include "idt.h"
 #include "memory.h"
+#include "process.h"
 
 // Simple VGA text output (declared in kernel.c, but we'll use our own)
 static void print_string_at(const char* str, int row, int col) {
@@ -48,6 +49,11 @@ void exception_handler_6(void) {
 }
 
 void exception_handler_7(void) {
+    // Lazy FPU switch: load the current process's FPU/SSE state and retry
+    if (fpu_handle_nm() == 0) {
+        return;
+    }
+    
     print_string_at("EXCEPTION: Device Not Available", 24, 0);
     while (1) asm volatile ("hlt");
 }
@@ -87,9 +93,13 @@ void exception_handler_14(void) {
     unsigned int faulting_address;
     asm volatile ("mov %%cr2, %0" : "=r"(faulting_address));
     
-    // Get page fault error code from stack (pushed by CPU)
-    unsigned int error_code;
-    asm volatile ("mov 4(%%esp), %0" : "=r"(error_code));
+    // Get page fault error code (pushed by CPU, saved by the ISR stub)
+    unsigned int error_code = idt_get_error_code();
+    
+    // Copy-on-write faults are resolved and the access retried
+    if (process_handle_page_fault(faulting_address, error_code) == 0) {
+        return;
+    }
     
     print_string_at("EXCEPTION: Page Fault", 24, 0);
     
@@ -0,0 +1,183 @@
+#include "fpu.h"
+#include "cpu.h"
+#include "process.h"
+#include "slab.h"
+#include "string.h"
+
+// Process whose state is currently loaded in the FPU registers (NULL if none)
+static process_t* g_fpu_owner = 0;
+
+// Slab cache for FXSAVE areas
+static kmem_cache_t* g_fpu_cache = 0;
+
+// Lazy switching is only enabled with FXSAVE/FXRSTOR support
+static int g_fpu_lazy = 0;
+
+// Bit kernel_fpu_begin adds to the saved EFLAGS when it cleared CR0.TS
+// (EFLAGS bit 31 is reserved and always reads as 0)
+#define KERNEL_FPU_STTS 0x80000000
+
+// CR0 numeric error bit (report x87 errors through #MF)
+#define CR0_NE (1 << 5)
+
+// Set / clear CR0.TS
+static inline void fpu_stts(void) {
+    cpu_write_cr0(cpu_read_cr0() | CR0_TS);
+}
+
+static inline void fpu_clts(void) {
+    asm volatile ("clts");
+}
+
+// Save / restore register state
+static inline void fpu_fxsave(fpu_state_t* state) {
+    asm volatile ("fxsave (%0)" : : "r"(state) : "memory");
+}
+
+static inline void fpu_fxrstor(fpu_state_t* state) {
+    asm volatile ("fxrstor (%0)" : : "r"(state) : "memory");
+}
+
+// Reset the FPU to its power-on state for a process that has never used it
+static inline void fpu_reset(void) {
+    unsigned int mxcsr = FPU_DEFAULT_MXCSR;
+    asm volatile ("fninit");
+    asm volatile ("ldmxcsr %0" : : "m"(mxcsr));
+}
+
+// Initialize lazy FPU management
+void fpu_init(void) {
+    if (!(cpu_features_edx() & CPUID_EDX_FXSR)) {
+        return; // No FXSAVE: leave the FPU untouched as before
+    }
+    
+    if (!g_fpu_cache) {
+        g_fpu_cache = kmem_cache_create("fpu_state", sizeof(fpu_state_t), 0);
+    }
+    
+    // Native x87 errors, FPU present, FXSAVE enabled
+    cpu_write_cr0((cpu_read_cr0() & ~CR0_EM) | CR0_MP | CR0_NE);
+    cpu_write_cr4(cpu_read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+    
+    g_fpu_owner = 0;
+    g_fpu_lazy = 1;
+}
+
+// Arm the #NM trap for the next process
+void fpu_switch_to(process_t* next) {
+    if (!g_fpu_lazy) {
+        return;
+    }
+    
+    if (next == g_fpu_owner) {
+        fpu_clts(); // Registers already hold its state
+    } else {
+        fpu_stts();
+    }
+}
+
+// Handle Device Not Available
+int fpu_handle_nm(void) {
+    if (!g_fpu_lazy) {
+        return -1;
+    }
+    
+    fpu_clts();
+    
+    process_t* current = process_get_current();
+    if (current == g_fpu_owner) {
+        return 0;
+    }
+    
+    // Park the previous owner's registers in its save area
+    if (g_fpu_owner) {
+        fpu_fxsave(g_fpu_owner->fpu_state);
+    }
+    g_fpu_owner = 0;
+    
+    // Kernel context with no process: registers are free to use
+    if (!current) {
+        return 0;
+    }
+    
+    if (!current->fpu_state) {
+        current->fpu_state = (fpu_state_t*)kmem_cache_alloc(g_fpu_cache);
+        if (!current->fpu_state) {
+            return -1; // Out of memory
+        }
+        current->fpu_used = 0;
+    }
+    
+    if (current->fpu_used) {
+        fpu_fxrstor(current->fpu_state);
+    } else {
+        fpu_reset();
+        current->fpu_used = 1;
+    }
+    
+    g_fpu_owner = current;
+    return 0;
+}
+
+// Enter a kernel SIMD section
+unsigned int kernel_fpu_begin(void) {
+    // No switch (and so no TS change) can happen until kernel_fpu_end
+    unsigned int flags = cpu_irq_save();
+    
+    // With TS set the registers belong to g_fpu_owner, not current; the SSE2
+    // routines save and restore every XMM register they touch, so clearing
+    // TS for their duration leaves the owner's state intact without an #NM
+    // The bit travels with each caller's flags, so nested sections each put
+    // back what they found
+    if (cpu_read_cr0() & CR0_TS) {
+        fpu_clts();
+        flags |= KERNEL_FPU_STTS;
+    }
+    return flags;
+}
+
+// Leave a kernel SIMD section
+void kernel_fpu_end(unsigned int flags) {
+    if (flags & KERNEL_FPU_STTS) {
+        fpu_stts();
+    }
+    cpu_irq_restore(flags);
+}
+
+// Copy FPU state into a forked child
+int fpu_fork(process_t* child, process_t* parent) {
+    child->fpu_state = 0;
+    child->fpu_used = 0;
+    
+    if (!g_fpu_lazy || !parent->fpu_used) {
+        return 0;
+    }
+    
+    child->fpu_state = (fpu_state_t*)kmem_cache_alloc(g_fpu_cache);
+    if (!child->fpu_state) {
+        return -1;
+    }
+    
+    // The parent's live registers are newer than its save area
+    if (parent == g_fpu_owner) {
+        fpu_clts();
+        fpu_fxsave(parent->fpu_state);
+    }
+    
+    memcpy(child->fpu_state, parent->fpu_state, sizeof(fpu_state_t));
+    child->fpu_used = 1;
+    return 0;
+}
+
+// Release FPU state
+void fpu_release(process_t* proc) {
+    if (proc == g_fpu_owner) {
+        g_fpu_owner = 0;
+    }
+    
+    if (proc->fpu_state) {
+        kmem_cache_free(g_fpu_cache, proc->fpu_state);
+        proc->fpu_state = 0;
+    }
+    proc->fpu_used = 0;
+}
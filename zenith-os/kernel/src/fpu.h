@@ -0,0 +1,46 @@
+#ifndef FPU_H
+#define FPU_H
+
+// Size of an FXSAVE/FXRSTOR area (must be 16-byte aligned)
+#define FPU_STATE_SIZE 512
+
+// Default MXCSR: all SIMD exceptions masked, round to nearest
+#define FPU_DEFAULT_MXCSR 0x1F80
+
+// Saved x87/MMX/SSE register state of one process
+typedef struct {
+    unsigned char data[FPU_STATE_SIZE];
+} __attribute__((aligned(16))) fpu_state_t;
+
+struct process;
+
+// Initialize lazy FPU management (requires FXSR; otherwise a no-op)
+void fpu_init(void);
+
+// Called by process_switch(): arm CR0.TS unless the new process already
+// owns the FPU registers. No FPU state is touched here.
+void fpu_switch_to(struct process* next);
+
+// Device Not Available (#NM) handler: save the previous owner's state and
+// load (or initialize) the current process's state
+// Returns 0 if handled, -1 if the fault is fatal
+int fpu_handle_nm(void);
+
+// Bracket kernel code that uses XMM registers (the SSE2 string routines)
+// Interrupts stay off in between, and CR0.TS is cleared for the duration if
+// it was set, so kernel SIMD never raises #NM: no FPU state gets allocated
+// or charged to the current process, and lazy ownership is unchanged.
+// The code inside must save and restore every XMM register it uses.
+// Sections may nest (e.g. a page fault inside a large user copy)
+// Returns the flags to pass to kernel_fpu_end (saved EFLAGS plus whether TS was set)
+unsigned int kernel_fpu_begin(void);
+void kernel_fpu_end(unsigned int flags);
+
+// Give the child of a fork a copy of the parent's FPU state
+// Returns 0 on success, -1 if out of memory
+int fpu_fork(struct process* child, struct process* parent);
+
+// Release a process's FPU state (on destroy)
+void fpu_release(struct process* proc);
+
+#endif // FPU_H
@@ -1,9 +1,11 @@
 #include "fs_simple.h"
 #include "vfs.h"
 #include "ata.h"
-#include "pmm.h"
-#include "paging.h"
 #include "timer.h"
+#include "string.h"
+#include "heap.h"
+#include "pagecache.h"
+#include "journal.h"
 
 // Simple file system magic number
 #define SIMPLE_FS_MAGIC 0x504D4953  // "SIMP"
@@ -11,302 +13,898 @@
 // Block size (512 bytes = 1 sector)
 #define SIMPLE_BLOCK_SIZE 512
 
-// File system layout:
+// File system layout (block numbers recorded in the header):
 // Block 0: File system header
-// Block 1: Block bitmap (1 bit per block, tracks free/used blocks)
-// Block 2-17: Inode table (16 inodes, 1 inode per block)
-// Block 18+: Data blocks
+// journal_start: Metadata journal (journal.c); every metadata block below
+//                is written through it
+// bitmap_start: Free-space bitmap, one block (4096 bits) per allocation group
+// summary_start: Free block count of every group (16 bits each)
+// inode_bitmap_start: Inode allocation bitmap (1 bit per inode)
+// inode_start: Inode table (inode_count inodes, SIMPLE_INODES_PER_BLOCK per block)
+// data_start+: Data blocks, bit i of the bitmap tracks block data_start + i
+// Inode 0 is never used (directory entries mark free records with it)
 
 #define FS_HEADER_BLOCK 0
-#define BITMAP_BLOCK 1
-#define INODE_TABLE_START 2
-#define INODE_TABLE_SIZE 16
-#define DATA_BLOCK_START (INODE_TABLE_START + INODE_TABLE_SIZE)
+
+// Journal size chosen by simple_fs_format (largest, and share of the disk)
+#define SIMPLE_JOURNAL_BLOCKS 256
+#define SIMPLE_JOURNAL_SHARE  16
+
+// Data blocks per allocation group (one bitmap block)
+#define SIMPLE_GROUP_BLOCKS (SIMPLE_BLOCK_SIZE * 8)
+#define SIMPLE_GROUP_WORDS (SIMPLE_BLOCK_SIZE / 4)
+
+// Group free counts held by one summary block
+#define SIMPLE_SUMMARY_PER_BLOCK (SIMPLE_BLOCK_SIZE / sizeof(unsigned short))
+
+// Bitmap blocks kept in memory at once
+#define SIMPLE_BITMAP_CACHE 8
+
+// Blocks per page cache page
+#define BLOCKS_PER_PAGE (PAGECACHE_PAGE_SIZE / SIMPLE_BLOCK_SIZE)
+
+// Hashed directories: deepest split (2^16 buckets) and splits one insert may make
+#define SIMPLE_DIR_MAX_DEPTH  16
+#define SIMPLE_DIR_MAX_SPLITS 2
+
+// Extents an unlink frees per journal handle (larger files take several)
+#define SIMPLE_UNLINK_EXTENTS 8
+
+// Journal credits: blocks an operation logs besides the allocation state
+#define SIMPLE_INODE_CREDITS  2   // Inode table block and extent block
+#define SIMPLE_ALLOC_CREDITS  2   // Bitmap blocks one allocation dirties or evicts
+// Create: new and parent inode, the entry's bucket, and for each split its new
+// block with the allocations for it and the extent block
+#define SIMPLE_CREATE_CREDITS (2 * SIMPLE_INODE_CREDITS + 1 + \
+                               SIMPLE_DIR_MAX_SPLITS * (1 + 2 * SIMPLE_ALLOC_CREDITS))
+
+// Buckets of the loaded-file hash (power of two)
+#define SIMPLE_FILE_BUCKETS 64
+
+// Per-file state (node->fs_data)
+typedef struct simple_file {
+    simple_inode_t inode;                        // Inode as stored on disk
+    unsigned int ino;                            // Inode number
+    simple_extent_t* more;                       // Contents of the extent block, NULL if none
+    int more_dirty;                              // Extent block changed since last written
+    vfs_node_t* node;                            // Node made for it (NULL for the mount root)
+    struct simple_file* hash_next;               // Next loaded file in the same bucket
+    unsigned int rd_index;                       // Directories: readdir cursor, entry rd_index
+    unsigned int rd_block;                       //   is the live record at rd_block/rd_off
+    unsigned int rd_off;
+    vfs_node_t* rd_entry;                        // Directories: scratch node readdir returns
+} simple_file_t;
+
+// Cached bitmap block of one allocation group
+typedef struct {
+    unsigned int group;                          // Group it belongs to
+    unsigned int last_used;                      // Stamp for LRU replacement
+    int valid;                                   // 1 once loaded
+    int dirty;                                   // Changed since last written
+    unsigned int bits[SIMPLE_GROUP_WORDS];       // 1 = block in use
+} simple_bitmap_t;
 
 // In-memory file system state
 static simple_fs_header_t g_fs_header;
+
+// Files with a node, hashed by inode number, so a lookup finds an already
+// loaded child without walking its directory's child list
+static simple_file_t* g_file_hash[SIMPLE_FILE_BUCKETS];
 static int g_fs_mounted = 0;
-static unsigned char g_block_bitmap[512];  // Bitmap cache (1 block = 512 bytes = 4096 blocks)
+static simple_bitmap_t g_bitmaps[SIMPLE_BITMAP_CACHE];
+static unsigned int g_bitmap_clock = 0;
+static unsigned short* g_group_free = 0;  // Free blocks per group (summary blocks, padded)
+static unsigned char* g_summary_dirty = 0; // Summary blocks changed since last logged
+static unsigned int* g_inode_bitmap = 0;   // Inode bitmap (1 = in use), whole map in memory
+static unsigned char* g_inode_bitmap_dirty = 0; // Inode bitmap blocks changed since last logged
+static int g_bitmap_dirty = 0;             // Bitmaps/summary/header changed since last logged
 
 // Read a block from disk
 static int read_block(unsigned int block_num, unsigned char* buffer) {
     return ata_read_sectors(block_num, 1, buffer);
 }
 
-// Write a block to disk
-static int write_block(unsigned int block_num, unsigned char* buffer) {
-    return ata_write_sectors(block_num, 1, buffer);
+// Read a metadata block, including updates still in the journal
+static int read_meta(unsigned int block_num, unsigned char* buffer) {
+    return journal_read(block_num, buffer);
 }
 
-// Load block bitmap from disk
-static int load_bitmap(void) {
-    return read_block(BITMAP_BLOCK, g_block_bitmap);
+// Log a metadata block update (reaches the disk with the next journal commit)
+static int log_meta(unsigned int block_num, const unsigned char* buffer) {
+    return journal_log(block_num, buffer);
 }
 
-// Save block bitmap to disk
-static int save_bitmap(void) {
-    return write_block(BITMAP_BLOCK, g_block_bitmap);
+// Log the header (padded to a whole block)
+static int log_header(void) {
+    unsigned char block[SIMPLE_BLOCK_SIZE];
+    memset(block, 0, SIMPLE_BLOCK_SIZE);
+    memcpy(block, &g_fs_header, sizeof(g_fs_header));
+    return log_meta(FS_HEADER_BLOCK, block);
 }
 
-// Check if a block is free
-static int is_block_free(unsigned int block_num) {
-    if (block_num < DATA_BLOCK_START || block_num >= g_fs_header.total_blocks) {
-        return 0; // Invalid or reserved block
+// Read the header from disk
+static int read_header(void) {
+    unsigned char block[SIMPLE_BLOCK_SIZE];
+    if (read_block(FS_HEADER_BLOCK, block) != 1) {
+        return -1;
+    }
+    memcpy(&g_fs_header, block, sizeof(g_fs_header));
+    return 0;
+}
+
+// Number of data blocks covered by a group (the last one may be short)
+static unsigned int group_blocks(unsigned int group) {
+    unsigned int first = group * SIMPLE_GROUP_BLOCKS;
+    unsigned int data_blocks = g_fs_header.total_blocks - g_fs_header.data_start;
+    unsigned int left = data_blocks - first;
+    return left < SIMPLE_GROUP_BLOCKS ? left : SIMPLE_GROUP_BLOCKS;
+}
+
+// Bitmap block of a group, read in on first use
+// Returns NULL on I/O error
+static simple_bitmap_t* get_bitmap(unsigned int group) {
+    simple_bitmap_t* victim = &g_bitmaps[0];
+    for (int i = 0; i < SIMPLE_BITMAP_CACHE; i++) {
+        simple_bitmap_t* bm = &g_bitmaps[i];
+        if (bm->valid && bm->group == group) {
+            bm->last_used = ++g_bitmap_clock;
+            return bm;
+        }
+        if (!bm->valid || (victim->valid && bm->last_used < victim->last_used)) {
+            victim = bm;
+        }
     }
     
-    unsigned int bitmap_index = block_num - DATA_BLOCK_START;
-    unsigned int byte_index = bitmap_index / 8;
-    unsigned int bit_index = bitmap_index % 8;
-    
-    if (byte_index >= 512) {
-        return 0; // Out of range
+    // Reuse the least recently used slot, logging it first if needed
+    if (victim->valid && victim->dirty) {
+        if (log_meta(g_fs_header.bitmap_start + victim->group, (unsigned char*)victim->bits) != 0) {
+            return 0;
+        }
+        victim->dirty = 0;
     }
     
-    return !(g_block_bitmap[byte_index] & (1 << bit_index));
+    victim->valid = 0;
+    if (read_meta(g_fs_header.bitmap_start + group, (unsigned char*)victim->bits) != 1) {
+        return 0;
+    }
+    victim->group = group;
+    victim->valid = 1;
+    victim->last_used = ++g_bitmap_clock;
+    return victim;
 }
 
-// Mark a block as used
-static void mark_block_used(unsigned int block_num) {
-    if (block_num < DATA_BLOCK_START || block_num >= g_fs_header.total_blocks) {
-        return;
+// First clear bit in [from, limit) of a group bitmap, one word at a time
+// Returns the bit number, or limit if every block is in use
+static unsigned int bitmap_find_free(const unsigned int* bits, unsigned int from, unsigned int limit) {
+    if (from >= limit) {
+        return limit;
     }
     
-    unsigned int bitmap_index = block_num - DATA_BLOCK_START;
-    unsigned int byte_index = bitmap_index / 8;
-    unsigned int bit_index = bitmap_index % 8;
-    
-    if (byte_index >= 512) {
-        return;
+    unsigned int w = from / 32;
+    unsigned int word = bits[w] | ((1u << (from % 32)) - 1);  // Ignore bits before from
+    for (;;) {
+        if (word != 0xFFFFFFFF) {
+            unsigned int bit = w * 32 + __builtin_ctz(~word);
+            return bit < limit ? bit : limit;
+        }
+        if (++w * 32 >= limit) {
+            return limit;
+        }
+        word = bits[w];
     }
+}
+
+// Take up to want free blocks starting at bit `bit` of a group
+// Returns the number taken (stops at the first used block)
+static unsigned int bitmap_take_run(simple_bitmap_t* bm, unsigned int bit, unsigned int want) {
+    unsigned int limit = group_blocks(bm->group);
+    unsigned int count = 0;
     
-    if (!(g_block_bitmap[byte_index] & (1 << bit_index))) {
-        g_block_bitmap[byte_index] |= (1 << bit_index);
-        g_fs_header.free_blocks--;
+    while (count < want && bit + count < limit) {
+        unsigned int mask = 1u << ((bit + count) % 32);
+        unsigned int* word = &bm->bits[(bit + count) / 32];
+        if (*word & mask) {
+            break;
+        }
+        *word |= mask;
+        count++;
     }
+    
+    bm->dirty = 1;
+    g_group_free[bm->group] -= count;
+    g_summary_dirty[bm->group / SIMPLE_SUMMARY_PER_BLOCK] = 1;
+    g_fs_header.free_blocks -= count;
+    return count;
 }
 
-// Mark a block as free
-static void mark_block_free(unsigned int block_num) {
-    if (block_num < DATA_BLOCK_START || block_num >= g_fs_header.total_blocks) {
-        return;
+// Allocate up to want consecutive free blocks, starting the search at goal
+// so a growing file continues where its last run ended
+// Groups with no free blocks are skipped using the summary, never read
+// Returns the first block (count in *got), 0 if the disk is full
+static unsigned int allocate_run(unsigned int goal, unsigned int want, unsigned int* got) {
+    if (goal < g_fs_header.data_start || goal >= g_fs_header.total_blocks) {
+        goal = g_fs_header.data_start;
     }
     
-    unsigned int bitmap_index = block_num - DATA_BLOCK_START;
-    unsigned int byte_index = bitmap_index / 8;
-    unsigned int bit_index = bitmap_index % 8;
-    
-    if (byte_index >= 512) {
-        return;
+    // Walk the groups once starting at the goal's, then retry the part of
+    // the goal group before the goal
+    unsigned int goal_bit = goal - g_fs_header.data_start;
+    unsigned int first_group = goal_bit / SIMPLE_GROUP_BLOCKS;
+    for (unsigned int n = 0; n <= g_fs_header.group_count; n++) {
+        unsigned int group = (first_group + n) % g_fs_header.group_count;
+        if (g_group_free[group] == 0) {
+            continue;
+        }
+        
+        simple_bitmap_t* bm = get_bitmap(group);
+        if (!bm) {
+            return 0; // I/O error
+        }
+        
+        unsigned int from = n == 0 ? goal_bit % SIMPLE_GROUP_BLOCKS : 0;
+        unsigned int limit = group_blocks(group);
+        unsigned int bit = bitmap_find_free(bm->bits, from, limit);
+        if (bit == limit) {
+            continue;
+        }
+        
+        *got = bitmap_take_run(bm, bit, want);
+        g_bitmap_dirty = 1;  // Logged by sync/fsync
+        return g_fs_header.data_start + group * SIMPLE_GROUP_BLOCKS + bit;
     }
     
-    if (g_block_bitmap[byte_index] & (1 << bit_index)) {
-        g_block_bitmap[byte_index] &= ~(1 << bit_index);
-        g_fs_header.free_blocks++;
+    return 0; // No free blocks
+}
+
+// Free a run of blocks
+static void free_blocks(unsigned int block_num, unsigned int count) {
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned int block = block_num + i;
+        if (block < g_fs_header.data_start || block >= g_fs_header.total_blocks) {
+            continue;
+        }
+        
+        unsigned int bit = block - g_fs_header.data_start;
+        simple_bitmap_t* bm = get_bitmap(bit / SIMPLE_GROUP_BLOCKS);
+        if (!bm) {
+            continue; // Leaked on I/O error, never double-allocated
+        }
+        
+        unsigned int mask = 1u << (bit % 32);
+        unsigned int* word = &bm->bits[(bit % SIMPLE_GROUP_BLOCKS) / 32];
+        if (*word & mask) {
+            *word &= ~mask;
+            bm->dirty = 1;
+            g_group_free[bm->group]++;
+            g_summary_dirty[bm->group / SIMPLE_SUMMARY_PER_BLOCK] = 1;
+            g_fs_header.free_blocks++;
+        }
     }
+    g_bitmap_dirty = 1;  // Logged by sync/fsync
 }
 
-// Allocate a free block
-static unsigned int allocate_block(void) {
-    // Find first free block
-    for (unsigned int block = DATA_BLOCK_START; block < g_fs_header.total_blocks; block++) {
-        if (is_block_free(block)) {
-            mark_block_used(block);
-            save_bitmap();  // Persist bitmap
-            return block;
+// First block of the group a file's data should start in
+// Inodes are spread evenly over the groups so files grow without interleaving
+static unsigned int home_block(unsigned int inode_num) {
+    unsigned int per_group = (g_fs_header.inode_count + g_fs_header.group_count - 1) / g_fs_header.group_count;
+    unsigned int group = inode_num / per_group;
+    return g_fs_header.data_start + group * SIMPLE_GROUP_BLOCKS;
+}
+
+// Number of inode bitmap blocks
+static unsigned int inode_bitmap_blocks(void) {
+    return (g_fs_header.inode_count + SIMPLE_GROUP_BLOCKS - 1) / SIMPLE_GROUP_BLOCKS;
+}
+
+// Load the inode bitmap
+// Returns 0 on success, -1 on error
+static int load_inode_bitmap(void) {
+    unsigned int blocks = inode_bitmap_blocks();
+    if (g_fs_header.inode_count == 0 || g_fs_header.root_inode >= g_fs_header.inode_count) {
+        return -1; // Inconsistent layout
+    }
+    
+    g_inode_bitmap = (unsigned int*)kmalloc(blocks * SIMPLE_BLOCK_SIZE);
+    g_inode_bitmap_dirty = (unsigned char*)kmalloc(blocks);
+    if (!g_inode_bitmap || !g_inode_bitmap_dirty) {
+        return -1;
+    }
+    memset(g_inode_bitmap_dirty, 0, blocks);
+    
+    for (unsigned int i = 0; i < blocks; i++) {
+        unsigned char* dest = (unsigned char*)g_inode_bitmap + i * SIMPLE_BLOCK_SIZE;
+        if (read_block(g_fs_header.inode_bitmap_start + i, dest) != 1) {
+            return -1;
         }
     }
-    return 0; // No free blocks
+    return 0;
 }
 
-// Free a block
-static void free_block(unsigned int block_num) {
-    mark_block_free(block_num);
-    save_bitmap();  // Persist bitmap
+// Allocate a free inode, one bitmap word at a time
+// Returns 0 on success (number in *ino), -1 if the table is full
+static int alloc_inode(unsigned int* ino) {
+    unsigned int bit = bitmap_find_free(g_inode_bitmap, 0, g_fs_header.inode_count);
+    if (bit == g_fs_header.inode_count) {
+        return -1;
+    }
+    
+    g_inode_bitmap[bit / 32] |= 1u << (bit % 32);
+    g_inode_bitmap_dirty[bit / SIMPLE_GROUP_BLOCKS] = 1;
+    g_fs_header.free_inodes--;
+    g_bitmap_dirty = 1;  // Logged by sync/fsync
+    *ino = bit;
+    return 0;
 }
 
-// Free all blocks used by an inode
-static void free_inode_blocks(simple_inode_t* inode) {
-    if (!inode) {
+// Return an inode to the bitmap
+static void free_inode(unsigned int ino) {
+    if (ino >= g_fs_header.inode_count || !(g_inode_bitmap[ino / 32] & (1u << (ino % 32)))) {
         return;
     }
     
-    // Free all blocks
-    for (int i = 0; i < 16; i++) {
-        if (inode->blocks[i] != 0) {
-            free_block(inode->blocks[i]);
-            inode->blocks[i] = 0;
+    g_inode_bitmap[ino / 32] &= ~(1u << (ino % 32));
+    g_inode_bitmap_dirty[ino / SIMPLE_GROUP_BLOCKS] = 1;
+    g_fs_header.free_inodes++;
+    g_bitmap_dirty = 1;  // Logged by sync/fsync
+}
+
+// Number of summary blocks
+static unsigned int summary_blocks(void) {
+    return (g_fs_header.group_count + SIMPLE_SUMMARY_PER_BLOCK - 1) / SIMPLE_SUMMARY_PER_BLOCK;
+}
+
+// Load the group summary and check it against the header
+// Returns 0 on success, -1 on error
+static int load_summary(void) {
+    unsigned int data_blocks = g_fs_header.total_blocks - g_fs_header.data_start;
+    if (g_fs_header.data_start >= g_fs_header.total_blocks ||
+        g_fs_header.group_count != (data_blocks + SIMPLE_GROUP_BLOCKS - 1) / SIMPLE_GROUP_BLOCKS) {
+        return -1; // Inconsistent layout
+    }
+    
+    unsigned int blocks = summary_blocks();
+    g_group_free = (unsigned short*)kmalloc(blocks * SIMPLE_BLOCK_SIZE);
+    g_summary_dirty = (unsigned char*)kmalloc(blocks);
+    if (!g_group_free || !g_summary_dirty) {
+        return -1;
+    }
+    memset(g_summary_dirty, 0, blocks);
+    
+    for (unsigned int i = 0; i < blocks; i++) {
+        unsigned char* dest = (unsigned char*)g_group_free + i * SIMPLE_BLOCK_SIZE;
+        if (read_block(g_fs_header.summary_start + i, dest) != 1) {
+            return -1;
         }
     }
     
-    inode->size = 0;
+    for (int i = 0; i < SIMPLE_BITMAP_CACHE; i++) {
+        g_bitmaps[i].valid = 0;
+        g_bitmaps[i].dirty = 0;
+    }
+    return 0;
+}
+
+// Log dirty bitmap blocks and the summary and inode bitmap blocks that changed
+// Returns 0 on success, -1 on error
+static int save_bitmap(void) {
+    for (int i = 0; i < SIMPLE_BITMAP_CACHE; i++) {
+        simple_bitmap_t* bm = &g_bitmaps[i];
+        if (bm->valid && bm->dirty) {
+            if (log_meta(g_fs_header.bitmap_start + bm->group, (unsigned char*)bm->bits) != 0) {
+                return -1;
+            }
+            bm->dirty = 0;
+        }
+    }
+    
+    for (unsigned int i = 0; i < summary_blocks(); i++) {
+        if (!g_summary_dirty[i]) {
+            continue;
+        }
+        unsigned char* src = (unsigned char*)g_group_free + i * SIMPLE_BLOCK_SIZE;
+        if (log_meta(g_fs_header.summary_start + i, src) != 0) {
+            return -1;
+        }
+        g_summary_dirty[i] = 0;
+    }
+    
+    for (unsigned int i = 0; i < inode_bitmap_blocks(); i++) {
+        if (!g_inode_bitmap_dirty[i]) {
+            continue;
+        }
+        unsigned char* src = (unsigned char*)g_inode_bitmap + i * SIMPLE_BLOCK_SIZE;
+        if (log_meta(g_fs_header.inode_bitmap_start + i, src) != 0) {
+            return -1;
+        }
+        g_inode_bitmap_dirty[i] = 0;
+    }
+    return 0;
 }
 
-// Read inode from disk
+// Read an inode (block found by direct index computation)
 static int read_inode(unsigned int inode_num, simple_inode_t* inode) {
-    if (inode_num >= INODE_TABLE_SIZE) {
+    if (inode_num >= g_fs_header.inode_count) {
         return -1;
     }
     
-    unsigned int block_num = INODE_TABLE_START + inode_num;
-    return read_block(block_num, (unsigned char*)inode);
+    unsigned char block[SIMPLE_BLOCK_SIZE];
+    unsigned int block_num = g_fs_header.inode_start + inode_num / SIMPLE_INODES_PER_BLOCK;
+    if (read_meta(block_num, block) != 1) {
+        return -1;
+    }
+    memcpy(inode, block + (inode_num % SIMPLE_INODES_PER_BLOCK) * SIMPLE_INODE_SIZE, SIMPLE_INODE_SIZE);
+    return 0;
 }
 
-// Write inode to disk
+// Log an inode update
+// The whole block is logged; the journal merges updates of its neighbours
+// made before the next commit into the same image
 static int write_inode(unsigned int inode_num, simple_inode_t* inode) {
-    if (inode_num >= INODE_TABLE_SIZE) {
+    if (inode_num >= g_fs_header.inode_count) {
         return -1;
     }
     
-    unsigned int block_num = INODE_TABLE_START + inode_num;
-    return write_block(block_num, (unsigned char*)inode);
+    unsigned char block[SIMPLE_BLOCK_SIZE];
+    unsigned int block_num = g_fs_header.inode_start + inode_num / SIMPLE_INODES_PER_BLOCK;
+    if (read_meta(block_num, block) != 1) {
+        return -1;
+    }
+    memcpy(block + (inode_num % SIMPLE_INODES_PER_BLOCK) * SIMPLE_INODE_SIZE, inode, SIMPLE_INODE_SIZE);
+    return log_meta(block_num, block);
 }
 
-// Simple file system read function
-static int simple_fs_read(vfs_node_t* node, unsigned int offset, unsigned int size, unsigned char* buffer) {
-    if (!node || !buffer) {
-        return -1;
+// Extent i of a file (inline ones first, then the extent block)
+static simple_extent_t* extent_at(simple_file_t* file, unsigned int i) {
+    if (i < SIMPLE_INLINE_EXTENTS) {
+        return &file->inode.extents[i];
     }
-    
-    simple_inode_t* inode = (simple_inode_t*)node->fs_data;
-    if (!inode) {
+    return &file->more[i - SIMPLE_INLINE_EXTENTS];
+}
+
+// Extent covering file block `block`, or NULL for a hole
+static simple_extent_t* find_extent(simple_file_t* file, unsigned int block) {
+    for (unsigned int i = 0; i < file->inode.extent_count; i++) {
+        simple_extent_t* ext = extent_at(file, i);
+        if (block - ext->file_block < (ext->length & SIMPLE_EXTENT_LEN_MASK)) {
+            return ext;
+        }
+    }
+    return 0;
+}
+
+// Make room for n more extents, allocating the extent block when needed
+// Returns 0 on success, -1 if the file has too many extents or the disk is full
+static int reserve_extents(vfs_node_t* node, simple_file_t* file, unsigned int n) {
+    unsigned int count = file->inode.extent_count + n;
+    if (count > SIMPLE_MAX_EXTENTS) {
         return -1;
     }
-    
-    if (offset >= node->size) {
-        return 0; // End of file
+    if (count <= SIMPLE_INLINE_EXTENTS || file->more) {
+        return 0;
     }
     
-    if (offset + size > node->size) {
-        size = node->size - offset;
+    unsigned int got;
+    unsigned int block = allocate_run(file->inode.extents[0].disk_block, 1, &got);
+    if (block == 0) {
+        return -1;
     }
     
-    // Calculate which blocks to read
-    unsigned int start_block = offset / SIMPLE_BLOCK_SIZE;
-    unsigned int end_block = (offset + size - 1) / SIMPLE_BLOCK_SIZE;
-    
-    unsigned int bytes_read = 0;
-    unsigned char* temp_buffer = (unsigned char*)pmm_alloc_page();
-    if (!temp_buffer) {
+    file->more = (simple_extent_t*)kmalloc(SIMPLE_BLOCK_SIZE);
+    if (!file->more) {
+        free_blocks(block, 1);
         return -1;
     }
+    memset(file->more, 0, SIMPLE_BLOCK_SIZE);
+    file->inode.extent_block = block;
+    file->more_dirty = 1;
+    node->flags |= VFS_NODE_DIRTY;
+    return 0;
+}
+
+// Map length blocks at file_block to disk_block, growing an adjacent extent
+// when the run continues it on disk; room must have been reserved
+static void add_extent(vfs_node_t* node, simple_file_t* file, unsigned int file_block,
+                       unsigned int disk_block, unsigned int length, unsigned int flags) {
+    for (unsigned int i = 0; i < file->inode.extent_count; i++) {
+        simple_extent_t* ext = extent_at(file, i);
+        unsigned int len = ext->length & SIMPLE_EXTENT_LEN_MASK;
+        if ((ext->length & SIMPLE_EXTENT_UNWRITTEN) == flags &&
+            ext->file_block + len == file_block && ext->disk_block + len == disk_block) {
+            ext->length += length;
+            file->more_dirty |= i >= SIMPLE_INLINE_EXTENTS;
+            node->flags |= VFS_NODE_DIRTY;
+            return;
+        }
+    }
     
-    for (unsigned int i = start_block; i <= end_block && i < 16; i++) {
-        if (inode->blocks[i] == 0) {
-            break; // No more blocks
+    unsigned int i = file->inode.extent_count++;
+    simple_extent_t* ext = extent_at(file, i);
+    ext->file_block = file_block;
+    ext->disk_block = disk_block;
+    ext->length = length | flags;
+    file->more_dirty |= i >= SIMPLE_INLINE_EXTENTS;
+    node->flags |= VFS_NODE_DIRTY;
+}
+
+// Drop an extent from the map (the last one takes its slot)
+static void remove_extent(vfs_node_t* node, simple_file_t* file, simple_extent_t* ext) {
+    unsigned int last = --file->inode.extent_count;
+    *ext = *extent_at(file, last);
+    file->more_dirty |= last >= SIMPLE_INLINE_EXTENTS;
+    node->flags |= VFS_NODE_DIRTY;
+}
+
+// Map file blocks [block, end) that are holes, one contiguous run at a time
+// Returns 0 on success, -1 if out of space or extents
+static int map_blocks(vfs_node_t* node, simple_file_t* file, unsigned int block,
+                      unsigned int end, unsigned int flags) {
+    while (block < end) {
+        simple_extent_t* ext = find_extent(file, block);
+        if (ext) {
+            block = ext->file_block + (ext->length & SIMPLE_EXTENT_LEN_MASK);
+            continue;
         }
         
-        if (read_block(inode->blocks[i], temp_buffer) != 1) {
-            break; // Read error
+        // Length of the hole, and where on disk the data before it ended
+        unsigned int want = 1;
+        while (block + want < end && !find_extent(file, block + want)) {
+            want++;
+        }
+        simple_extent_t* prev = block ? find_extent(file, block - 1) : 0;
+        unsigned int goal = prev ? prev->disk_block + (block - prev->file_block) : 0;
+        if (!prev && file->inode.extent_count) {
+            // Where the block would be if the file were contiguous from its first extent
+            simple_extent_t* first = &file->inode.extents[0];
+            goal = first->disk_block + (block > first->file_block ? block - first->file_block : 0);
+        } else if (!prev) {
+            goal = home_block(file->ino);
         }
         
-        // Calculate copy range
-        unsigned int block_offset = (i == start_block) ? (offset % SIMPLE_BLOCK_SIZE) : 0;
-        unsigned int copy_size = SIMPLE_BLOCK_SIZE - block_offset;
-        if (bytes_read + copy_size > size) {
-            copy_size = size - bytes_read;
+        unsigned int got;
+        if (reserve_extents(node, file, 1) != 0) {
+            return -1;
+        }
+        unsigned int start = allocate_run(goal, want, &got);
+        if (start == 0) {
+            return -1; // Out of space
+        }
+        add_extent(node, file, block, start, got, flags);
+        block += got;
+    }
+    return 0;
+}
+
+// Turn reserved blocks in [block, end) into written ones before data lands there
+// Returns 0 on success, -1 if splitting needs more extents than the file may have
+static int convert_unwritten(vfs_node_t* node, simple_file_t* file, unsigned int block, unsigned int end) {
+    while (block < end) {
+        simple_extent_t* ext = find_extent(file, block);
+        if (!ext || !(ext->length & SIMPLE_EXTENT_UNWRITTEN)) {
+            block++;
+            continue;
         }
         
-        // Copy data
-        for (unsigned int j = 0; j < copy_size; j++) {
-            buffer[bytes_read + j] = temp_buffer[block_offset + j];
+        // Split into [reserved][written][reserved]; the outer parts may be empty
+        if (reserve_extents(node, file, 2) != 0) {
+            return -1;
         }
+        unsigned int file_block = ext->file_block;
+        unsigned int disk_block = ext->disk_block;
+        unsigned int ext_end = file_block + (ext->length & SIMPLE_EXTENT_LEN_MASK);
+        unsigned int stop = end < ext_end ? end : ext_end;
         
-        bytes_read += copy_size;
+        if (block > file_block) {
+            ext->length = (block - file_block) | SIMPLE_EXTENT_UNWRITTEN;
+            node->flags |= VFS_NODE_DIRTY;
+            file->more_dirty = 1;
+        } else {
+            remove_extent(node, file, ext);
+        }
+        add_extent(node, file, block, disk_block + (block - file_block), stop - block, 0);
+        if (stop < ext_end) {
+            add_extent(node, file, stop, disk_block + (stop - file_block), ext_end - stop,
+                       SIMPLE_EXTENT_UNWRITTEN);
+        }
+        block = stop;
+    }
+    return 0;
+}
+
+// Free every block of a file, including its extent block
+// Directory blocks and the extent block are metadata: the journal forgets them
+static void free_file_blocks(vfs_node_t* node, simple_file_t* file) {
+    for (unsigned int i = 0; i < file->inode.extent_count; i++) {
+        simple_extent_t* ext = extent_at(file, i);
+        unsigned int len = ext->length & SIMPLE_EXTENT_LEN_MASK;
+        if (node->type == FS_TYPE_DIR) {
+            for (unsigned int b = 0; b < len; b++) {
+                journal_forget(ext->disk_block + b);
+            }
+        }
+        free_blocks(ext->disk_block, len);
     }
     
-    pmm_free_page((unsigned long long)temp_buffer);
-    return bytes_read;
+    if (file->more) {
+        journal_forget(file->inode.extent_block);
+        free_blocks(file->inode.extent_block, 1);
+        kfree(file->more);
+        file->more = 0;
+    }
+    
+    file->inode.extent_count = 0;
+    file->inode.extent_block = 0;
+    file->inode.size = 0;
+    file->more_dirty = 0;
+    node->size = 0;
 }
 
-// Simple file system write function
-static int simple_fs_write(vfs_node_t* node, unsigned int offset, unsigned int size, unsigned char* buffer) {
-    if (!node || !buffer || !g_fs_mounted) {
-        return -1;
+// Disk block holding file block `block`, or 0 for a hole, reserved space or past EOF
+static unsigned int simple_bmap(vfs_node_t* node, simple_file_t* file, unsigned int block) {
+    if (block * SIMPLE_BLOCK_SIZE >= node->size) {
+        return 0;
     }
     
-    simple_inode_t* inode = (simple_inode_t*)node->fs_data;
-    if (!inode) {
+    simple_extent_t* ext = find_extent(file, block);
+    if (!ext || (ext->length & SIMPLE_EXTENT_UNWRITTEN)) {
+        return 0;
+    }
+    return ext->disk_block + (block - ext->file_block);
+}
+
+// Largest run of sectors moved with one command
+#define SIMPLE_IO_RUN 64
+
+// Simple file system readpages function (fills count consecutive page cache pages)
+// Runs of adjacent disk blocks are fetched with a single multi-sector command,
+// each sector landing directly in its page
+static int simple_fs_readpages(vfs_node_t* node, unsigned int index, unsigned int count, unsigned char** pages) {
+    if (!node || !pages) {
         return -1;
     }
     
-    // Calculate which blocks we need
-    unsigned int start_block_index = offset / SIMPLE_BLOCK_SIZE;
-    unsigned int end_block_index = (offset + size - 1) / SIMPLE_BLOCK_SIZE;
-    
-    // Check if we need more blocks than available
-    if (end_block_index >= 16) {
-        return -1; // File too large (max 16 blocks)
+    simple_file_t* file = (simple_file_t*)node->fs_data;
+    if (!file) {
+        return -1;
     }
     
-    // Allocate blocks if needed
-    for (unsigned int i = start_block_index; i <= end_block_index; i++) {
-        if (inode->blocks[i] == 0) {
-            unsigned int new_block = allocate_block();
-            if (new_block == 0) {
-                return -1; // Out of space
+    unsigned char* run[SIMPLE_IO_RUN];
+    unsigned int run_start = 0;
+    unsigned int run_len = 0;
+    
+    for (unsigned int p = 0; p < count; p++) {
+        for (unsigned int i = 0; i < BLOCKS_PER_PAGE; i++) {
+            unsigned int disk_block = simple_bmap(node, file, (index + p) * BLOCKS_PER_PAGE + i);
+            unsigned char* dest = pages[p] + i * SIMPLE_BLOCK_SIZE;
+            
+            if (disk_block == 0) {
+                memset(dest, 0, SIMPLE_BLOCK_SIZE); // Hole or past EOF
+                continue;
             }
-            inode->blocks[i] = new_block;
+            
+            // Flush the current run if this block does not extend it
+            if (run_len && (disk_block != run_start + run_len || run_len == SIMPLE_IO_RUN)) {
+                if (ata_read_sectors_vec(run_start, run_len, run) != (int)run_len) {
+                    return -1; // Read error
+                }
+                run_len = 0;
+            }
+            
+            if (run_len == 0) {
+                run_start = disk_block;
+            }
+            run[run_len++] = dest;
         }
     }
     
-    // Write data to blocks
-    unsigned int bytes_written = 0;
-    unsigned char* temp_buffer = (unsigned char*)pmm_alloc_page();
-    if (!temp_buffer) {
+    if (run_len && ata_read_sectors_vec(run_start, run_len, run) != (int)run_len) {
+        return -1; // Read error
+    }
+    
+    return 0;
+}
+
+// Simple file system readpage function (fills one page cache page)
+static int simple_fs_readpage(vfs_node_t* node, unsigned int index, unsigned char* page) {
+    return simple_fs_readpages(node, index, 1, &page);
+}
+
+// Reserve disk blocks for the part of page index inside the file
+// Returns the disk block backing the start of the page, 0 on failure
+static unsigned int simple_fs_bmap(vfs_node_t* node, unsigned int index) {
+    simple_file_t* file = (simple_file_t*)node->fs_data;
+    if (!file || !g_fs_mounted) {
+        return 0;
+    }
+    
+    unsigned int first = index * BLOCKS_PER_PAGE;
+    unsigned int end = (node->size + SIMPLE_BLOCK_SIZE - 1) / SIMPLE_BLOCK_SIZE;
+    if (end > first + BLOCKS_PER_PAGE) {
+        end = first + BLOCKS_PER_PAGE;
+    }
+    
+    // The page is about to be written: reserved blocks under it become real data
+    if (map_blocks(node, file, first, end, 0) != 0 ||
+        convert_unwritten(node, file, first, end) != 0) {
+        return 0; // Out of space or extents
+    }
+    
+    return simple_bmap(node, file, first);
+}
+
+// Simple file system writepages function (writes back count consecutive pages)
+// Blocks that are adjacent on disk go out as one multi-sector write, even
+// when they span several pages
+static int simple_fs_writepages(vfs_node_t* node, unsigned int index, unsigned int count, unsigned char** pages) {
+    simple_file_t* file = (simple_file_t*)node->fs_data;
+    if (!file) {
         return -1;
     }
     
-    for (unsigned int i = start_block_index; i <= end_block_index && i < 16; i++) {
-        if (inode->blocks[i] == 0) {
-            break;
-        }
-        
-        // Read existing block data
-        if (read_block(inode->blocks[i], temp_buffer) != 1) {
-            break; // Read error
+    unsigned char* run[SIMPLE_IO_RUN];
+    unsigned int run_start = 0;
+    unsigned int run_len = 0;
+    
+    for (unsigned int p = 0; p < count; p++) {
+        if (!simple_fs_bmap(node, index + p)) {
+            return -1;
         }
         
-        // Calculate what part of this block to write
-        unsigned int block_offset = (i == start_block_index) ? (offset % SIMPLE_BLOCK_SIZE) : 0;
-        unsigned int write_size = SIMPLE_BLOCK_SIZE - block_offset;
-        if (bytes_written + write_size > size) {
-            write_size = size - bytes_written;
+        for (unsigned int i = 0; i < BLOCKS_PER_PAGE; i++) {
+            unsigned int disk_block = simple_bmap(node, file, (index + p) * BLOCKS_PER_PAGE + i);
+            if (disk_block == 0) {
+                break; // Past EOF
+            }
+            
+            // Flush the current run if this block does not extend it
+            if (run_len && (disk_block != run_start + run_len || run_len == SIMPLE_IO_RUN)) {
+                if (ata_write_sectors_vec(run_start, run_len, run) != (int)run_len) {
+                    return -1; // Write error
+                }
+                run_len = 0;
+            }
+            
+            if (run_len == 0) {
+                run_start = disk_block;
+            }
+            run[run_len++] = pages[p] + i * SIMPLE_BLOCK_SIZE;
         }
-        
-        // Copy data into block buffer
-        for (unsigned int j = 0; j < write_size; j++) {
-            temp_buffer[block_offset + j] = buffer[bytes_written + j];
+    }
+    
+    if (run_len && ata_write_sectors_vec(run_start, run_len, run) != (int)run_len) {
+        return -1; // Write error
+    }
+    
+    return 0;
+}
+
+// Simple file system writepage function (writes back one page cache page)
+static int simple_fs_writepage(vfs_node_t* node, unsigned int index, unsigned char* page) {
+    return simple_fs_writepages(node, index, 1, &page);
+}
+
+// Simple file system fallocate function
+// Holes in the range get contiguous runs marked unwritten, so they read as
+// zero until a write converts them
+static int simple_fs_fallocate(vfs_node_t* node, unsigned int offset, unsigned int len) {
+    simple_file_t* file = (simple_file_t*)node->fs_data;
+    if (!file || !g_fs_mounted) {
+        return -1;
+    }
+    
+    unsigned int first = offset / SIMPLE_BLOCK_SIZE;
+    unsigned int end = (offset + len + SIMPLE_BLOCK_SIZE - 1) / SIMPLE_BLOCK_SIZE;
+    return map_blocks(node, file, first, end, SIMPLE_EXTENT_UNWRITTEN);
+}
+
+// Journal credits for the allocation state log_alloc_state would log now,
+// plus the summary, inode bitmap and header blocks an operation may dirty
+static unsigned int alloc_state_credits(void) {
+    unsigned int credits = 3;
+    for (int i = 0; i < SIMPLE_BITMAP_CACHE; i++) {
+        credits += g_bitmaps[i].valid && g_bitmaps[i].dirty;
+    }
+    for (unsigned int i = 0; i < summary_blocks(); i++) {
+        credits += g_summary_dirty[i] != 0;
+    }
+    for (unsigned int i = 0; i < inode_bitmap_blocks(); i++) {
+        credits += g_inode_bitmap_dirty[i] != 0;
+    }
+    return credits;
+}
+
+// Log the block bitmap, summary and header if allocations changed them
+static int log_alloc_state(void) {
+    if (!g_bitmap_dirty) {
+        return 0;
+    }
+    
+    if (save_bitmap() != 0 || log_header() != 0) {
+        return -1;
+    }
+    g_bitmap_dirty = 0;
+    return 0;
+}
+
+// Open a journal handle for an operation logging credits blocks of its own
+// If the dirty allocation state and the operation do not fit one transaction
+// together, the allocation state is logged first under a handle of its own
+static int fs_start(unsigned int credits) {
+    unsigned int alloc = alloc_state_credits();
+    if (alloc + credits > JOURNAL_TXN_BLOCKS && alloc <= JOURNAL_TXN_BLOCKS) {
+        if (journal_start(alloc) != 0) {
+            return -1;
         }
-        
-        // Write block back to disk
-        if (write_block(inode->blocks[i], temp_buffer) != 1) {
-            break; // Write error
+        int result = log_alloc_state();
+        journal_stop();
+        if (result != 0) {
+            return -1;
         }
-        
-        bytes_written += write_size;
     }
+    return journal_start(alloc_state_credits() + credits);
+}
+
+// Commit everything logged so far as one journal transaction
+static int simple_fs_sync(void) {
+    if (!g_fs_mounted) {
+        return 0;
+    }
+    
+    if (fs_start(0) != 0) {
+        return -1;
+    }
+    int result = log_alloc_state();
+    journal_stop();
     
-    pmm_free_page((unsigned long long)temp_buffer);
+    return result == 0 ? journal_commit() : -1;
+}
+
+// Log an inode with the extent block and allocation state it relies on
+static int log_inode(vfs_node_t* node, simple_file_t* file) {
+    simple_inode_t* inode = &file->inode;
     
-    // Update file size if we wrote beyond current size
-    unsigned int new_size = offset + bytes_written;
-    if (new_size > inode->size) {
-        inode->size = new_size;
-        node->size = new_size;
+    // Blocks the inode points to are marked used in the same or an earlier transaction
+    if (log_alloc_state() != 0) {
+        return -1;
     }
     
-    // Update modification time
-    unsigned int current_time = (unsigned int)timer_get_ticks();
-    inode->modified_time = current_time;
-    node->modified_time = current_time;
+    if (file->more && file->more_dirty) {
+        if (log_meta(inode->extent_block, (unsigned char*)file->more) != 0) {
+            return -1;
+        }
+        file->more_dirty = 0;
+    }
     
-    // Write inode back to disk
-    write_inode(inode->inode_num, inode);
+    if (node->flags & VFS_NODE_DIRTY) {
+        inode->size = node->size;
+        inode->modified_time = node->modified_time;
+        inode->accessed_time = node->accessed_time;
+        if (write_inode(file->ino, inode) != 0) {
+            return -1;
+        }
+        node->flags &= ~VFS_NODE_DIRTY;
+    }
     
-    // Update file system header
-    write_block(FS_HEADER_BLOCK, (unsigned char*)&g_fs_header);
+    return 0;
+}
+
+// Simple file system write_inode function (logs the inode, committed later)
+static int simple_fs_write_inode(vfs_node_t* node) {
+    simple_file_t* file = (simple_file_t*)node->fs_data;
+    if (!file || fs_start(SIMPLE_INODE_CREDITS) != 0) {
+        return -1;
+    }
     
-    return bytes_written;
+    int result = log_inode(node, file);
+    journal_stop();
+    return result;
+}
+
+// Simple file system fsync function (inode plus the allocation state it relies on)
+static int simple_fs_fsync(vfs_node_t* node) {
+    if (simple_fs_write_inode(node) != 0) {
+        return -1;
+    }
+    return journal_commit();
 }
 
 // Simple file system open function
@@ -318,12 +916,8 @@ static int simple_fs_open(vfs_node_t* node, unsigned int flags) {
     // Update access time
     node->accessed_time = (unsigned int)timer_get_ticks();
     
-    // Update inode if it exists
-    simple_inode_t* inode = (simple_inode_t*)node->fs_data;
-    if (inode) {
-        inode->accessed_time = node->accessed_time;
-        write_inode(inode->inode_num, inode);
-    }
+    // The inode is written back later (fsync / flusher)
+    node->flags |= VFS_NODE_DIRTY;
     
     return 0;
 }
@@ -334,69 +928,820 @@ static int simple_fs_close(vfs_node_t* node) {
     return 0;
 }
 
+// Read block index of a directory (through the journal: directories are metadata)
+static int dir_read_block(simple_file_t* dir, unsigned int index, unsigned char* buffer) {
+    simple_extent_t* ext = find_extent(dir, index);
+    if (!ext) {
+        return -1;
+    }
+    return read_meta(ext->disk_block + (index - ext->file_block), buffer) == 1 ? 0 : -1;
+}
+
+// Log a changed directory block (entries may have moved: reset the readdir cursor)
+static int dir_write_block(simple_file_t* dir, unsigned int index, const unsigned char* buffer) {
+    simple_extent_t* ext = find_extent(dir, index);
+    if (!ext) {
+        return -1;
+    }
+    dir->rd_index = 0;
+    dir->rd_block = 0;
+    dir->rd_off = 0;
+    return log_meta(ext->disk_block + (index - ext->file_block), buffer);
+}
+
+// Record at offset off of a directory block, NULL if the block is corrupt there
+static simple_dirent_t* dir_record(unsigned char* block, unsigned int off) {
+    simple_dirent_t* de = (simple_dirent_t*)(block + off);
+    if (de->rec_len < sizeof(simple_dirent_t) || off + de->rec_len > SIMPLE_BLOCK_SIZE ||
+        (de->inode && SIMPLE_DIRENT_LEN(de->name_len) > de->rec_len)) {
+        return 0;
+    }
+    return de;
+}
+
+// Hash of a name (FNV-1a)
+static unsigned int dir_hash(const char* name, unsigned int name_len) {
+    unsigned int hash = 2166136261u;
+    for (unsigned int i = 0; i < name_len; i++) {
+        hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Bucket (directory block) of a hash, and its depth
+// Bucket b at depth d holds the names whose hashes end in the d bits of b;
+// once split it keeps those with bit d clear and block b + 2^d takes the
+// rest, so the walk follows the hash bit by bit while the next split exists
+static unsigned int dir_bucket(simple_file_t* dir, unsigned int hash, unsigned int* depth) {
+    unsigned int bucket = 0;
+    unsigned int d = 0;
+    while (d < SIMPLE_DIR_MAX_DEPTH && find_extent(dir, bucket + (1u << d))) {
+        bucket = hash & ((2u << d) - 1);
+        d++;
+    }
+    *depth = d;
+    return bucket;
+}
+
+// Put an entry into a directory block image
+// Takes an unused record or the slack after a live one
+// Returns 0 on success, -1 if the block has no room
+static int dir_place(unsigned char* block, const char* name, unsigned int name_len,
+                     unsigned int ino, unsigned int type) {
+    unsigned int need = SIMPLE_DIRENT_LEN(name_len);
+    simple_dirent_t* de;
+    for (unsigned int off = 0; off < SIMPLE_BLOCK_SIZE && (de = dir_record(block, off)); off += de->rec_len) {
+        unsigned int used = de->inode ? SIMPLE_DIRENT_LEN(de->name_len) : 0;
+        if (de->rec_len - used < need) {
+            continue;
+        }
+        
+        if (used) {
+            // Split: the new record takes the slack after this one
+            unsigned int rest = de->rec_len - used;
+            de->rec_len = used;
+            de = (simple_dirent_t*)(block + off + used);
+            de->rec_len = rest;
+        }
+        de->inode = ino;
+        de->name_len = name_len;
+        de->type = type;
+        memcpy(de->name, name, name_len);
+        return 0;
+    }
+    
+    return -1;
+}
+
+// Start an empty directory block image (one unused record covering it)
+static void dir_empty_block(unsigned char* block) {
+    memset(block, 0, SIMPLE_BLOCK_SIZE);
+    ((simple_dirent_t*)block)->rec_len = SIMPLE_BLOCK_SIZE;
+}
+
+// Split a full bucket at depth d: entries whose hash has bit d set move to
+// the new bucket at block bucket + 2^d (only those two blocks are rewritten)
+// Nothing is written unless both halves are complete
+// Returns 0 on success, -1 on error (too deep, out of space)
+static int dir_split(vfs_node_t* dir_node, unsigned int bucket, unsigned int depth) {
+    simple_file_t* dir = (simple_file_t*)dir_node->fs_data;
+    unsigned int high_bucket = bucket + (1u << depth);
+    if (depth >= SIMPLE_DIR_MAX_DEPTH) {
+        return -1;
+    }
+    
+    unsigned char old[SIMPLE_BLOCK_SIZE];
+    unsigned char low[SIMPLE_BLOCK_SIZE];
+    unsigned char high[SIMPLE_BLOCK_SIZE];
+    if (dir_read_block(dir, bucket, old) != 0) {
+        return -1;
+    }
+    dir_empty_block(low);
+    dir_empty_block(high);
+    
+    // Each half gets a subset of the old block's entries, packed
+    simple_dirent_t* de;
+    for (unsigned int off = 0; off < SIMPLE_BLOCK_SIZE && (de = dir_record(old, off)); off += de->rec_len) {
+        if (!de->inode) {
+            continue;
+        }
+        unsigned char* half = (dir_hash(de->name, de->name_len) >> depth) & 1 ? high : low;
+        if (dir_place(half, de->name, de->name_len, de->inode, de->type) != 0) {
+            return -1;
+        }
+    }
+    
+    if (map_blocks(dir_node, dir, high_bucket, high_bucket + 1, 0) != 0) {
+        return -1;
+    }
+    if ((high_bucket + 1) * SIMPLE_BLOCK_SIZE > dir_node->size) {
+        dir_node->size = (high_bucket + 1) * SIMPLE_BLOCK_SIZE;
+    }
+    dir_node->flags |= VFS_NODE_DIRTY;
+    
+    // New bucket and map before the old bucket loses its entries
+    if (dir_write_block(dir, high_bucket, high) != 0 || simple_fs_write_inode(dir_node) != 0) {
+        return -1;
+    }
+    return dir_write_block(dir, bucket, low);
+}
+
+// Add an entry for inode ino to a directory
+// Goes into the bucket its name hashes to; a full bucket is split, at most
+// SIMPLE_DIR_MAX_SPLITS times, so names whose hashes collide fail instead of
+// growing the directory without bound
+static int dir_add_entry(vfs_node_t* dir_node, const char* name, unsigned int name_len,
+                         unsigned int ino, unsigned int type) {
+    simple_file_t* dir = (simple_file_t*)dir_node->fs_data;
+    unsigned char block[SIMPLE_BLOCK_SIZE];
+    unsigned int hash = dir_hash(name, name_len);
+    
+    // First bucket of an empty directory
+    if (!find_extent(dir, 0)) {
+        if (map_blocks(dir_node, dir, 0, 1, 0) != 0) {
+            return -1;
+        }
+        dir_empty_block(block);
+        if (dir_place(block, name, name_len, ino, type) != 0) {
+            return -1;
+        }
+        if (dir_node->size < SIMPLE_BLOCK_SIZE) {
+            dir_node->size = SIMPLE_BLOCK_SIZE;
+        }
+        dir_node->flags |= VFS_NODE_DIRTY;
+        if (dir_write_block(dir, 0, block) != 0) {
+            return -1;
+        }
+        return simple_fs_write_inode(dir_node);
+    }
+    
+    for (unsigned int splits = 0; ; splits++) {
+        unsigned int depth;
+        unsigned int bucket = dir_bucket(dir, hash, &depth);
+        if (dir_read_block(dir, bucket, block) != 0) {
+            return -1;
+        }
+        if (dir_place(block, name, name_len, ino, type) == 0) {
+            return dir_write_block(dir, bucket, block);
+        }
+        
+        if (splits == SIMPLE_DIR_MAX_SPLITS || dir_split(dir_node, bucket, depth) != 0) {
+            return -1;
+        }
+    }
+}
+
+// Find the entry for a name
+// Reads the name's bucket into block; returns the record, or NULL if absent
+static simple_dirent_t* dir_find_entry(vfs_node_t* dir_node, const char* name, unsigned int name_len,
+                                       unsigned char* block) {
+    simple_file_t* dir = (simple_file_t*)dir_node->fs_data;
+    unsigned int depth;
+    unsigned int bucket = dir_bucket(dir, dir_hash(name, name_len), &depth);
+    if (dir_read_block(dir, bucket, block) != 0) {
+        return 0; // Empty directory
+    }
+    
+    simple_dirent_t* de;
+    for (unsigned int off = 0; off < SIMPLE_BLOCK_SIZE && (de = dir_record(block, off)); off += de->rec_len) {
+        if (de->inode && de->name_len == name_len && memcmp(de->name, name, name_len) == 0) {
+            return de;
+        }
+    }
+    
+    return 0;
+}
+
+// Remove the entry for a name from a directory
+// Its space joins the record before it, or the record is marked unused if
+// it starts the block
+static int dir_remove_entry(vfs_node_t* dir_node, const char* name, unsigned int name_len) {
+    simple_file_t* dir = (simple_file_t*)dir_node->fs_data;
+    unsigned char block[SIMPLE_BLOCK_SIZE];
+    simple_dirent_t* target = dir_find_entry(dir_node, name, name_len, block);
+    if (!target) {
+        return -1;
+    }
+    
+    simple_dirent_t* prev = 0;
+    simple_dirent_t* de;
+    for (unsigned int off = 0; (de = dir_record(block, off)) != target; off += de->rec_len) {
+        prev = de;
+    }
+    if (prev) {
+        prev->rec_len += target->rec_len;
+    } else {
+        target->inode = 0;
+    }
+    
+    unsigned int depth;
+    unsigned int bucket = dir_bucket(dir, dir_hash(name, name_len), &depth);
+    return dir_write_block(dir, bucket, block);
+}
+
+// Check whether a directory has no entries left
+static int dir_is_empty(vfs_node_t* dir_node) {
+    simple_file_t* dir = (simple_file_t*)dir_node->fs_data;
+    unsigned char block[SIMPLE_BLOCK_SIZE];
+    unsigned int buckets = dir_node->size / SIMPLE_BLOCK_SIZE;
+    
+    for (unsigned int b = 0; b < buckets; b++) {
+        if (!find_extent(dir, b)) {
+            continue; // Not split off yet
+        }
+        if (dir_read_block(dir, b, block) != 0) {
+            return 0;
+        }
+        simple_dirent_t* de;
+        for (unsigned int off = 0; off < SIMPLE_BLOCK_SIZE && (de = dir_record(block, off)); off += de->rec_len) {
+            if (de->inode) {
+                return 0;
+            }
+        }
+    }
+    
+    return 1;
+}
+
+// Load the in-memory state of inode ino (inode plus extent block)
+// Returns NULL if it is not a valid file or directory, or out of memory
+static simple_file_t* load_file(unsigned int ino) {
+    simple_file_t* file = (simple_file_t*)kmalloc(sizeof(simple_file_t));
+    if (!file) {
+        return 0;
+    }
+    file->ino = ino;
+    file->more = 0;
+    file->more_dirty = 0;
+    file->node = 0;
+    file->hash_next = 0;
+    file->rd_index = 0;
+    file->rd_block = 0;
+    file->rd_off = 0;
+    file->rd_entry = 0;
+    
+    simple_inode_t* inode = &file->inode;
+    if (read_inode(ino, inode) != 0 ||
+        (inode->type != FS_TYPE_FILE && inode->type != FS_TYPE_DIR) ||
+        inode->extent_count > SIMPLE_MAX_EXTENTS) {
+        kfree(file);
+        return 0;
+    }
+    
+    // Extents past the inline ones live in their own block
+    if (inode->extent_block) {
+        file->more = (simple_extent_t*)kmalloc(SIMPLE_BLOCK_SIZE);
+        if (!file->more || read_meta(inode->extent_block, (unsigned char*)file->more) != 1) {
+            if (file->more) {
+                kfree(file->more);
+            }
+            kfree(file);
+            return 0;
+        }
+    }
+    
+    return file;
+}
+
+// Loaded file for inode ino that has a node, or NULL
+static simple_file_t* file_hash_find(unsigned int ino) {
+    simple_file_t* file = g_file_hash[ino & (SIMPLE_FILE_BUCKETS - 1)];
+    while (file && file->ino != ino) {
+        file = file->hash_next;
+    }
+    return file;
+}
+
+// Add a file to the hash once its node exists
+static void file_hash_add(simple_file_t* file) {
+    simple_file_t** head = &g_file_hash[file->ino & (SIMPLE_FILE_BUCKETS - 1)];
+    file->hash_next = *head;
+    *head = file;
+}
+
+// Take a file out of the hash (no-op if it was never added)
+static void file_hash_remove(simple_file_t* file) {
+    simple_file_t** link = &g_file_hash[file->ino & (SIMPLE_FILE_BUCKETS - 1)];
+    while (*link && *link != file) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = file->hash_next;
+    }
+}
+
+// Release the in-memory state of a file
+static void release_file(simple_file_t* file) {
+    file_hash_remove(file);
+    if (file->more) {
+        kfree(file->more);
+    }
+    if (file->rd_entry) {
+        vfs_free_node(file->rd_entry);
+    }
+    kfree(file);
+}
+
+// Hook up the operations for a node backed by file
+static void set_node_ops(vfs_node_t* node, simple_file_t* file);
+
+// Create the VFS node for inode ino, named by its directory entry
+// Returns NULL on error
+static vfs_node_t* make_node(unsigned int ino, const char* name, unsigned int name_len) {
+    simple_file_t* file = load_file(ino);
+    if (!file) {
+        return 0;
+    }
+    
+    vfs_node_t* node = vfs_alloc_node();
+    if (!node) {
+        release_file(file);
+        return 0;
+    }
+    
+    memcpy(node->name, name, name_len);
+    node->name[name_len] = '\0';
+    set_node_ops(node, file);
+    file->node = node;
+    file_hash_add(file);
+    return node;
+}
+
+// Get the VFS node for a directory entry, loading it on first use
+// An inode has one name (no hard links), so a loaded one is found by number
+// Returns NULL on error
+static vfs_node_t* dir_child(vfs_node_t* dir_node, const char* name, unsigned int name_len, unsigned int ino) {
+    simple_file_t* loaded = file_hash_find(ino);
+    if (loaded && loaded->node->parent == dir_node) {
+        return loaded->node;
+    }
+    
+    vfs_node_t* node = make_node(ino, name, name_len);
+    if (!node) {
+        return 0;
+    }
+    node->parent = dir_node;
+    node->next = dir_node->child;
+    dir_node->child = node;
+    return node;
+}
+
+// Describe a directory entry without loading its inode
+// Returns the entry's node if it is loaded, otherwise the directory's
+// scratch node filled with the name, type and inode number
+static vfs_node_t* dir_entry_node(simple_file_t* dir, simple_dirent_t* de) {
+    simple_file_t* loaded = file_hash_find(de->inode);
+    if (loaded) {
+        return loaded->node;
+    }
+    
+    vfs_node_t* entry = dir->rd_entry;
+    memset(entry, 0, sizeof(vfs_node_t));
+    memcpy(entry->name, de->name, de->name_len);
+    entry->name[de->name_len] = '\0';
+    entry->type = de->type;
+    entry->inode = de->inode;
+    return entry;
+}
+
 // Simple file system readdir function
+// Entries come in on-disk order; a cursor makes reading them in sequence
+// cost one pass over the directory
+// Entries are not loaded: the node returned for one that is not in memory
+// is only valid until the next readdir of the same directory
 static vfs_node_t* simple_fs_readdir(vfs_node_t* node, unsigned int index) {
-    if (!node || node->type != FS_TYPE_DIR) {
+    simple_file_t* dir = (simple_file_t*)node->fs_data;
+    if (!dir || node->type != FS_TYPE_DIR) {
+        return 0;
+    }
+    if (!dir->rd_entry && !(dir->rd_entry = vfs_alloc_node())) {
         return 0;
     }
     
-    // For now, use the VFS in-memory structure
-    // In a full implementation, we'd read from disk inodes
-    vfs_node_t* current = node->child;
+    unsigned char block[SIMPLE_BLOCK_SIZE];
+    unsigned int buckets = node->size / SIMPLE_BLOCK_SIZE;
     unsigned int i = 0;
-    while (current && i < index) {
-        current = current->next;
-        i++;
+    unsigned int b = 0;
+    unsigned int off = 0;
+    if (index >= dir->rd_index) {
+        i = dir->rd_index;
+        b = dir->rd_block;
+        off = dir->rd_off;
     }
     
-    return current;
+    for (; b < buckets; b++, off = 0) {
+        if (!find_extent(dir, b)) {
+            continue; // Not split off yet
+        }
+        if (dir_read_block(dir, b, block) != 0) {
+            return 0;
+        }
+        
+        simple_dirent_t* de;
+        for (; off < SIMPLE_BLOCK_SIZE && (de = dir_record(block, off)); off += de->rec_len) {
+            if (!de->inode) {
+                continue;
+            }
+            if (i == index) {
+                dir->rd_index = i;
+                dir->rd_block = b;
+                dir->rd_off = off;
+                return dir_entry_node(dir, de);
+            }
+            i++;
+        }
+    }
+    
+    return 0;
 }
 
-// Simple file system finddir function
+// Simple file system finddir function (one bucket read)
 static vfs_node_t* simple_fs_finddir(vfs_node_t* node, const char* name) {
-    if (!node || node->type != FS_TYPE_DIR || !name) {
+    if (!node || !node->fs_data || node->type != FS_TYPE_DIR || !name) {
         return 0;
     }
     
-    // Search in child list
-    vfs_node_t* current = node->child;
-    while (current) {
-        // Simple string comparison
-        const char* n1 = current->name;
-        const char* n2 = name;
-        int match = 1;
-        while (*n1 && *n2 && *n1 == *n2) {
-            n1++;
-            n2++;
+    unsigned int name_len = 0;
+    while (name[name_len]) {
+        name_len++;
+    }
+    
+    unsigned char block[SIMPLE_BLOCK_SIZE];
+    simple_dirent_t* de = dir_find_entry(node, name, name_len, block);
+    if (!de) {
+        return 0; // Not found
+    }
+    return dir_child(node, name, name_len, de->inode);
+}
+
+// Free the last extents of a file until keep are left, at most
+// SIMPLE_UNLINK_EXTENTS per journal handle so any file fits the transactions
+// Each handle logs the shortened inode before the blocks it no longer maps
+// are freed: no committed bitmap frees a block a committed inode still maps.
+// Interrupted by a crash, the file survives with holes at the end
+// Returns 0 on success, -1 on error (the remaining extents stay mapped)
+static int truncate_extents(vfs_node_t* node, simple_file_t* file, unsigned int keep) {
+    while (file->inode.extent_count > keep) {
+        unsigned int count = file->inode.extent_count - keep;
+        if (count > SIMPLE_UNLINK_EXTENTS) {
+            count = SIMPLE_UNLINK_EXTENTS;
+        }
+        if (fs_start(SIMPLE_INODE_CREDITS + (count + 1) * SIMPLE_ALLOC_CREDITS) != 0) {
+            return -1;
+        }
+        
+        simple_extent_t freed[SIMPLE_UNLINK_EXTENTS];
+        for (unsigned int i = 0; i < count; i++) {
+            freed[i] = *extent_at(file, file->inode.extent_count - 1 - i);
         }
-        if (*n1 == '\0' && *n2 == '\0') {
-            return current; // Found
+        
+        // Back to inline extents only: the extent block goes too
+        unsigned int extent_block = 0;
+        file->inode.extent_count -= count;
+        if (file->more && file->inode.extent_count <= SIMPLE_INLINE_EXTENTS) {
+            extent_block = file->inode.extent_block;
+            file->inode.extent_block = 0;
+        }
+        node->flags |= VFS_NODE_DIRTY;
+        if (log_inode(node, file) != 0) {
+            file->inode.extent_count += count;
+            if (extent_block) {
+                file->inode.extent_block = extent_block;
+            }
+            journal_stop();
+            return -1;
         }
-        current = current->next;
+        
+        for (unsigned int i = 0; i < count; i++) {
+            unsigned int len = freed[i].length & SIMPLE_EXTENT_LEN_MASK;
+            if (node->type == FS_TYPE_DIR) {
+                for (unsigned int b = 0; b < len; b++) {
+                    journal_forget(freed[i].disk_block + b);
+                }
+            }
+            free_blocks(freed[i].disk_block, len);
+        }
+        if (extent_block) {
+            journal_forget(extent_block);
+            free_blocks(extent_block, 1);
+            kfree(file->more);
+            file->more = 0;
+            file->more_dirty = 0;
+        }
+        journal_stop();
     }
-    
-    return 0; // Not found
+    return 0;
 }
 
-// Simple file system unlink function
+// Simple file system unlink function (files, and directories once empty)
+// Large files are first cut down to SIMPLE_UNLINK_EXTENTS extents in
+// handles of their own; the name, the inode and the rest go in one more
 static int simple_fs_unlink(vfs_node_t* node) {
-    if (!node || node->type != FS_TYPE_FILE) {
+    simple_file_t* file = (simple_file_t*)node->fs_data;
+    vfs_node_t* parent = node->parent;
+    if (!file || !g_fs_mounted || !parent || !parent->fs_data ||
+        (node->type == FS_TYPE_DIR && !dir_is_empty(node))) {
         return -1;
     }
     
-    simple_inode_t* inode = (simple_inode_t*)node->fs_data;
-    if (inode) {
-        // Free all blocks used by the file
-        free_inode_blocks(inode);
-        
-        // Mark inode as free (simplified - in real FS, we'd have an inode bitmap)
-        // For now, just clear the inode
-        write_inode(inode->inode_num, inode);
+    if (truncate_extents(node, file, SIMPLE_UNLINK_EXTENTS) != 0) {
+        return -1;
+    }
+    
+    // Entry, parent inode, the inode itself, and the bitmap blocks that
+    // freeing each extent and the extent block may evict from the cache
+    unsigned int credits = 1 + 2 * SIMPLE_INODE_CREDITS + (file->inode.extent_count + 1) * SIMPLE_ALLOC_CREDITS;
+    if (fs_start(credits) != 0) {
+        return -1;
+    }
+    
+    // Drop the name first, then the blocks and the inode behind it
+    unsigned int name_len = 0;
+    while (node->name[name_len]) {
+        name_len++;
+    }
+    if (dir_remove_entry(parent, node->name, name_len) != 0) {
+        journal_stop();
+        return -1;
+    }
+    
+    // The zeroed inode is logged before any block is freed, so a failure
+    // here leaves every block mapped (the entry is put back)
+    simple_inode_t empty;
+    memset(&empty, 0, sizeof(empty));
+    parent->modified_time = (unsigned int)timer_get_ticks();
+    parent->flags |= VFS_NODE_DIRTY;
+    if (simple_fs_write_inode(parent) != 0 || write_inode(file->ino, &empty) != 0) {
+        dir_add_entry(parent, node->name, name_len, file->ino, file->inode.type);
+        journal_stop();
+        return -1;
+    }
+    
+    free_file_blocks(node, file);
+    memset(&file->inode, 0, sizeof(simple_inode_t));
+    free_inode(file->ino);
+    journal_stop();
+    
+    node->fs_data = 0;
+    release_file(file);
+    return 0;
+}
+
+// Simple file system create function (new file or directory in dir_node)
+static vfs_node_t* simple_fs_create(vfs_node_t* dir_node, const char* name, unsigned int name_len,
+                                    unsigned int type) {
+    simple_file_t* dir = (simple_file_t*)dir_node->fs_data;
+    if (!dir || !g_fs_mounted || name_len == 0 || name_len > 255 ||
+        (type != FS_TYPE_FILE && type != FS_TYPE_DIR)) {
+        return 0;
+    }
+    
+    // Inode, entry and parent inode are one update, directory growth included
+    if (fs_start(SIMPLE_CREATE_CREDITS) != 0) {
+        return 0;
+    }
+    
+    unsigned int ino;
+    if (alloc_inode(&ino) != 0) {
+        journal_stop();
+        return 0; // Inode table full
+    }
+    
+    unsigned int now = (unsigned int)timer_get_ticks();
+    simple_inode_t inode;
+    memset(&inode, 0, sizeof(inode));
+    inode.type = type;
+    inode.parent_inode = dir->ino;
+    if (type == FS_TYPE_DIR) {
+        inode.permissions = FS_PERM_OWNER | FS_PERM_GROUP << 3 | FS_PERM_GROUP << 6;
+    } else {
+        inode.permissions = (FS_PERM_READ | FS_PERM_WRITE) | FS_PERM_OTHER << 3 | FS_PERM_OTHER << 6;
+    }
+    inode.created_time = now;
+    inode.modified_time = now;
+    inode.accessed_time = now;
+    
+    if (write_inode(ino, &inode) != 0 || dir_add_entry(dir_node, name, name_len, ino, type) != 0) {
+        free_inode(ino);
+        journal_stop();
+        return 0;
+    }
+    // Directories never pass through the page cache: log the inode now
+    dir_node->modified_time = now;
+    dir_node->flags |= VFS_NODE_DIRTY;
+    if (simple_fs_write_inode(dir_node) != 0) {
+        dir_remove_entry(dir_node, name, name_len);
+        free_inode(ino);
+        journal_stop();
+        return 0;
+    }
+    journal_stop();
+    
+    return make_node(ino, name, name_len);
+}
+
+// Hook up the operations for a node backed by file
+static void set_node_ops(vfs_node_t* node, simple_file_t* file) {
+    simple_inode_t* inode = &file->inode;
+    node->type = inode->type;
+    node->size = inode->size;
+    node->inode = file->ino;
+    node->permissions = inode->permissions;
+    node->owner = inode->owner;
+    node->group = inode->group;
+    node->created_time = inode->created_time;
+    node->modified_time = inode->modified_time;
+    node->accessed_time = inode->accessed_time;
+    node->fs_data = file;
+    
+    node->write_inode = simple_fs_write_inode;
+    node->fsync = simple_fs_fsync;
+    node->open = simple_fs_open;
+    node->close = simple_fs_close;
+    node->unlink = simple_fs_unlink;
+    
+    if (inode->type == FS_TYPE_DIR) {
+        node->readdir = simple_fs_readdir;
+        node->finddir = simple_fs_finddir;
+        node->create = simple_fs_create;
+    } else {
+        node->readpage = simple_fs_readpage;
+        node->readpages = simple_fs_readpages;
+        node->bmap = simple_fs_bmap;
+        node->writepage = simple_fs_writepage;
+        node->writepages = simple_fs_writepages;
+        node->fallocate = simple_fs_fallocate;
+    }
+}
+
+// Back the mount point with the root directory
+// Entries below it are loaded on first lookup
+static int simple_fs_attach(vfs_node_t* mount_node) {
+    simple_file_t* root = load_file(g_fs_header.root_inode);
+    if (!root || root->inode.type != FS_TYPE_DIR) {
+        if (root) {
+            release_file(root);
+        }
+        return -1;
+    }
+    
+    set_node_ops(mount_node, root);
+    return 0;
+}
+
+// Write count copies of one block starting at block_num
+static int write_fill(unsigned int block_num, unsigned int count, unsigned char* block) {
+    unsigned char* run[SIMPLE_IO_RUN];
+    for (int i = 0; i < SIMPLE_IO_RUN; i++) {
+        run[i] = block;
     }
     
+    while (count) {
+        unsigned int n = count < SIMPLE_IO_RUN ? count : SIMPLE_IO_RUN;
+        if (ata_write_sectors_vec(block_num, n, run) != (int)n) {
+            return -1;
+        }
+        block_num += n;
+        count -= n;
+    }
     return 0;
 }
 
+// Write the on-disk structures of an empty file system (header last)
+static int format_disk(unsigned int groups) {
+    unsigned char block[SIMPLE_BLOCK_SIZE];
+    memset(block, 0, SIMPLE_BLOCK_SIZE);
+    
+    // No transaction left by an earlier file system may survive into the new log
+    if (write_fill(g_fs_header.journal_start, g_fs_header.journal_blocks, block) != 0 ||
+        journal_format(g_fs_header.journal_start, g_fs_header.journal_blocks) != 0) {
+        return -1;
+    }
+    
+    // Block bitmaps: all free, except bits past the end of a short last group
+    // (bitmap blocks reserved for groups the layout did not need stay zero)
+    if (write_fill(g_fs_header.bitmap_start, groups, block) != 0) {
+        return -1;
+    }
+    unsigned int last = g_fs_header.group_count - 1;
+    unsigned int* bits = (unsigned int*)block;
+    for (unsigned int bit = group_blocks(last); bit < SIMPLE_GROUP_BLOCKS; bit++) {
+        bits[bit / 32] |= 1u << (bit % 32);
+    }
+    if (ata_write_sectors(g_fs_header.bitmap_start + last, 1, block) != 1) {
+        return -1;
+    }
+    
+    // Group summary: every group starts out with all of its blocks free
+    unsigned short* counts = (unsigned short*)block;
+    for (unsigned int i = 0; i < summary_blocks(); i++) {
+        memset(block, 0, SIMPLE_BLOCK_SIZE);
+        for (unsigned int j = 0; j < SIMPLE_SUMMARY_PER_BLOCK; j++) {
+            unsigned int group = i * SIMPLE_SUMMARY_PER_BLOCK + j;
+            if (group < g_fs_header.group_count) {
+                counts[j] = group_blocks(group);
+            }
+        }
+        if (ata_write_sectors(g_fs_header.summary_start + i, 1, block) != 1) {
+            return -1;
+        }
+    }
+    
+    // Inode bitmap: the reserved inode 0 and the root are in use
+    memset(block, 0, SIMPLE_BLOCK_SIZE);
+    if (write_fill(g_fs_header.inode_bitmap_start, inode_bitmap_blocks(), block) != 0 ||
+        write_fill(g_fs_header.inode_start, g_fs_header.data_start - g_fs_header.inode_start, block) != 0) {
+        return -1;
+    }
+    bits[0] = 1u | (1u << g_fs_header.root_inode);
+    if (ata_write_sectors(g_fs_header.inode_bitmap_start, 1, block) != 1) {
+        return -1;
+    }
+    
+    // Root directory: no buckets yet, the first entry adds one
+    memset(block, 0, SIMPLE_BLOCK_SIZE);
+    simple_inode_t* root = (simple_inode_t*)(block + g_fs_header.root_inode * SIMPLE_INODE_SIZE);
+    root->type = FS_TYPE_DIR;
+    root->parent_inode = g_fs_header.root_inode;
+    root->permissions = FS_PERM_OWNER | FS_PERM_GROUP << 3 | FS_PERM_GROUP << 6;
+    if (ata_write_sectors(g_fs_header.inode_start, 1, block) != 1) {
+        return -1;
+    }
+    
+    memset(block, 0, SIMPLE_BLOCK_SIZE);
+    memcpy(block, &g_fs_header, sizeof(g_fs_header));
+    return ata_write_sectors(FS_HEADER_BLOCK, 1, block) == 1 ? 0 : -1;
+}
+
+// Write an empty file system
+int simple_fs_format(unsigned int total_blocks, unsigned int inode_count) {
+    if (g_fs_mounted || inode_count < 2) {
+        return -1;
+    }
+    
+    unsigned int journal = total_blocks / SIMPLE_JOURNAL_SHARE;
+    if (journal > SIMPLE_JOURNAL_BLOCKS) {
+        journal = SIMPLE_JOURNAL_BLOCKS;
+    }
+    if (journal < JOURNAL_MIN_BLOCKS) {
+        journal = JOURNAL_MIN_BLOCKS;
+    }
+    
+    // Bitmap blocks are sized for the whole disk: the group count depends on
+    // where the data starts, which depends on the metadata before it
+    unsigned int groups = (total_blocks + SIMPLE_GROUP_BLOCKS - 1) / SIMPLE_GROUP_BLOCKS;
+    
+    memset(&g_fs_header, 0, sizeof(g_fs_header));
+    g_fs_header.magic = SIMPLE_FS_MAGIC;
+    g_fs_header.version = SIMPLE_FS_VERSION;
+    g_fs_header.root_inode = 1;
+    g_fs_header.total_blocks = total_blocks;
+    memcpy(g_fs_header.label, "zenith", 7);
+    g_fs_header.inode_count = inode_count;
+    g_fs_header.group_count = groups;
+    g_fs_header.journal_start = FS_HEADER_BLOCK + 1;
+    g_fs_header.journal_blocks = journal;
+    g_fs_header.bitmap_start = g_fs_header.journal_start + journal;
+    g_fs_header.summary_start = g_fs_header.bitmap_start + groups;
+    g_fs_header.inode_bitmap_start = g_fs_header.summary_start + summary_blocks();
+    g_fs_header.inode_start = g_fs_header.inode_bitmap_start + inode_bitmap_blocks();
+    g_fs_header.data_start = g_fs_header.inode_start +
+                             (inode_count + SIMPLE_INODES_PER_BLOCK - 1) / SIMPLE_INODES_PER_BLOCK;
+    if (g_fs_header.data_start >= total_blocks) {
+        return -1; // Too small for its own metadata
+    }
+    
+    unsigned int data_blocks = total_blocks - g_fs_header.data_start;
+    g_fs_header.group_count = (data_blocks + SIMPLE_GROUP_BLOCKS - 1) / SIMPLE_GROUP_BLOCKS;
+    g_fs_header.free_blocks = data_blocks;
+    g_fs_header.free_inodes = inode_count - 2;
+    
+    vfs_lock();
+    int result = format_disk(groups);
+    vfs_unlock();
+    return result;
+}
+
 // Initialize simple file system
 int simple_fs_init(void) {
     g_fs_mounted = 0;
@@ -406,18 +1751,32 @@ int simple_fs_init(void) {
 // Mount simple file system
 int simple_fs_mount(const char* device, const char* mountpoint) {
     // Read file system header from sector 0
-    if (read_block(FS_HEADER_BLOCK, (unsigned char*)&g_fs_header) != 1) {
+    if (read_header() != 0) {
         return -1; // Read error
     }
     
     // Check magic number
-    if (g_fs_header.magic != SIMPLE_FS_MAGIC) {
-        return -1; // Invalid file system
+    if (g_fs_header.magic != SIMPLE_FS_MAGIC || g_fs_header.version != SIMPLE_FS_VERSION) {
+        return -1; // Invalid file system or older on-disk format
+    }
+    
+    // Replay metadata committed before an unclean shutdown, then re-read the
+    // header it may have updated (the journal's own location never changes)
+    if (journal_open(g_fs_header.journal_start, g_fs_header.journal_blocks) != 0 ||
+        read_header() != 0) {
+        return -1;
     }
     
-    // Load block bitmap
-    if (load_bitmap() != 1) {
-        return -1; // Failed to load bitmap
+    // Load the per-group free counts (bitmap blocks are read on demand)
+    // and the inode bitmap
+    if (load_summary() != 0 || load_inode_bitmap() != 0) {
+        return -1; // Failed to load allocation state
+    }
+    
+    // Make the files visible under the mount point
+    vfs_node_t* mount_node = vfs_find_node(mountpoint);
+    if (!mount_node || simple_fs_attach(mount_node) != 0) {
+        return -1;
     }
     
     g_fs_mounted = 1;
@@ -430,7 +1789,8 @@ void simple_fs_register(void) {
         .name = "simple",
         .mount = simple_fs_mount,
         .unmount = 0, // Not implemented
-        .open = 0     // Will be handled by VFS
+        .open = 0,    // Will be handled by VFS
+        .sync = simple_fs_sync
     };
     
     vfs_register_filesystem(&fs);
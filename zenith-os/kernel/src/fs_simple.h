@@ -15,30 +15,90 @@ typedef struct {
     unsigned int total_blocks;   // Total blocks in file system
     unsigned int free_blocks;     // Free blocks
     char label[32];              // Volume label
+    unsigned int bitmap_start;    // First free-space bitmap block (one per group)
+    unsigned int summary_start;   // First block of per-group free counts
+    unsigned int group_count;     // Allocation groups (4096 data blocks each)
+    unsigned int inode_start;     // First inode table block
+    unsigned int data_start;      // First data block
+    unsigned int journal_start;   // First block of the metadata journal
+    unsigned int journal_blocks;  // Size of the journal
+    unsigned int inode_count;     // Inodes in the table (fixed at format time)
+    unsigned int free_inodes;     // Free inodes
+    unsigned int inode_bitmap_start; // First inode bitmap block (1 bit per inode)
 } __attribute__((packed)) simple_fs_header_t;
 
-// Inode structure
+// On-disk format version (2: extent-mapped files, 3: allocation groups,
+// 4: metadata journal, 5: dense inode table and directory entries,
+// 6: hashed directories)
+#define SIMPLE_FS_VERSION 6
+
+// Extent: a run of file blocks stored in consecutive disk blocks
+typedef struct {
+    unsigned int file_block;      // First file block covered
+    unsigned int disk_block;      // Disk block holding file_block
+    unsigned int length;          // Number of blocks, plus SIMPLE_EXTENT_UNWRITTEN
+} __attribute__((packed)) simple_extent_t;
+
+// Length flag: blocks are reserved (fallocate) but never written, read as zero
+#define SIMPLE_EXTENT_UNWRITTEN  0x80000000
+#define SIMPLE_EXTENT_LEN_MASK   0x7FFFFFFF
+
+// Extents held in the inode, and in the extent block once those run out
+#define SIMPLE_INLINE_EXTENTS    7
+#define SIMPLE_BLOCK_EXTENTS     (512 / sizeof(simple_extent_t))
+#define SIMPLE_MAX_EXTENTS       (SIMPLE_INLINE_EXTENTS + SIMPLE_BLOCK_EXTENTS)
+
+// Inode structure (SIMPLE_INODE_SIZE bytes, packed SIMPLE_INODES_PER_BLOCK to a block)
+// Inode n lives in block inode_start + n / SIMPLE_INODES_PER_BLOCK
 typedef struct {
-    unsigned int inode_num;       // Inode number
-    unsigned int type;            // File type
+    unsigned int type;            // File type (0 = free)
     unsigned int size;            // File size
-    unsigned int blocks[16];      // Block pointers (direct)
-    unsigned int parent_inode;    // Parent directory inode
-    char name[256];              // File name
+    unsigned int parent_inode;    // Directory holding this inode's entry
     unsigned int permissions;     // File permissions (rwx for owner/group/other)
     unsigned int owner;           // Owner user ID
     unsigned int group;           // Group ID
     unsigned int created_time;    // Creation timestamp
     unsigned int modified_time;   // Modification timestamp
     unsigned int accessed_time;   // Access timestamp
+    unsigned int extent_count;    // Extents in use (inline ones first)
+    unsigned int extent_block;    // Block holding further extents (0 = none)
+    simple_extent_t extents[SIMPLE_INLINE_EXTENTS]; // Block map (unordered)
 } __attribute__((packed)) simple_inode_t;
 
+#define SIMPLE_INODE_SIZE        128
+#define SIMPLE_INODES_PER_BLOCK  (512 / SIMPLE_INODE_SIZE)
+
+// Directory entry: directories are files made of 512-byte blocks of these
+// records, each block fully covered by its records (names live here, not
+// in the inode)
+// Directories are hash tables: each block is a bucket, an entry goes in the
+// bucket its name hashes to, and a full bucket b holding the hashes that end
+// in its d bits is split, those with bit d set moving to block b + 2^d
+// (blocks not split off yet are holes)
+typedef struct {
+    unsigned int inode;           // Inode number (0 = unused record)
+    unsigned short rec_len;       // Bytes from this record to the next
+    unsigned char name_len;       // Name length (not NUL-terminated)
+    unsigned char type;           // File type of the inode
+    char name[];                  // Name
+} __attribute__((packed)) simple_dirent_t;
+
+// Bytes a record needs for a name of length n (4-byte aligned)
+#define SIMPLE_DIRENT_LEN(n) ((sizeof(simple_dirent_t) + (n) + 3) & ~3u)
+
 // Initialize simple file system
 int simple_fs_init(void);
 
 // Mount simple file system
 int simple_fs_mount(const char* device, const char* mountpoint);
 
+// Write an empty file system over the first total_blocks blocks of the disk
+// with room for inode_count inodes (inode 0 is reserved, the root is inode 1)
+// Lays out the header, journal, block and inode bitmaps, group summary,
+// inode table and an empty root directory. Fails while mounted
+// Returns 0 on success, -1 on error (too small, I/O error)
+int simple_fs_format(unsigned int total_blocks, unsigned int inode_count);
+
 // Register simple file system with VFS
 void simple_fs_register(void);
 
@@ -16,9 +16,30 @@ typedef struct {
     unsigned int base;
 } __attribute__((packed)) gdt_ptr_t;
 
-// GDT with 5 entries: Null, Kernel CS, Kernel DS, User CS, User DS
-static gdt_entry_t gdt[5];
+// Task state segment (only SS0/ESP0 and the I/O map base are used)
+typedef struct {
+    unsigned int prev_tss;
+    unsigned int esp0;
+    unsigned int ss0;
+    unsigned int esp1;
+    unsigned int ss1;
+    unsigned int esp2;
+    unsigned int ss2;
+    unsigned int cr3;
+    unsigned int eip;
+    unsigned int eflags;
+    unsigned int eax, ecx, edx, ebx;
+    unsigned int esp, ebp, esi, edi;
+    unsigned int es, cs, ss, ds, fs, gs;
+    unsigned int ldt;
+    unsigned short trap;
+    unsigned short iomap_base;
+} tss_t; // 104 bytes, naturally aligned (no padding)
+
+// GDT with 6 entries: Null, Kernel CS, Kernel DS, User CS, User DS, TSS
+static gdt_entry_t gdt[6];
 static gdt_ptr_t gdt_ptr;
+static tss_t g_tss;
 
 // Set a GDT entry
 static void gdt_set_entry(int num, unsigned int base, unsigned int limit, unsigned char access, unsigned char gran) {
@@ -35,7 +56,7 @@ static void gdt_set_entry(int num, unsigned int base, unsigned int limit, unsign
 // Initialize GDT
 void gdt_init(void) {
     // Set up GDT pointer
-    gdt_ptr.limit = (sizeof(gdt_entry_t) * 5) - 1;
+    gdt_ptr.limit = (sizeof(gdt_entry_t) * 6) - 1;
     gdt_ptr.base = (unsigned int)&gdt;
     
     // Null descriptor
@@ -61,8 +82,31 @@ void gdt_init(void) {
     // Granularity: 0xCF
     gdt_set_entry(4, 0, 0xFFFFFFFF, 0xF2, 0xCF);
     
+    // Task state segment
+    // Access: 0x89 (present, ring 0, 32-bit available TSS), byte granularity
+    // Interrupts from ring 3 load SS0:ESP0 from here; no I/O permission map
+    for (unsigned int i = 0; i < sizeof(tss_t); i++) {
+        ((unsigned char*)&g_tss)[i] = 0;
+    }
+    g_tss.ss0 = GDT_KERNEL_DS;
+    g_tss.iomap_base = sizeof(tss_t);
+    gdt_set_entry(5, (unsigned int)&g_tss, sizeof(tss_t) - 1, 0x89, 0x00);
+    
     // Load GDT
     gdt_reload();
+    
+    // Load task register
+    asm volatile ("ltr %%ax" : : "a"(GDT_TSS));
+}
+
+// Set kernel stack for ring 3 -> ring 0 transitions
+void gdt_set_kernel_stack(unsigned int esp0) {
+    g_tss.esp0 = esp0;
+}
+
+// Get address of the TSS ESP0 slot
+unsigned int* gdt_get_kernel_stack_slot(void) {
+    return &g_tss.esp0;
 }
 
 // Reload GDT
@@ -7,6 +7,10 @@
 #define GDT_KERNEL_DS  0x10  // Kernel data segment
 #define GDT_USER_CS    0x18  // User code segment (Ring 3)
 #define GDT_USER_DS    0x20  // User data segment (Ring 3)
+#define GDT_TSS        0x28  // Task state segment
+
+// Requested privilege level bits for ring 3 selectors
+#define GDT_RPL_USER   0x03
 
 // Initialize GDT with kernel and user segments
 void gdt_init(void);
@@ -14,5 +18,11 @@ void gdt_init(void);
 // Reload GDT (call after modifying)
 void gdt_reload(void);
 
+// Set the kernel stack the CPU switches to on ring 3 -> ring 0 transitions
+void gdt_set_kernel_stack(unsigned int esp0);
+
+// Address of the TSS ESP0 slot (SYSENTER loads its stack pointer from here)
+unsigned int* gdt_get_kernel_stack_slot(void);
+
 #endif // GDT_H
 
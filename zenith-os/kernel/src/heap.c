@@ -1,13 +1,24 @@
 #include "heap.h"
 #include "paging.h"
 #include "memory.h"
+#include "string.h"
 
 // Heap configuration
 #define HEAP_START 0xE0000000  // Virtual address where heap starts (3.5GB)
 #define HEAP_INITIAL_SIZE (1024 * 1024)  // Initial heap size: 1MB
 #define HEAP_GROW_SIZE (1024 * 1024)     // Grow heap by 1MB at a time
-#define MIN_BLOCK_SIZE 16                 // Minimum allocation size
+#define MIN_BLOCK_SIZE 16                 // Minimum allocation size (holds the free list links)
 #define ALIGNMENT 8                        // Alignment requirement
+#define HEAP_DEFAULT_TRIM_THRESHOLD (512 * 1024)  // Trim once this much free memory is resident
+
+// Free list links, stored in the payload of free blocks
+typedef struct heap_free_links {
+    heap_block_t* next;       // Next free block in the same size class
+    heap_block_t* prev;       // Previous free block in the same size class
+} heap_free_links_t;
+
+// Per-block overhead (header + footer)
+#define BLOCK_OVERHEAD (sizeof(heap_block_t) + sizeof(heap_footer_t))
 
 // Heap state
 static heap_block_t* g_heap_start = 0;
@@ -15,6 +26,16 @@ static unsigned int g_heap_size = 0;
 static unsigned int g_heap_used = 0;
 static unsigned int g_heap_initialized = 0;
 
+// Trimming state
+static unsigned int g_heap_resident = 0;       // Bytes of heap backed by physical frames
+static unsigned int g_heap_reclaimed = 0;      // Total bytes returned to the PMM
+static unsigned int g_trim_threshold = HEAP_DEFAULT_TRIM_THRESHOLD;
+static unsigned int g_freed_since_trim = 0;    // Bytes freed since the last trim (re-arms it)
+
+// Segregated free lists, one per power-of-two size class
+static heap_block_t* g_free_lists[HEAP_NUM_CLASSES];
+static unsigned int g_free_mask = 0;  // Bit n set if g_free_lists[n] is non-empty
+
 // Align a size to ALIGNMENT boundary
 static unsigned int align_size(unsigned int size) {
     return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
@@ -32,89 +53,208 @@ static void* get_block_data(heap_block_t* block) {
     return (unsigned char*)block + sizeof(heap_block_t);
 }
 
-// Find a free block that can fit the requested size
-static heap_block_t* find_free_block(unsigned int size) {
-    if (!g_heap_start || g_heap_size == 0) {
+// Get the footer of a block
+static heap_footer_t* get_block_footer(heap_block_t* block) {
+    return (heap_footer_t*)((unsigned char*)block + sizeof(heap_block_t) + block->size);
+}
+
+// Get the free list links of a free block
+static heap_free_links_t* get_links(heap_block_t* block) {
+    return (heap_free_links_t*)get_block_data(block);
+}
+
+// Write header and footer of a block
+static void set_block(heap_block_t* block, unsigned int size, unsigned int used) {
+    block->size = size;
+    block->used = used;
+    heap_footer_t* footer = get_block_footer(block);
+    footer->size = size;
+    footer->used = used;
+}
+
+// Block physically after this one, or NULL at the end of the heap
+static heap_block_t* next_block(heap_block_t* block) {
+    unsigned int next_addr = (unsigned int)block + BLOCK_OVERHEAD + block->size;
+    if (next_addr >= HEAP_START + g_heap_size) {
         return 0;
     }
+    return (heap_block_t*)next_addr;
+}
+
+// Block physically before this one (via its footer), or NULL at the start
+static heap_block_t* prev_block(heap_block_t* block) {
+    if ((unsigned int)block <= HEAP_START) {
+        return 0;
+    }
+    heap_footer_t* footer = (heap_footer_t*)((unsigned char*)block - sizeof(heap_footer_t));
+    return (heap_block_t*)((unsigned char*)footer - footer->size - sizeof(heap_block_t));
+}
+
+// Size class of a payload size: floor(log2(size)) - 4, clamped
+static unsigned int size_class(unsigned int size) {
+    unsigned int cls = 31 - __builtin_clz(size) - 4;
+    if (cls >= HEAP_NUM_CLASSES) {
+        cls = HEAP_NUM_CLASSES - 1;
+    }
+    return cls;
+}
+
+// Insert a free block into its size class
+static void free_list_insert(heap_block_t* block) {
+    unsigned int cls = size_class(block->size);
+    heap_free_links_t* links = get_links(block);
+    
+    links->prev = 0;
+    links->next = g_free_lists[cls];
+    if (g_free_lists[cls]) {
+        get_links(g_free_lists[cls])->prev = block;
+    }
+    g_free_lists[cls] = block;
+    g_free_mask |= 1u << cls;
+}
+
+// Remove a free block from its size class
+static void free_list_remove(heap_block_t* block) {
+    unsigned int cls = size_class(block->size);
+    heap_free_links_t* links = get_links(block);
     
-    heap_block_t* current = g_heap_start;
-    unsigned int heap_end = (unsigned int)g_heap_start + g_heap_size;
+    if (links->prev) {
+        get_links(links->prev)->next = links->next;
+    } else {
+        g_free_lists[cls] = links->next;
+    }
+    if (links->next) {
+        get_links(links->next)->prev = links->prev;
+    }
     
-    while ((unsigned int)current < heap_end) {
-        // Validate block header
-        if (current->size > g_heap_size) {
-            break; // Invalid block
-        }
-        
-        if (!current->used && current->size >= size) {
-            return current;
-        }
-        
-        // Move to next block
-        unsigned int next_addr = (unsigned int)current + sizeof(heap_block_t) + current->size;
-        if (next_addr >= heap_end) {
-            break;
+    if (!g_free_lists[cls]) {
+        g_free_mask &= ~(1u << cls);
+    }
+}
+
+// Find a free block that can fit the requested size
+static heap_block_t* find_free_block(unsigned int size) {
+    unsigned int cls = size_class(size);
+    
+    // Blocks in the request's own class may still be too small: first fit
+    for (heap_block_t* block = g_free_lists[cls]; block; block = get_links(block)->next) {
+        if (block->size >= size) {
+            return block;
         }
-        current = (heap_block_t*)next_addr;
     }
     
-    return 0;
+    // Any block in a larger class fits
+    unsigned int mask = g_free_mask & ~((2u << cls) - 1);
+    if (!mask) {
+        return 0;
+    }
+    return g_free_lists[__builtin_ctz(mask)];
 }
 
-// Split a block if it's too large
+// Split a block if it's too large, returning the remainder to the free lists
+// block must already be off the free lists
 static void split_block(heap_block_t* block, unsigned int size) {
-    if (!block || block->used) return;
+    if (!block) return;
     
     unsigned int remaining = block->size - size;
-    if (remaining >= sizeof(heap_block_t) + MIN_BLOCK_SIZE) {
-        // Create a new free block from the remainder
-        heap_block_t* new_block = (heap_block_t*)((unsigned char*)block + sizeof(heap_block_t) + size);
-        new_block->size = remaining - sizeof(heap_block_t);
-        new_block->used = 0;
-        new_block->next = 0;
+    if (remaining >= BLOCK_OVERHEAD + MIN_BLOCK_SIZE) {
+        unsigned int used = block->used;
+        set_block(block, size, used);
         
-        // Update original block
-        block->size = size;
+        // Create a new free block from the remainder
+        heap_block_t* new_block = (heap_block_t*)((unsigned char*)block + BLOCK_OVERHEAD + size);
+        set_block(new_block, remaining - BLOCK_OVERHEAD, 0);
+        free_list_insert(new_block);
     }
 }
 
-// Merge adjacent free blocks
-static void merge_free_blocks(void) {
-    if (!g_heap_start || g_heap_size == 0) {
-        return;
+// Merge a free block (not on any list) with its free neighbours and list the result
+static heap_block_t* coalesce(heap_block_t* block) {
+    heap_block_t* next = next_block(block);
+    if (next && !next->used) {
+        free_list_remove(next);
+        set_block(block, block->size + BLOCK_OVERHEAD + next->size, 0);
     }
     
-    // Keep merging until no more merges are possible
-    int merged = 1;
-    while (merged) {
-        merged = 0;
-        heap_block_t* current = g_heap_start;
-        unsigned int heap_end = (unsigned int)g_heap_start + g_heap_size;
+    heap_block_t* prev = prev_block(block);
+    if (prev && !prev->used) {
+        free_list_remove(prev);
+        set_block(prev, prev->size + BLOCK_OVERHEAD + block->size, 0);
+        block = prev;
+    }
+    
+    free_list_insert(block);
+    return block;
+}
+
+// Page-aligned helpers
+static unsigned int page_round_up(unsigned int addr) {
+    return (addr + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+}
+
+static unsigned int page_round_down(unsigned int addr) {
+    return addr & ~(PAGE_SIZE - 1);
+}
+
+// Back every unmapped page in [start, end) with a fresh frame
+static int heap_populate(unsigned int start, unsigned int end) {
+    for (unsigned int addr = page_round_down(start); addr < end; addr += PAGE_SIZE) {
+        if (paging_get_physical(addr)) {
+            continue;
+        }
         
-        while ((unsigned int)current < heap_end) {
-            if (!current->used) {
-                // Check if next block is adjacent and free
-                unsigned int next_addr = (unsigned int)current + sizeof(heap_block_t) + current->size;
-                if (next_addr < heap_end) {
-                    heap_block_t* next = (heap_block_t*)next_addr;
-                    if (!next->used) {
-                        // Merge blocks
-                        current->size += sizeof(heap_block_t) + next->size;
-                        merged = 1;
-                        continue; // Check this block again for further merges
-                    }
-                }
-            }
-            
-            // Move to next block
-            unsigned int next_addr = (unsigned int)current + sizeof(heap_block_t) + current->size;
-            if (next_addr >= heap_end) {
-                break;
-            }
-            current = (heap_block_t*)next_addr;
+        unsigned long long frame = pmm_alloc_page();
+        if (!frame) {
+            return -1; // Out of memory
+        }
+        if (paging_map_page(addr, (unsigned int)frame, PAGE_PRESENT | PAGE_WRITABLE) != 0) {
+            pmm_free_page(frame);
+            return -1;
         }
+        pmm_get_page(frame)->flags |= PG_KERNEL;
+        g_heap_resident += PAGE_SIZE;
     }
+    return 0;
+}
+
+// Unmap every mapped page in [start, end) (page aligned) and return the frames
+// Returns number of bytes released
+static unsigned int heap_release(unsigned int start, unsigned int end) {
+    unsigned int released = 0;
+    for (unsigned int addr = start; addr < end; addr += PAGE_SIZE) {
+        unsigned int phys = paging_get_physical(addr);
+        if (!phys) {
+            continue;
+        }
+        
+        paging_unmap_page(addr);
+        pmm_free_page(phys & ~(PAGE_SIZE - 1));
+        g_heap_resident -= PAGE_SIZE;
+        released += PAGE_SIZE;
+    }
+    return released;
+}
+
+// Release the whole pages inside a free block
+// The header, free list links and footer always stay mapped
+static void trim_block(heap_block_t* block) {
+    unsigned int start = page_round_up((unsigned int)get_block_data(block) + sizeof(heap_free_links_t));
+    unsigned int end = page_round_down((unsigned int)get_block_footer(block));
+    if (start < end) {
+        g_heap_reclaimed += heap_release(start, end);
+    }
+}
+
+// Make sure a free block can be carved into a used block of `size` bytes:
+// the new payload, its footer and the remainder's header and links must be mapped
+static int populate_block(heap_block_t* block, unsigned int size) {
+    unsigned int end = (unsigned int)get_block_data(block) + size + sizeof(heap_footer_t) +
+                       sizeof(heap_block_t) + sizeof(heap_free_links_t);
+    unsigned int block_end = (unsigned int)get_block_footer(block);
+    if (end > block_end) {
+        end = block_end;
+    }
+    return heap_populate((unsigned int)block, end);
 }
 
 // Grow the heap
@@ -123,43 +263,23 @@ static int grow_heap(unsigned int size) {
     unsigned int pages_needed = (size + PAGE_SIZE - 1) / PAGE_SIZE;
     if (pages_needed == 0) pages_needed = 1;
     
-    // Allocate physical pages
-    unsigned long long physical_addr = pmm_alloc_pages(pages_needed);
-    if (!physical_addr) {
-        return -1; // Out of memory
-    }
-    
-    // Map virtual pages
+    // Map fresh frames one page at a time so they can be trimmed individually
     unsigned int virtual_addr = HEAP_START + g_heap_size;
-    for (unsigned int i = 0; i < pages_needed; i++) {
-        if (paging_map_page(virtual_addr + i * PAGE_SIZE, 
-                           (unsigned int)physical_addr + i * PAGE_SIZE,
-                           PAGE_PRESENT | PAGE_WRITABLE) != 0) {
-            // Failed to map, free allocated pages
-            pmm_free_pages(physical_addr, pages_needed);
-            return -1;
-        }
+    if (heap_populate(virtual_addr, virtual_addr + pages_needed * PAGE_SIZE) != 0) {
+        heap_release(virtual_addr, virtual_addr + pages_needed * PAGE_SIZE);
+        return -1; // Out of memory
     }
     
-    // Initialize new heap space
     if (g_heap_size == 0) {
-        // First allocation - initialize first block
         g_heap_start = (heap_block_t*)HEAP_START;
-        g_heap_start->size = pages_needed * PAGE_SIZE - sizeof(heap_block_t);
-        g_heap_start->used = 0;
-        g_heap_start->next = 0;
-    } else {
-        // Add new free block at the end
-        heap_block_t* new_block = (heap_block_t*)(HEAP_START + g_heap_size);
-        new_block->size = pages_needed * PAGE_SIZE - sizeof(heap_block_t);
-        new_block->used = 0;
-        new_block->next = 0;
-        
-        // Try to merge with previous block
-        merge_free_blocks();
     }
     
+    // New space becomes one free block, merged with a free block at the old end
+    heap_block_t* new_block = (heap_block_t*)virtual_addr;
     g_heap_size += pages_needed * PAGE_SIZE;
+    set_block(new_block, pages_needed * PAGE_SIZE - BLOCK_OVERHEAD, 0);
+    coalesce(new_block);
+    
     return 0;
 }
 
@@ -169,6 +289,11 @@ int heap_init(void) {
         return 0; // Already initialized
     }
     
+    for (int i = 0; i < HEAP_NUM_CLASSES; i++) {
+        g_free_lists[i] = 0;
+    }
+    g_free_mask = 0;
+    
     // Grow heap to initial size
     if (grow_heap(HEAP_INITIAL_SIZE) != 0) {
         return -1;
@@ -201,7 +326,11 @@ void* kmalloc(unsigned int size) {
     
     if (!block) {
         // No free block found, try to grow heap
-        if (grow_heap(HEAP_GROW_SIZE) != 0) {
+        unsigned int grow = HEAP_GROW_SIZE;
+        if (grow < size + BLOCK_OVERHEAD) {
+            grow = size + BLOCK_OVERHEAD;
+        }
+        if (grow_heap(grow) != 0) {
             return 0; // Out of memory
         }
         
@@ -212,12 +341,18 @@ void* kmalloc(unsigned int size) {
         }
     }
     
-    // Split block if necessary
-    split_block(block, size);
+    // Trimmed pages inside the block are mapped back in first
+    if (populate_block(block, size) != 0) {
+        return 0; // Out of memory
+    }
     
-    // Mark as used
+    // Take it off its list, mark as used and split off the excess
+    free_list_remove(block);
     block->used = 1;
-    g_heap_used += block->size + sizeof(heap_block_t);
+    get_block_footer(block)->used = 1;
+    split_block(block, size);
+    
+    g_heap_used += block->size + BLOCK_OVERHEAD;
     
     return get_block_data(block);
 }
@@ -241,11 +376,20 @@ void kfree(void* ptr) {
     }
     
     // Mark as free
-    block->used = 0;
-    g_heap_used -= block->size + sizeof(heap_block_t);
-    
-    // Try to merge with adjacent free blocks
-    merge_free_blocks();
+    g_heap_used -= block->size + BLOCK_OVERHEAD;
+    g_freed_since_trim += block->size + BLOCK_OVERHEAD;
+    set_block(block, block->size, 0);
+    
+    // Merge with adjacent free blocks (O(1) via boundary tags)
+    coalesce(block);
+    
+    // High-water policy: give memory back once too much of it sits idle, but
+    // only after another threshold's worth of frees since the last pass, so
+    // steady churn above the mark does not rescan the free lists every time
+    if (g_trim_threshold && g_freed_since_trim >= g_trim_threshold &&
+        g_heap_resident - g_heap_used > g_trim_threshold) {
+        heap_trim();
+    }
 }
 
 // Reallocate memory
@@ -268,9 +412,36 @@ void* krealloc(void* ptr, unsigned int size) {
     }
     
     size = align_size(size);
+    if (size < MIN_BLOCK_SIZE) {
+        size = MIN_BLOCK_SIZE;
+    }
     
-    // If new size is smaller or same, just return same pointer
+    // Shrink in place, handing the tail back to the free lists
     if (size <= block->size) {
+        g_heap_used -= block->size;
+        split_block(block, size);
+        g_heap_used += block->size;
+        
+        // The split-off tail may border another free block
+        heap_block_t* tail = next_block(block);
+        if (tail && !tail->used) {
+            free_list_remove(tail);
+            coalesce(tail);
+        }
+        return ptr;
+    }
+    
+    // Grow in place by absorbing a free successor
+    heap_block_t* next = next_block(block);
+    unsigned int spill = size - block->size;
+    spill = (spill > BLOCK_OVERHEAD) ? spill - BLOCK_OVERHEAD : 0;
+    if (next && !next->used && block->size + BLOCK_OVERHEAD + next->size >= size &&
+        populate_block(next, spill) == 0) {
+        free_list_remove(next);
+        g_heap_used -= block->size;
+        set_block(block, block->size + BLOCK_OVERHEAD + next->size, 1);
+        split_block(block, size);
+        g_heap_used += block->size;
         return ptr;
     }
     
@@ -286,11 +457,7 @@ void* krealloc(void* ptr, unsigned int size) {
         copy_size = size;
     }
     
-    unsigned char* src = (unsigned char*)ptr;
-    unsigned char* dst = (unsigned char*)new_ptr;
-    for (unsigned int i = 0; i < copy_size; i++) {
-        dst[i] = src[i];
-    }
+    memcpy(new_ptr, ptr, copy_size);
     
     // Free old block
     kfree(ptr);
@@ -298,6 +465,59 @@ void* krealloc(void* ptr, unsigned int size) {
     return new_ptr;
 }
 
+// Return idle heap pages to the PMM
+unsigned int heap_trim(void) {
+    if (!g_heap_initialized) {
+        return 0;
+    }
+    
+    unsigned int before = g_heap_reclaimed;
+    g_freed_since_trim = 0;
+    
+    // A free block at the end of the heap shrinks the heap itself
+    heap_footer_t* last_footer = (heap_footer_t*)(HEAP_START + g_heap_size - sizeof(heap_footer_t));
+    heap_block_t* last = (heap_block_t*)((unsigned char*)last_footer - last_footer->size - sizeof(heap_block_t));
+    if (!last->used && g_heap_size > HEAP_INITIAL_SIZE) {
+        unsigned int min_end = (unsigned int)last + BLOCK_OVERHEAD + MIN_BLOCK_SIZE;
+        unsigned int new_end = page_round_up(min_end);
+        if (new_end < HEAP_START + HEAP_INITIAL_SIZE) {
+            new_end = HEAP_START + HEAP_INITIAL_SIZE;
+        }
+        
+        // The new footer may land on a page trimmed out of the block's interior
+        if (new_end < HEAP_START + g_heap_size &&
+            heap_populate(new_end - sizeof(heap_footer_t), new_end) == 0) {
+            free_list_remove(last);
+            g_heap_reclaimed += heap_release(new_end, HEAP_START + g_heap_size);
+            g_heap_size = new_end - HEAP_START;
+            set_block(last, new_end - (unsigned int)last - BLOCK_OVERHEAD, 0);
+            free_list_insert(last);
+        }
+    }
+    
+    // Whole pages inside free blocks
+    for (int cls = 0; cls < HEAP_NUM_CLASSES; cls++) {
+        if (cls < (int)size_class(PAGE_SIZE)) {
+            continue; // Blocks this small cannot span a page
+        }
+        for (heap_block_t* block = g_free_lists[cls]; block; block = get_links(block)->next) {
+            trim_block(block);
+        }
+    }
+    
+    return g_heap_reclaimed - before;
+}
+
+// Set trim high-water mark
+void heap_set_trim_threshold(unsigned int bytes) {
+    g_trim_threshold = bytes;
+}
+
+// Get trim high-water mark
+unsigned int heap_get_trim_threshold(void) {
+    return g_trim_threshold;
+}
+
 // Get heap statistics
 unsigned int heap_get_total_size(void) {
     return g_heap_size;
@@ -311,3 +531,10 @@ unsigned int heap_get_free_size(void) {
     return g_heap_size - g_heap_used;
 }
 
+unsigned int heap_get_resident_size(void) {
+    return g_heap_resident;
+}
+
+unsigned int heap_get_reclaimed_size(void) {
+    return g_heap_reclaimed;
+}
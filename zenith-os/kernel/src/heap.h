@@ -3,13 +3,22 @@
 
 #include "pmm.h"
 
-// Heap block header structure
+// Heap block header structure (boundary tag at the start of every block)
 typedef struct heap_block {
-    struct heap_block* next;  // Next block in free list
-    unsigned int size;        // Size of this block (excluding header)
+    unsigned int size;        // Size of this block's payload (excluding header and footer)
     unsigned int used;        // 1 if used, 0 if free
 } heap_block_t;
 
+// Heap block footer (copy of the header at the end of every block)
+// Lets kfree find the previous block in O(1) for coalescing
+typedef struct heap_footer {
+    unsigned int size;        // Same as the header's size
+    unsigned int used;        // Same as the header's used flag
+} heap_footer_t;
+
+// Number of segregated free lists (size classes are powers of two from 16 bytes)
+#define HEAP_NUM_CLASSES 20
+
 // Initialize kernel heap
 // Returns 0 on success, -1 on failure
 int heap_init(void);
@@ -29,10 +38,23 @@ void kfree(void* ptr);
 // Returns pointer to reallocated memory, or NULL on failure
 void* krealloc(void* ptr, unsigned int size);
 
+// Return idle heap memory to the PMM: shrinks a free tail and unmaps
+// whole pages inside free blocks
+// Returns number of bytes released
+unsigned int heap_trim(void);
+
+// Trim high-water mark: kfree trims once resident but unused heap memory
+// exceeds this many bytes and as much again has been freed since the last
+// trim (0 disables automatic trimming)
+void heap_set_trim_threshold(unsigned int bytes);
+unsigned int heap_get_trim_threshold(void);
+
 // Get heap statistics
 unsigned int heap_get_total_size(void);
 unsigned int heap_get_used_size(void);
 unsigned int heap_get_free_size(void);
+unsigned int heap_get_resident_size(void);   // Bytes backed by physical frames
+unsigned int heap_get_reclaimed_size(void);  // Total bytes returned to the PMM
 
 #endif // HEAP_H
 
@@ -7,6 +7,14 @@ static idt_ptr_t idt_ptr;
 // Array of interrupt handler function pointers
 static interrupt_handler_t interrupt_handlers[256];
 
+// Error code of the interrupt currently being handled
+static unsigned int g_error_code = 0;
+
+// Helper function to output byte to port
+static inline void outb(unsigned short port, unsigned char value) {
+    asm volatile ("outb %0, %1" : : "a"(value), "Nd"(port));
+}
+
 // External assembly functions for exception handlers
 extern void isr0(void);
 extern void isr1(void);
@@ -49,13 +57,13 @@ extern void irq14(void);
 extern void irq15(void);
 
 // Common interrupt handler stub (called from assembly)
-void interrupt_handler_common(unsigned int interrupt_num) {
-    // Call registered handler if available
-    if (interrupt_handlers[interrupt_num]) {
-        interrupt_handlers[interrupt_num]();
-    }
+void interrupt_handler_common(trap_frame_t* frame) {
+    unsigned int interrupt_num = frame->int_no;
+    g_error_code = frame->err_code;
     
-    // If it's an IRQ (32-47), send EOI to PIC
+    // If it's an IRQ (32-47), send EOI to PIC before the handler runs:
+    // the timer handler may switch to another process's kernel stack and
+    // only come back here much later
     if (interrupt_num >= 32 && interrupt_num < 48) {
         // Send EOI to appropriate PIC
         if (interrupt_num >= 40) {
@@ -65,11 +73,11 @@ void interrupt_handler_common(unsigned int interrupt_num) {
         // Master PIC
         outb(0x20, 0x20);
     }
-}
-
-// Helper function to output byte to port
-static inline void outb(unsigned short port, unsigned char value) {
-    asm volatile ("outb %0, %1" : : "a"(value), "Nd"(port));
+    
+    // Call registered handler if available
+    if (interrupt_handlers[interrupt_num]) {
+        interrupt_handlers[interrupt_num]();
+    }
 }
 
 // Set an IDT entry
@@ -81,6 +89,11 @@ void idt_set_entry(unsigned char num, unsigned long base, unsigned short selecto
     idt[num].flags = flags;
 }
 
+// Get error code of the current interrupt
+unsigned int idt_get_error_code(void) {
+    return g_error_code;
+}
+
 // Register an interrupt handler
 void idt_register_handler(unsigned char interrupt, interrupt_handler_t handler) {
     interrupt_handlers[interrupt] = handler;
@@ -16,6 +16,35 @@ typedef struct {
     unsigned int base;            // Base address of IDT
 } __attribute__((packed)) idt_ptr_t;
 
+// Register state saved on the kernel stack by every interrupt/syscall entry
+// (layout matches the push order in idt_asm.s and syscall_asm.s)
+typedef struct {
+    // Pushed by the common stub
+    unsigned int gs;
+    unsigned int fs;
+    unsigned int es;
+    unsigned int ds;
+    unsigned int edi;              // pusha block
+    unsigned int esi;
+    unsigned int ebp;
+    unsigned int esp_kernel;       // ESP before pusha (ignored by popa)
+    unsigned int ebx;
+    unsigned int edx;
+    unsigned int ecx;
+    unsigned int eax;
+    
+    // Pushed by the per-vector stub
+    unsigned int int_no;
+    unsigned int err_code;
+    
+    // Pushed by the CPU
+    unsigned int eip;
+    unsigned int cs;
+    unsigned int eflags;
+    unsigned int user_esp;         // Only present when entering from ring 3
+    unsigned int user_ss;
+} trap_frame_t;
+
 // Exception numbers
 #define EXCEPTION_DIVIDE_BY_ZERO      0
 #define EXCEPTION_DEBUG               1
@@ -70,6 +99,12 @@ void idt_set_entry(unsigned char num, unsigned long base, unsigned short selecto
 // Register an interrupt handler
 void idt_register_handler(unsigned char interrupt, interrupt_handler_t handler);
 
+// Get the CPU error code of the interrupt being handled (0 if none)
+unsigned int idt_get_error_code(void);
+
+// Common interrupt dispatcher (called from assembly with the saved trap frame)
+void interrupt_handler_common(trap_frame_t* frame);
+
 // Exception handler declarations (implemented in idt.c)
 void exception_handler_0(void);   // Divide by zero
 void exception_handler_1(void);   // Debug
@@ -225,8 +225,11 @@ irq15:
     push $47
     jmp irq_common_stub
 
-# Common stub for exceptions
+# Common stub for exceptions and IRQs
+# Builds a trap_frame_t (see idt.h) on the current kernel stack and passes
+# a pointer to it to the C dispatcher
 isr_common_stub:
+irq_common_stub:
     # Save all registers
     pusha
     push %ds
@@ -242,49 +245,18 @@ isr_common_stub:
     mov %ax, %gs
     
     # Call C handler (interrupt_handler_common)
-    # Stack: [GS] [FS] [ES] [DS] [EDI] [ESI] [EBP] [ESP] [EBX] [EDX] [ECX] [EAX] [ERR] [INT#]
-    # Interrupt number is at [ESP + 52] (13 * 4 bytes from current ESP)
-    mov 52(%esp), %eax
-    push %eax
+    # Stack: [GS] [FS] [ES] [DS] [EDI] [ESI] [EBP] [ESP] [EBX] [EDX] [ECX] [EAX] [INT#] [ERR] [EIP] [CS] [EFLAGS] ...
+    # ESP points at the start of the trap frame
+    push %esp
     call interrupt_handler_common
     add $4, %esp
     
-    # Restore registers
-    pop %gs
-    pop %fs
-    pop %es
-    pop %ds
-    popa
-    
-    # Remove error code and interrupt number
-    add $8, %esp
-    
-    # Return from interrupt
-    iret
+    # Fall through to the shared return path
 
-# Common stub for IRQs (same as exceptions)
-irq_common_stub:
-    # Save all registers
-    pusha
-    push %ds
-    push %es
-    push %fs
-    push %gs
-    
-    # Load kernel data segments
-    mov $0x10, %ax
-    mov %ax, %ds
-    mov %ax, %es
-    mov %ax, %fs
-    mov %ax, %gs
-    
-    # Call C handler
-    # Interrupt number is at [ESP + 52]
-    mov 52(%esp), %eax
-    push %eax
-    call interrupt_handler_common
-    add $4, %esp
-    
+# Return from a trap frame
+# Also the first code a new user process runs (see process_asm.s)
+.global trap_return
+trap_return:
     # Restore registers
     pop %gs
     pop %fs
@@ -297,4 +269,3 @@ irq_common_stub:
     
     # Return from interrupt
     iret
-
@@ -3,6 +3,8 @@
 #include "paging.h"
 #include "scheduler.h"
 #include "heap.h"
+#include "slab.h"
+#include "string.h"
 
 // IPC globals
 #define MAX_PIPES 64
@@ -21,8 +23,15 @@ static int g_shmem_count = 0;
 #define MAX_SIGNALS 32
 static signal_action_t g_signal_handlers[MAX_PIPES][MAX_SIGNALS]; // Simplified: using MAX_PIPES as max processes
 
+// Slab cache for message queue entries
+static kmem_cache_t* g_message_cache = 0;
+
 // Initialize IPC subsystem
 void ipc_init(void) {
+    if (!g_message_cache) {
+        g_message_cache = kmem_cache_create("message", sizeof(message_t), 0);
+    }
+    
     g_pipe_count = 0;
     g_mqueue_count = 0;
     g_shmem_count = 0;
@@ -231,16 +240,14 @@ int msgsnd(int msqid, const void* msgp, unsigned int msgsz, int flags) {
     }
     
     // Allocate message
-    message_t* msg = (message_t*)kmalloc(sizeof(message_t));
+    message_t* msg = (message_t*)kmem_cache_alloc(g_message_cache);
     if (!msg) {
         return -1; // Out of memory
     }
     
     msg->type = *((unsigned int*)msgp);
     msg->size = (msgsz > 256) ? 256 : msgsz;
-    for (unsigned int i = 0; i < msg->size; i++) {
-        msg->data[i] = ((unsigned char*)msgp)[i + sizeof(unsigned int)];
-    }
+    memcpy(msg->data, (unsigned char*)msgp + sizeof(unsigned int), msg->size);
     msg->next = 0;
     
     // Add to queue
@@ -279,9 +286,7 @@ int msgrcv(int msqid, void* msgp, unsigned int msgsz, long msgtyp, int flags) {
     // Copy message
     *((unsigned int*)msgp) = msg->type;
     unsigned int copy_size = (msg->size < msgsz) ? msg->size : msgsz;
-    for (unsigned int i = 0; i < copy_size; i++) {
-        ((unsigned char*)msgp)[i + sizeof(unsigned int)] = msg->data[i];
-    }
+    memcpy((unsigned char*)msgp + sizeof(unsigned int), msg->data, copy_size);
     
     // Remove from queue
     mq->first = msg->next;
@@ -290,7 +295,7 @@ int msgrcv(int msqid, void* msgp, unsigned int msgsz, long msgtyp, int flags) {
     }
     mq->message_count--;
     
-    kfree(msg);
+    kmem_cache_free(g_message_cache, msg);
     return copy_size + sizeof(unsigned int);
 }
 
@@ -313,7 +318,7 @@ int msgctl(int msqid, int cmd, void* buf) {
             message_t* msg = mq->first;
             while (msg) {
                 message_t* next = msg->next;
-                kfree(msg);
+                kmem_cache_free(g_message_cache, msg);
                 msg = next;
             }
             mq->key = 0;
@@ -377,6 +382,11 @@ int shmget(unsigned int key, unsigned int size, int flags) {
     shm->size = size;
     shm->physical_addr = (unsigned int)phys_addr;
     shm->virtual_addr = 0; // Will be set when attached
+    
+    // Mark frames shared so fork shares them instead of copying
+    for (unsigned int i = 0; i < num_pages; i++) {
+        pmm_get_page(phys_addr + i * PAGE_SIZE)->flags |= PG_SHARED | PG_USER;
+    }
     shm->ref_count = 1;
     
     process_t* proc = process_get_current();
@@ -406,26 +416,16 @@ void* shmat(int shmid, const void* shmaddr, int flags) {
     unsigned int virt_addr = 0x50000000; // 1.25GB - shared memory region
     
     // Map pages into process address space
-    // Save current page directory
-    page_directory_t* old_dir = paging_get_directory();
-    
-    // Switch to process's page directory
-    paging_switch_directory(proc->page_dir);
-    
-    // Map pages
+    // Each mapping holds its own reference so the frames outlive IPC_RMID
     for (unsigned int i = 0; i < shm->size; i += PAGE_SIZE) {
         unsigned int phys = shm->physical_addr + i;
-        if (paging_map_page(virt_addr + i, phys, 
-                           PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER) != 0) {
-            // Restore old directory on failure
-            paging_switch_directory(old_dir);
+        if (paging_map_page_dir(proc->page_dir, virt_addr + i, phys, 
+                                PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER) != 0) {
             return (void*)-1; // Failed to map
         }
+        pmm_ref_page(phys);
     }
     
-    // Restore old directory
-    paging_switch_directory(old_dir);
-    
     shm->virtual_addr = virt_addr;
     return (void*)virt_addr;
 }
@@ -437,7 +437,15 @@ int shmdt(const void* shmaddr) {
         if (g_shmem[i].virtual_addr == (unsigned int)shmaddr && 
             g_shmem[i].ref_count > 0) {
             g_shmem[i].ref_count--;
-            // Unmap pages (simplified)
+            
+            // Unmap pages and drop the references taken by shmat
+            for (unsigned int off = 0; off < g_shmem[i].size; off += PAGE_SIZE) {
+                unsigned int phys = paging_get_physical((unsigned int)shmaddr + off);
+                if (phys) {
+                    paging_unmap_page((unsigned int)shmaddr + off);
+                    pmm_free_page(phys & ~0xFFF);
+                }
+            }
             return 0;
         }
     }
@@ -458,7 +466,7 @@ int shmctl(int shmid, int cmd, void* buf) {
     if (cmd == 0) { // IPC_RMID
         shm->ref_count--;
         if (shm->ref_count <= 0) {
-            // Free physical pages
+            // Drop the segment's references (attached mappings keep theirs)
             pmm_free_pages(shm->physical_addr, shm->size / PAGE_SIZE);
             shm->key = 0;
             shm->ref_count = 0;
@@ -0,0 +1,435 @@
+#include "journal.h"
+#include "ata.h"
+#include "heap.h"
+#include "string.h"
+
+// On-disk magic numbers
+#define JOURNAL_SB_MAGIC     0x4C4E524A  // "JRNL"
+#define JOURNAL_DESC_MAGIC   0x4353444A  // "JDSC"
+#define JOURNAL_COMMIT_MAGIC 0x544D434A  // "JCMT"
+
+// Journal superblock (first block of the area)
+typedef struct {
+    unsigned int magic;
+    unsigned int sequence;            // First transaction not yet checkpointed
+    unsigned int blocks;              // Size of the area
+} __attribute__((packed)) journal_super_t;
+
+// Descriptor block: where each logged image belongs
+typedef struct {
+    unsigned int magic;
+    unsigned int sequence;            // Transaction number
+    unsigned int count;               // Images following the descriptor
+    unsigned int targets[JOURNAL_TXN_BLOCKS];
+} __attribute__((packed)) journal_desc_t;
+
+// Commit block: a transaction counts only once this is on disk and matches
+typedef struct {
+    unsigned int magic;
+    unsigned int sequence;
+    unsigned int checksum;            // Over the descriptor and the images
+} __attribute__((packed)) journal_commit_t;
+
+// Journal state
+static unsigned int g_start = 0;      // Superblock location
+static unsigned int g_log_blocks = 0; // Blocks available for transactions
+static unsigned int g_log_pos = 0;    // Next free log block (relative to the log)
+static unsigned int g_sequence = 0;   // Number of the running transaction
+static int g_open = 0;
+
+// Running transaction
+static unsigned int g_txn_count = 0;
+static unsigned int g_handles = 0;     // Open handles (nested ones included)
+static unsigned int g_txn_block[JOURNAL_TXN_BLOCKS];
+static unsigned char* g_txn_data = 0;  // JOURNAL_TXN_BLOCKS images
+
+// Committed blocks waiting for a checkpoint (latest image of each)
+static unsigned int g_cp_count = 0;
+static unsigned int g_cp_block[JOURNAL_CHECKPOINT_BLOCKS];
+static unsigned char* g_cp_data = 0;   // JOURNAL_CHECKPOINT_BLOCKS images
+
+static journal_stats_t g_stats;
+
+// Block buffers for the descriptor and commit blocks
+static unsigned char g_desc_buf[JOURNAL_BLOCK_SIZE];
+static unsigned char g_commit_buf[JOURNAL_BLOCK_SIZE];
+
+// Checksum of a run of blocks (rotate and add over 32-bit words)
+static unsigned int journal_checksum(unsigned int sum, const unsigned char* data) {
+    const unsigned int* words = (const unsigned int*)data;
+    for (int i = 0; i < JOURNAL_BLOCK_SIZE / 4; i++) {
+        sum = ((sum << 5) | (sum >> 27)) + words[i];
+    }
+    return sum;
+}
+
+// Write the superblock recording the first transaction still needed
+static int journal_write_super(unsigned int sequence) {
+    memset(g_desc_buf, 0, JOURNAL_BLOCK_SIZE);
+    journal_super_t* sb = (journal_super_t*)g_desc_buf;
+    sb->magic = JOURNAL_SB_MAGIC;
+    sb->sequence = sequence;
+    sb->blocks = g_log_blocks + 1;
+    return ata_write_sectors(g_start, 1, g_desc_buf) == 1 ? 0 : -1;
+}
+
+// Write images home in block order, adjacent blocks as one command
+static int journal_write_home(unsigned int count, unsigned int* blocks, unsigned char* data) {
+    unsigned char* run[JOURNAL_CHECKPOINT_BLOCKS];
+    unsigned int order[JOURNAL_CHECKPOINT_BLOCKS];
+    
+    // Insertion sort of the indices by block number
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned int j = i;
+        while (j > 0 && blocks[order[j - 1]] > blocks[i]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+    
+    unsigned int i = 0;
+    while (i < count) {
+        unsigned int first = blocks[order[i]];
+        unsigned int n = 0;
+        while (i + n < count && blocks[order[i + n]] == first + n) {
+            run[n] = data + order[i + n] * JOURNAL_BLOCK_SIZE;
+            n++;
+        }
+        if (ata_write_sectors_vec(first, n, run) != (int)n) {
+            return -1;
+        }
+        i += n;
+    }
+    return 0;
+}
+
+// Replay committed transactions found in the log
+// Returns the number of the first transaction not found
+static unsigned int journal_replay(unsigned int sequence) {
+    unsigned int pos = 0;
+    
+    for (;;) {
+        if (pos + 2 > g_log_blocks ||
+            ata_read_sectors(g_start + 1 + pos, 1, g_desc_buf) != 1) {
+            break;
+        }
+        
+        journal_desc_t* desc = (journal_desc_t*)g_desc_buf;
+        unsigned int count = desc->count;
+        if (desc->magic != JOURNAL_DESC_MAGIC || desc->sequence != sequence ||
+            count == 0 || count > JOURNAL_TXN_BLOCKS || pos + count + 2 > g_log_blocks) {
+            break; // End of the log (stale or never written)
+        }
+        
+        // Images, then the commit block that vouches for them
+        if (ata_read_sectors(g_start + 2 + pos, count, g_txn_data) != (int)count ||
+            ata_read_sectors(g_start + 2 + pos + count, 1, g_commit_buf) != 1) {
+            break;
+        }
+        
+        unsigned int sum = journal_checksum(0, g_desc_buf);
+        for (unsigned int i = 0; i < count; i++) {
+            sum = journal_checksum(sum, g_txn_data + i * JOURNAL_BLOCK_SIZE);
+        }
+        
+        journal_commit_t* commit = (journal_commit_t*)g_commit_buf;
+        if (commit->magic != JOURNAL_COMMIT_MAGIC || commit->sequence != sequence ||
+            commit->checksum != sum) {
+            break; // Torn transaction: never committed
+        }
+        
+        for (unsigned int i = 0; i < count; i++) {
+            g_txn_block[i] = desc->targets[i];
+        }
+        if (journal_write_home(count, g_txn_block, g_txn_data) != 0) {
+            break;
+        }
+        
+        g_stats.replayed++;
+        sequence++;
+        pos += count + 2;
+    }
+    
+    return sequence;
+}
+
+// Write an empty journal
+int journal_format(unsigned int start, unsigned int blocks) {
+    if (g_open || blocks < JOURNAL_MIN_BLOCKS) {
+        return -1;
+    }
+    
+    g_start = start;
+    g_log_blocks = blocks - 1;
+    
+    // A zeroed first log block ends replay before any stale transaction
+    memset(g_desc_buf, 0, JOURNAL_BLOCK_SIZE);
+    if (ata_write_sectors(g_start + 1, 1, g_desc_buf) != 1) {
+        return -1;
+    }
+    return journal_write_super(1);
+}
+
+// Open the journal and recover it
+int journal_open(unsigned int start, unsigned int blocks) {
+    if (blocks < JOURNAL_MIN_BLOCKS) {
+        return -1;
+    }
+    
+    if (!g_txn_data) {
+        g_txn_data = (unsigned char*)kmalloc(JOURNAL_TXN_BLOCKS * JOURNAL_BLOCK_SIZE);
+        g_cp_data = (unsigned char*)kmalloc(JOURNAL_CHECKPOINT_BLOCKS * JOURNAL_BLOCK_SIZE);
+        if (!g_txn_data || !g_cp_data) {
+            return -1;
+        }
+    }
+    
+    g_start = start;
+    g_log_blocks = blocks - 1;
+    g_log_pos = 0;
+    g_txn_count = 0;
+    g_handles = 0;
+    g_cp_count = 0;
+    memset(&g_stats, 0, sizeof(g_stats));
+    
+    if (ata_read_sectors(g_start, 1, g_desc_buf) != 1) {
+        return -1;
+    }
+    
+    journal_super_t* sb = (journal_super_t*)g_desc_buf;
+    unsigned int sequence = 1;
+    if (sb->magic == JOURNAL_SB_MAGIC && sb->blocks == blocks) {
+        sequence = sb->sequence;
+    }
+    
+    // Everything replayed is home now: start the next transactions from an empty log
+    g_sequence = journal_replay(sequence);
+    if (journal_write_super(g_sequence) != 0) {
+        return -1;
+    }
+    
+    g_open = 1;
+    return 0;
+}
+
+// Begin an atomic metadata update
+int journal_start(unsigned int credits) {
+    if (!g_open) {
+        return -1;
+    }
+    
+    // Nested handles join the outer one, whose credits cover them
+    // An update larger than a transaction could never be atomic: the caller
+    // has to split it
+    if (g_handles == 0) {
+        if (credits > JOURNAL_TXN_BLOCKS) {
+            return -1;
+        }
+        if (g_txn_count + credits > JOURNAL_TXN_BLOCKS && journal_commit() != 0) {
+            return -1;
+        }
+    }
+    
+    g_handles++;
+    return 0;
+}
+
+// End an update begun by journal_start
+void journal_stop(void) {
+    if (g_handles) {
+        g_handles--;
+    }
+}
+
+// Add a block image to the running transaction
+int journal_log(unsigned int block, const unsigned char* data) {
+    if (!g_open) {
+        return -1;
+    }
+    
+    int result = 0;
+    
+    unsigned int i = 0;
+    while (i < g_txn_count && g_txn_block[i] != block) {
+        i++;
+    }
+    
+    if (i < g_txn_count) {
+        g_stats.absorbed++;
+    } else {
+        // A full transaction goes out before it can take another block, but
+        // only between updates: inside a handle the credits ran out
+        if (g_txn_count == JOURNAL_TXN_BLOCKS && (g_handles || journal_commit() != 0)) {
+            result = -1;
+        } else {
+            i = g_txn_count++;
+            g_txn_block[i] = block;
+        }
+    }
+    
+    if (result == 0) {
+        memcpy(g_txn_data + i * JOURNAL_BLOCK_SIZE, data, JOURNAL_BLOCK_SIZE);
+    }
+    
+    return result;
+}
+
+// Read a metadata block through the journal
+int journal_read(unsigned int block, unsigned char* buffer) {
+    // Newest version first: running transaction, then awaiting checkpoint
+    for (unsigned int i = 0; i < g_txn_count; i++) {
+        if (g_txn_block[i] == block) {
+            memcpy(buffer, g_txn_data + i * JOURNAL_BLOCK_SIZE, JOURNAL_BLOCK_SIZE);
+            return 1;
+        }
+    }
+    for (unsigned int i = 0; i < g_cp_count; i++) {
+        if (g_cp_block[i] == block) {
+            memcpy(buffer, g_cp_data + i * JOURNAL_BLOCK_SIZE, JOURNAL_BLOCK_SIZE);
+            return 1;
+        }
+    }
+    
+    return ata_read_sectors(block, 1, buffer);
+}
+
+// Drop a freed block from the journal
+int journal_forget(unsigned int block) {
+    if (!g_open) {
+        return -1;
+    }
+    
+    int result = 0;
+    
+    // Not committed yet: simply take it out of the transaction
+    for (unsigned int i = 0; i < g_txn_count; i++) {
+        if (g_txn_block[i] == block) {
+            g_txn_count--;
+            g_txn_block[i] = g_txn_block[g_txn_count];
+            memcpy(g_txn_data + i * JOURNAL_BLOCK_SIZE, g_txn_data + g_txn_count * JOURNAL_BLOCK_SIZE,
+                   JOURNAL_BLOCK_SIZE);
+            break;
+        }
+    }
+    
+    // Committed: replay could still write it, so retire the log now
+    for (unsigned int i = 0; i < g_cp_count; i++) {
+        if (g_cp_block[i] == block) {
+            result = journal_checkpoint();
+            break;
+        }
+    }
+    
+    return result;
+}
+
+// Write all committed blocks home and reset the log
+int journal_checkpoint(void) {
+    if (!g_open) {
+        return -1;
+    }
+    
+    int result = 0;
+    
+    if (g_cp_count) {
+        if (journal_write_home(g_cp_count, g_cp_block, g_cp_data) != 0 ||
+            journal_write_super(g_sequence) != 0) {
+            result = -1;
+        } else {
+            g_stats.checkpoints++;
+            g_stats.checkpointed += g_cp_count;
+            g_cp_count = 0;
+            g_log_pos = 0;
+        }
+    }
+    
+    return result;
+}
+
+// Commit the running transaction
+int journal_commit(void) {
+    if (!g_open || g_handles) {
+        return -1; // Never commit half an update
+    }
+    
+    if (g_txn_count == 0) {
+        return 0;
+    }
+    
+    // Count the blocks the checkpoint set does not hold yet
+    unsigned int fresh = 0;
+    for (unsigned int i = 0; i < g_txn_count; i++) {
+        unsigned int j = 0;
+        while (j < g_cp_count && g_cp_block[j] != g_txn_block[i]) {
+            j++;
+        }
+        fresh += j == g_cp_count;
+    }
+    
+    // Make room: a checkpoint empties both the log and the checkpoint set
+    if (g_log_pos + g_txn_count + 2 > g_log_blocks ||
+        g_cp_count + fresh > JOURNAL_CHECKPOINT_BLOCKS) {
+        if (journal_checkpoint() != 0) {
+            return -1;
+        }
+    }
+    
+    // Descriptor, images and commit block go out as one sequential write
+    memset(g_desc_buf, 0, JOURNAL_BLOCK_SIZE);
+    journal_desc_t* desc = (journal_desc_t*)g_desc_buf;
+    desc->magic = JOURNAL_DESC_MAGIC;
+    desc->sequence = g_sequence;
+    desc->count = g_txn_count;
+    
+    unsigned char* vec[JOURNAL_TXN_BLOCKS + 2];
+    vec[0] = g_desc_buf;
+    for (unsigned int i = 0; i < g_txn_count; i++) {
+        desc->targets[i] = g_txn_block[i];
+        vec[i + 1] = g_txn_data + i * JOURNAL_BLOCK_SIZE;
+    }
+    
+    unsigned int sum = journal_checksum(0, g_desc_buf);
+    for (unsigned int i = 0; i < g_txn_count; i++) {
+        sum = journal_checksum(sum, vec[i + 1]);
+    }
+    
+    memset(g_commit_buf, 0, JOURNAL_BLOCK_SIZE);
+    journal_commit_t* commit = (journal_commit_t*)g_commit_buf;
+    commit->magic = JOURNAL_COMMIT_MAGIC;
+    commit->sequence = g_sequence;
+    commit->checksum = sum;
+    vec[g_txn_count + 1] = g_commit_buf;
+    
+    unsigned int count = g_txn_count + 2;
+    if (ata_write_sectors_vec(g_start + 1 + g_log_pos, count, vec) != (int)count) {
+        return -1; // Transaction stays open and is retried by the next commit
+    }
+    
+    // Committed: the images now wait for a checkpoint
+    for (unsigned int i = 0; i < g_txn_count; i++) {
+        unsigned int j = 0;
+        while (j < g_cp_count && g_cp_block[j] != g_txn_block[i]) {
+            j++;
+        }
+        if (j == g_cp_count) {
+            g_cp_block[g_cp_count++] = g_txn_block[i];
+        }
+        memcpy(g_cp_data + j * JOURNAL_BLOCK_SIZE, vec[i + 1], JOURNAL_BLOCK_SIZE);
+    }
+    
+    g_stats.commits++;
+    g_stats.logged += g_txn_count;
+    g_log_pos += count;
+    g_sequence++;
+    g_txn_count = 0;
+    
+    return 0;
+}
+
+// Get journal statistics
+void journal_get_stats(journal_stats_t* stats) {
+    if (stats) {
+        *stats = g_stats;
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+// Write-ahead metadata journal (used by fs_simple)
+// Metadata block updates collect in a running transaction and reach the disk
+// together as one sequential write to the journal area. Home locations are
+// only updated later, when the journal fills up (checkpoint), and a mount
+// after a crash just replays the committed transactions. Each file system
+// operation brackets its updates with journal_start/journal_stop, so a
+// transaction boundary never falls in the middle of one.
+//
+// Journal area: block 0 superblock, then the log of transactions, each a
+// descriptor block, the logged block images and a commit block
+//
+// There is no locking here: every caller holds the file system lock
+// (vfs_lock), so commits and checkpoints run with interrupts enabled
+
+#define JOURNAL_BLOCK_SIZE        512
+#define JOURNAL_TXN_BLOCKS        32    // Blocks one transaction can log
+#define JOURNAL_CHECKPOINT_BLOCKS 128   // Committed blocks held until a checkpoint
+#define JOURNAL_MIN_BLOCKS        (JOURNAL_TXN_BLOCKS + 3)
+
+// Journal statistics
+typedef struct {
+    unsigned int commits;             // Transactions committed
+    unsigned int logged;              // Block images written to the log
+    unsigned int absorbed;            // Updates merged into a block already in the transaction
+    unsigned int checkpoints;         // Checkpoints run
+    unsigned int checkpointed;        // Blocks written to their home location
+    unsigned int replayed;            // Transactions replayed at mount
+} journal_stats_t;
+
+// Open the journal occupying blocks [start, start + blocks) and replay
+// any committed transactions left by an unclean shutdown
+// An area without a journal superblock is formatted
+// Returns 0 on success, -1 on error
+int journal_open(unsigned int start, unsigned int blocks);
+
+// Write an empty journal over blocks [start, start + blocks) (format time,
+// before journal_open)
+// Returns 0 on success, -1 on error
+int journal_format(unsigned int start, unsigned int blocks);
+
+// Begin an update that must reach the disk whole (one file system
+// operation), logging at most credits distinct blocks
+// The running transaction is committed first if it cannot take them, and no
+// commit happens until the matching journal_stop. Handles nest: inner ones
+// join the outer update
+// Returns 0 on success, -1 on error (including credits beyond JOURNAL_TXN_BLOCKS)
+int journal_start(unsigned int credits);
+
+// End the update begun by journal_start
+void journal_stop(void);
+
+// Add a metadata block image to the running transaction
+// Later updates of the same block replace the image in place
+// A full transaction is committed first, except inside a handle
+// Returns 0 on success, -1 on error (including credits exhausted)
+int journal_log(unsigned int block, const unsigned char* data);
+
+// Read a metadata block, seeing updates not yet written home
+// Returns 1 (blocks read) on success, -1 on error
+int journal_read(unsigned int block, unsigned char* buffer);
+
+// Forget a metadata block that is being freed, so no stale image of it can
+// later land on whatever reuses the block (checkpoints if it was committed)
+// Returns 0 on success, -1 on error
+int journal_forget(unsigned int block);
+
+// Write the running transaction to the log (one multi-sector command)
+// Returns 0 on success, -1 on error or while a handle is open
+int journal_commit(void);
+
+// Write every committed block home and empty the log
+// Returns 0 on success, -1 on error
+int journal_checkpoint(void);
+
+// Get journal statistics
+void journal_get_stats(journal_stats_t* stats);
+
+#endif // JOURNAL_H
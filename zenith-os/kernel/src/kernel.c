@@ -17,6 +17,10 @@
 #include "shell.h"
 #include "ipc.h"
 #include "serial.h"
+#include "string.h"
+#include "fpu.h"
+#include "vdso.h"
+#include "pagecache.h"
 
 // Global memory map pointer (set by bootloader at 0x80000)
 memory_map_t* g_memory_map = (memory_map_t*)0x80000;
@@ -86,6 +90,9 @@ void kernel_main(void) {
     print_string("Initializing IDT...", 1, 20);
     idt_init();
     
+    // Select memory copy/clear primitives for this CPU
+    string_init();
+    
     // Initialize system calls
     print_string("Initializing syscalls...", 1, 40);
     syscall_init();
@@ -134,7 +141,7 @@ void kernel_main(void) {
     // Remap PIC
     print_string("Remapping PIC...", 1, 20);
     pic_remap();
-    
+        
         // Initialize timer
         print_string("Initializing timer...", 1, 40);
         timer_init();
@@ -176,6 +183,13 @@ void kernel_main(void) {
         // Register file systems
         simple_fs_register();
         
+        // Mount the disk at the root if it holds a simple file system
+        if (vfs_mount("ata0", "/", "simple") == 0) {
+            print_string("FS OK", 3, 20);
+        } else {
+            print_string("No FS (mkfs)", 3, 20);
+        }
+        
         // Initialize IPC
         print_string("Initializing IPC...", 3, 40);
         ipc_init();
@@ -192,8 +206,13 @@ void kernel_main(void) {
         
         // Initialize process management
         print_string("Initializing processes...", 3, 20);
+        vdso_init();
         process_init();
         scheduler_init();
+        fpu_init();
+        
+        // Background write-back of dirty file pages
+        pagecache_start_flusher();
         print_string("Processes OK", 3, 40);
         
         // Enable interrupts (after paging is set up)
@@ -229,7 +248,7 @@ void kernel_main(void) {
             pmm_free_page(page2);
             pmm_free_pages(page3, 4);
             print_string("Freed pages OK", 11, 0);
-            
+        
         print_string("Free after free: ", 12, 0);
         print_decimal(pmm_get_free_pages(), 12, 17);
         
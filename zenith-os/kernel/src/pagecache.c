@@ -0,0 +1,607 @@
+#include "pagecache.h"
+#include "pmm.h"
+#include "string.h"
+#include "cpu.h"
+#include "process.h"
+#include "timer.h"
+
+// Locking: the hash table, the flags and the clock are changed with interrupts
+// disabled, which keeps lookups cheap. Reading or writing a page's data (and
+// the disk I/O behind it) happens under the file system lock instead, with
+// interrupts in the caller's state. A page being filled stays unhashed until
+// its data is in, so nobody else can find it half read.
+
+// Page descriptors, hash table and the list of unused descriptors
+static cache_page_t g_pages[PAGECACHE_MAX_PAGES];
+static cache_page_t* g_buckets[PAGECACHE_BUCKETS];
+static cache_page_t* g_free_pages = 0;
+
+// Clock hand for second-chance eviction
+static unsigned int g_clock_hand = 0;
+
+static pagecache_stats_t g_stats;
+
+// Write-back thread, its timer and the request it wakes up for
+static process_t* g_flusher = 0;
+static unsigned int g_flush_ticks = 0;
+static volatile int g_flush_wanted = 0;
+static volatile int g_flush_backoff = 0; // Last pass failed: only the timer retries
+
+// Hash of (node, index)
+static inline unsigned int pc_hash(vfs_node_t* node, unsigned int index) {
+    return (((unsigned int)node >> 4) ^ (index * 2654435761u)) & (PAGECACHE_BUCKETS - 1);
+}
+
+// Find a cached page
+static cache_page_t* pc_find(vfs_node_t* node, unsigned int index) {
+    for (cache_page_t* p = g_buckets[pc_hash(node, index)]; p; p = p->hash_next) {
+        if (p->node == node && p->index == index) {
+            return p;
+        }
+    }
+    return 0;
+}
+
+// Unlink a page from its hash bucket
+static void pc_unhash(cache_page_t* page) {
+    cache_page_t** link = &g_buckets[pc_hash(page->node, page->index)];
+    while (*link) {
+        if (*link == page) {
+            *link = page->hash_next;
+            break;
+        }
+        link = &(*link)->hash_next;
+    }
+    page->hash_next = 0;
+}
+
+// Return a descriptor and its frame to the free state
+static void pc_release(cache_page_t* page) {
+    if (page->data) {
+        pmm_free_page((unsigned long long)(unsigned int)page->data);
+        page->data = 0;
+    }
+    page->node = 0;
+    page->flags = 0;
+    page->hash_next = g_free_pages;
+    g_free_pages = page;
+}
+
+// Pick a victim with the clock algorithm: referenced pages get a second chance
+// The victim is unhashed but keeps its frame for reuse
+static cache_page_t* pc_evict(void) {
+    for (unsigned int scanned = 0; scanned < 2 * PAGECACHE_MAX_PAGES; scanned++) {
+        cache_page_t* page = &g_pages[g_clock_hand];
+        g_clock_hand = (g_clock_hand + 1) % PAGECACHE_MAX_PAGES;
+        
+        if (!page->node) {
+            continue;
+        }
+        if (page->flags & PC_DIRTY) {
+            continue; // Must be written back first
+        }
+        if (page->flags & PC_REFERENCED) {
+            page->flags &= ~PC_REFERENCED;
+            continue;
+        }
+        
+        pc_unhash(page);
+        page->node = 0;
+        page->flags = 0;
+        g_stats.evictions++;
+        g_stats.pages--;
+        return page;
+    }
+    return 0;
+}
+
+// Get a descriptor with a frame: grow while memory allows, otherwise recycle
+static cache_page_t* pc_alloc(void) {
+    if (g_free_pages && pmm_get_free_pages() > PAGECACHE_LOW_FREE) {
+        unsigned long long frame = pmm_alloc_page();
+        if (frame) {
+            pmm_get_page(frame)->flags |= PG_KERNEL;
+            cache_page_t* page = g_free_pages;
+            g_free_pages = page->hash_next;
+            page->hash_next = 0;
+            page->data = (unsigned char*)(unsigned int)frame;
+            return page;
+        }
+    }
+    return pc_evict();
+}
+
+// Get a descriptor, writing dirty pages back if nothing else can be reclaimed
+// Called with the file system lock held
+static cache_page_t* pc_alloc_or_flush(void) {
+    unsigned int flags = cpu_irq_save();
+    cache_page_t* page = pc_alloc();
+    unsigned int dirty = g_stats.dirty;
+    cpu_irq_restore(flags);
+    
+    if (!page && dirty) {
+        pagecache_flush(0);
+        flags = cpu_irq_save();
+        page = pc_alloc();
+        cpu_irq_restore(flags);
+    }
+    return page;
+}
+
+// Hand an unused descriptor back (interrupts enabled or not)
+static void pc_put(cache_page_t* page) {
+    unsigned int flags = cpu_irq_save();
+    pc_release(page);
+    cpu_irq_restore(flags);
+}
+
+// Hash a freshly filled page under (node, index)
+static void pc_insert(cache_page_t* page, vfs_node_t* node, unsigned int index, unsigned int flags) {
+    page->node = node;
+    page->index = index;
+    page->flags = flags;
+    unsigned int bucket = pc_hash(node, index);
+    page->hash_next = g_buckets[bucket];
+    g_buckets[bucket] = page;
+    g_stats.pages++;
+}
+
+// Look up a page and mark it used (NULL on a miss)
+static cache_page_t* pc_lookup(vfs_node_t* node, unsigned int index) {
+    unsigned int flags = cpu_irq_save();
+    cache_page_t* page = pc_find(node, index);
+    if (page) {
+        page->flags |= PC_REFERENCED;
+        g_stats.hits++;
+    }
+    cpu_irq_restore(flags);
+    return page;
+}
+
+// Hash a filled page (interrupts enabled or not)
+static void pc_publish(cache_page_t* page, vfs_node_t* node, unsigned int index, unsigned int flags) {
+    unsigned int irq = cpu_irq_save();
+    pc_insert(page, node, index, flags);
+    cpu_irq_restore(irq);
+}
+
+// Ask the flusher for a pass
+static void pc_wake_flusher(void) {
+    g_flush_wanted = 1;
+    if (g_flusher) {
+        process_unblock(g_flusher);
+    }
+}
+
+// Initialize the page cache
+void pagecache_init(void) {
+    memset(g_pages, 0, sizeof(g_pages));
+    memset(g_buckets, 0, sizeof(g_buckets));
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_clock_hand = 0;
+    
+    g_free_pages = 0;
+    for (int i = PAGECACHE_MAX_PAGES - 1; i >= 0; i--) {
+        g_pages[i].hash_next = g_free_pages;
+        g_free_pages = &g_pages[i];
+    }
+}
+
+// Get a page of a file, reading it in on a miss
+cache_page_t* pagecache_get(vfs_node_t* node, unsigned int index) {
+    if (!node || !node->readpage) {
+        return 0;
+    }
+    
+    cache_page_t* page = pc_lookup(node, index);
+    if (page) {
+        return page;
+    }
+    
+    // Miss: fill under the file system lock, then look again in case
+    // someone else read the page in while we waited for it
+    vfs_lock();
+    page = pc_lookup(node, index);
+    if (page) {
+        vfs_unlock();
+        return page;
+    }
+    
+    g_stats.misses++;
+    page = pc_alloc_or_flush();
+    if (page && node->readpage(node, index, page->data) != 0) {
+        pc_put(page);
+        page = 0;
+    }
+    if (page) {
+        pc_publish(page, node, index, PC_VALID | PC_REFERENCED);
+    }
+    
+    vfs_unlock();
+    return page;
+}
+
+// Prefetch pages that are not cached yet
+unsigned int pagecache_readahead(vfs_node_t* node, unsigned int index, unsigned int count) {
+    if (!node || !node->readpage) {
+        return 0;
+    }
+    
+    // Never read past the end of the file
+    unsigned int file_pages = (node->size + PAGECACHE_PAGE_SIZE - 1) / PAGECACHE_PAGE_SIZE;
+    if (index >= file_pages) {
+        return 0;
+    }
+    if (count > file_pages - index) {
+        count = file_pages - index;
+    }
+    
+    cache_page_t* batch[PAGECACHE_RA_BATCH];
+    unsigned char* data[PAGECACHE_RA_BATCH];
+    unsigned int issued = 0;
+    unsigned int i = 0;
+    
+    vfs_lock();
+    
+    while (i < count) {
+        unsigned int flags = cpu_irq_save();
+        if (pc_find(node, index + i)) {
+            cpu_irq_restore(flags);
+            i++;
+            continue;
+        }
+        
+        // Gather a run of missing pages
+        unsigned int n = 0;
+        while (i + n < count && n < PAGECACHE_RA_BATCH && !pc_find(node, index + i + n)) {
+            cache_page_t* page = pc_alloc();
+            if (!page) {
+                break;
+            }
+            batch[n] = page;
+            data[n] = page->data;
+            n++;
+        }
+        cpu_irq_restore(flags);
+        if (n == 0) {
+            break; // No memory for more pages
+        }
+        
+        int result = 0;
+        if (node->readpages) {
+            result = node->readpages(node, index + i, n, data);
+        } else {
+            for (unsigned int j = 0; j < n && result == 0; j++) {
+                result = node->readpage(node, index + i + j, data[j]);
+            }
+        }
+        
+        flags = cpu_irq_save();
+        if (result != 0) {
+            for (unsigned int j = 0; j < n; j++) {
+                pc_release(batch[j]);
+            }
+            cpu_irq_restore(flags);
+            break;
+        }
+        
+        for (unsigned int j = 0; j < n; j++) {
+            pc_insert(batch[j], node, index + i + j, PC_VALID);
+        }
+        cpu_irq_restore(flags);
+        g_stats.readahead += n;
+        issued += n;
+        i += n;
+    }
+    
+    vfs_unlock();
+    return issued;
+}
+
+// Read file data through the cache
+int pagecache_read(vfs_node_t* node, unsigned int offset, unsigned int size, unsigned char* buffer) {
+    if (!node || !buffer) {
+        return -1;
+    }
+    
+    if (offset >= node->size) {
+        return 0; // End of file
+    }
+    if (size > node->size - offset) {
+        size = node->size - offset;
+    }
+    
+    // Pages are only recycled under the lock, so none can vanish mid-copy
+    vfs_lock();
+    unsigned int done = 0;
+    while (done < size) {
+        unsigned int pos = offset + done;
+        unsigned int page_offset = pos % PAGECACHE_PAGE_SIZE;
+        unsigned int chunk = PAGECACHE_PAGE_SIZE - page_offset;
+        if (chunk > size - done) {
+            chunk = size - done;
+        }
+        
+        cache_page_t* page = pagecache_get(node, pos / PAGECACHE_PAGE_SIZE);
+        if (!page) {
+            break;
+        }
+        
+        memcpy(buffer + done, page->data + page_offset, chunk);
+        done += chunk;
+    }
+    vfs_unlock();
+    
+    return done ? (int)done : -1;
+}
+
+// Write file data into the cache
+int pagecache_write(vfs_node_t* node, unsigned int offset, unsigned int size, const unsigned char* buffer) {
+    if (!node || !buffer || !node->writepage) {
+        return -1;
+    }
+    
+    vfs_lock();
+    unsigned int done = 0;
+    
+    while (done < size) {
+        unsigned int pos = offset + done;
+        unsigned int index = pos / PAGECACHE_PAGE_SIZE;
+        unsigned int page_offset = pos % PAGECACHE_PAGE_SIZE;
+        unsigned int chunk = PAGECACHE_PAGE_SIZE - page_offset;
+        if (chunk > size - done) {
+            chunk = size - done;
+        }
+        
+        // Grow the file first so the file system reserves blocks for this chunk
+        unsigned int old_size = node->size;
+        if (pos + chunk > node->size) {
+            node->size = pos + chunk;
+        }
+        if (node->bmap && node->bmap(node, index) == 0) {
+            node->size = old_size;
+            break; // Out of space or file too large
+        }
+        
+        cache_page_t* page = pc_lookup(node, index);
+        if (!page && ((page_offset == 0 && chunk == PAGECACHE_PAGE_SIZE) ||
+                      index * PAGECACHE_PAGE_SIZE >= old_size)) {
+            // Fully overwritten or wholly past the old EOF: nothing to read
+            g_stats.misses++;
+            page = pc_alloc_or_flush();
+            if (page) {
+                memset(page->data, 0, PAGECACHE_PAGE_SIZE);
+                pc_publish(page, node, index, PC_VALID | PC_REFERENCED);
+            }
+        } else if (!page) {
+            page = pagecache_get(node, index);
+        }
+        
+        if (!page) {
+            node->size = old_size;
+            break;
+        }
+        
+        memcpy(page->data + page_offset, buffer + done, chunk);
+        unsigned int flags = cpu_irq_save();
+        if (!(page->flags & PC_DIRTY)) {
+            page->flags |= PC_DIRTY;
+            g_stats.dirty++;
+        }
+        cpu_irq_restore(flags);
+        done += chunk;
+    }
+    
+    if (done) {
+        node->modified_time = (unsigned int)timer_get_ticks();
+        node->flags |= VFS_NODE_DIRTY;
+    }
+    
+    // Too much unwritten data: let the flusher start early
+    // (unless write-back is failing, when every write would retry it)
+    if (g_stats.dirty >= PAGECACHE_DIRTY_HIGH && !g_flush_backoff) {
+        pc_wake_flusher();
+    }
+    
+    vfs_unlock();
+    return done ? (int)done : -1;
+}
+
+// Write back dirty pages of one file or of every file
+int pagecache_flush(vfs_node_t* node) {
+    cache_page_t* batch[PAGECACHE_FLUSH_BATCH];
+    unsigned int lba[PAGECACHE_FLUSH_BATCH];
+    unsigned char* data[PAGECACHE_FLUSH_BATCH];
+    int result = 0;
+    
+    // Dirty pages only change hands under the lock: the batch stays valid
+    // while it is written, with interrupts enabled
+    vfs_lock();
+    
+    for (;;) {
+        // Collect a batch of dirty pages with the disk block each starts at
+        unsigned int n = 0;
+        for (int i = 0; i < PAGECACHE_MAX_PAGES && n < PAGECACHE_FLUSH_BATCH; i++) {
+            cache_page_t* page = &g_pages[i];
+            if (!page->node || !(page->flags & PC_DIRTY) || (node && page->node != node)) {
+                continue;
+            }
+            
+            unsigned int block = page->node->bmap ? page->node->bmap(page->node, page->index) : 0;
+            
+            // Insertion sort by disk block so the batch sweeps the disk once
+            unsigned int j = n++;
+            while (j > 0 && lba[j - 1] > block) {
+                batch[j] = batch[j - 1];
+                lba[j] = lba[j - 1];
+                j--;
+            }
+            batch[j] = page;
+            lba[j] = block;
+        }
+        
+        if (n == 0) {
+            break;
+        }
+        
+        for (unsigned int i = 0; i < n; ) {
+            // Consecutive pages of one file that sorted next to each other
+            // sit back to back on disk: hand them over as one request
+            vfs_node_t* file = batch[i]->node;
+            unsigned int run = 1;
+            while (i + run < n && batch[i + run]->node == file &&
+                   batch[i + run]->index == batch[i]->index + run) {
+                run++;
+            }
+            
+            int failed = 0;
+            if (run > 1 && file->writepages) {
+                for (unsigned int j = 0; j < run; j++) {
+                    data[j] = batch[i + j]->data;
+                }
+                failed = file->writepages(file, batch[i]->index, run, data) != 0;
+            } else {
+                for (unsigned int j = 0; j < run; j++) {
+                    if (file->writepage(file, batch[i + j]->index, batch[i + j]->data) != 0) {
+                        failed = 1;
+                    }
+                }
+            }
+            
+            if (failed) {
+                result = -1; // Pages stay dirty
+            } else {
+                unsigned int flags = cpu_irq_save();
+                for (unsigned int j = 0; j < run; j++) {
+                    batch[i + j]->flags &= ~PC_DIRTY;
+                }
+                g_stats.dirty -= run;
+                g_stats.written += run;
+                cpu_irq_restore(flags);
+            }
+            i += run;
+        }
+        
+        // Persist the metadata (inode, allocation state) of every file written
+        // A file with a page that failed (still dirty) is skipped: bmap has
+        // already mapped its blocks, and an inode committed now would point
+        // at blocks whose data never reached the disk
+        for (unsigned int i = 0; i < n; i++) {
+            vfs_node_t* file = batch[i]->node;
+            int skip = 0;
+            for (unsigned int j = 0; j < n && !skip; j++) {
+                if (batch[j]->node == file) {
+                    skip = j < i || (batch[j]->flags & PC_DIRTY);
+                }
+            }
+            if (skip) {
+                continue;
+            }
+            if (file->write_inode) {
+                file->write_inode(file); // Committed together by the file system's sync
+            } else if (file->fsync) {
+                file->fsync(file);
+            }
+        }
+        
+        if (result != 0) {
+            break; // Do not spin on pages that keep failing
+        }
+    }
+    
+    vfs_unlock();
+    return result;
+}
+
+// Flusher thread: sleeps until the timer or the dirty threshold wakes it
+// Each pass ends with a metadata commit per file system, so metadata-only
+// changes reach the journal within one period too
+// Besides writing back, it gives clean pages to the PMM when frames run low
+// A failed pass leaves pages dirty; the next attempt waits for the timer
+static void pagecache_flusher_thread(void* arg) {
+    (void)arg;
+    
+    for (;;) {
+        unsigned int flags = cpu_irq_save();
+        while (!g_flush_wanted) {
+            process_block();
+        }
+        g_flush_wanted = 0;
+        cpu_irq_restore(flags);
+        
+        // Data first, then one metadata commit per file system for the lot
+        g_flush_backoff = vfs_sync() != 0;
+        
+        unsigned int free_frames = pmm_get_free_pages();
+        if (free_frames < PAGECACHE_LOW_FREE) {
+            pagecache_shrink(PAGECACHE_LOW_FREE - free_frames);
+        }
+    }
+}
+
+// Start the flusher kernel thread
+void pagecache_start_flusher(void) {
+    if (!g_flusher) {
+        g_flusher = kthread_create("flusher", pagecache_flusher_thread, 0);
+    }
+}
+
+// Timer hook: periodic write-back
+void pagecache_tick(void) {
+    if (++g_flush_ticks < PAGECACHE_FLUSH_TICKS) {
+        return;
+    }
+    g_flush_ticks = 0;
+    
+    // Always: the running metadata transaction may hold creates, unlinks or
+    // fallocates while no data page is dirty
+    pc_wake_flusher();
+}
+
+// Drop every cached page of a file
+void pagecache_invalidate_node(vfs_node_t* node) {
+    if (!node) {
+        return;
+    }
+    
+    vfs_lock();
+    unsigned int flags = cpu_irq_save();
+    for (int i = 0; i < PAGECACHE_MAX_PAGES; i++) {
+        cache_page_t* page = &g_pages[i];
+        if (page->node == node) {
+            if (page->flags & PC_DIRTY) {
+                g_stats.dirty--; // The file is going away; its data is discarded
+            }
+            pc_unhash(page);
+            pc_release(page);
+            g_stats.pages--;
+        }
+    }
+    cpu_irq_restore(flags);
+    vfs_unlock();
+}
+
+// Release up to count pages to the PMM
+unsigned int pagecache_shrink(unsigned int count) {
+    vfs_lock();
+    unsigned int flags = cpu_irq_save();
+    unsigned int freed = 0;
+    while (freed < count) {
+        cache_page_t* page = pc_evict();
+        if (!page) {
+            break;
+        }
+        pc_release(page);
+        freed++;
+    }
+    cpu_irq_restore(flags);
+    vfs_unlock();
+    return freed;
+}
+
+// Get cache statistics
+void pagecache_get_stats(pagecache_stats_t* stats) {
+    if (stats) {
+        *stats = g_stats;
+    }
+}
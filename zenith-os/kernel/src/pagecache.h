@@ -0,0 +1,94 @@
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include "vfs.h"
+
+// Page cache: 4 KB pages of file data keyed by (node, page index)
+// File systems fill pages through the node's readpage operation. Writes only
+// dirty cached pages; a flusher thread writes them back with writepage.
+
+#define PAGECACHE_PAGE_SIZE   4096
+#define PAGECACHE_MAX_PAGES   256     // Upper bound on cached pages (1 MB)
+#define PAGECACHE_BUCKETS     128     // Hash buckets (power of two)
+#define PAGECACHE_LOW_FREE    64      // Below this many free frames, reuse instead of growing
+#define PAGECACHE_RA_BATCH    32      // Pages read by one readpages call
+#define PAGECACHE_FLUSH_BATCH 64      // Dirty pages sorted and written per pass
+#define PAGECACHE_DIRTY_HIGH  64      // Wake the flusher at this many dirty pages
+#define PAGECACHE_FLUSH_TICKS 500     // Flusher period (5 s at 100 Hz)
+
+// Page flags
+#define PC_VALID       0x1            // Data has been read in
+#define PC_REFERENCED  0x2            // Used since the clock hand last passed
+#define PC_DIRTY       0x4            // Modified since it was last written back
+
+// Cached page
+typedef struct cache_page {
+    vfs_node_t* node;                 // Owning file (NULL = unused descriptor)
+    unsigned int index;               // Page index within the file
+    unsigned char* data;              // Page frame (NULL until first use)
+    unsigned int flags;               // PC_* flags
+    struct cache_page* hash_next;     // Next page in the bucket / free list
+} cache_page_t;
+
+// Cache statistics
+typedef struct {
+    unsigned int hits;                // Lookups served from memory
+    unsigned int misses;              // Lookups that had to read the page
+    unsigned int evictions;           // Pages recycled by the clock
+    unsigned int readahead;           // Pages brought in ahead of use
+    unsigned int pages;               // Pages currently holding file data
+    unsigned int dirty;               // Pages waiting for write-back
+    unsigned int written;             // Pages written back
+} pagecache_stats_t;
+
+// Initialize the page cache
+void pagecache_init(void);
+
+// Get a page of a file, reading it in on a miss
+// The caller holds the file system lock (vfs_lock) while it uses the page,
+// which keeps it from being recycled
+// Returns NULL if the page cannot be read or no page can be freed
+cache_page_t* pagecache_get(vfs_node_t* node, unsigned int index);
+
+// Prefetch the pages in [index, index + count) that are not cached yet
+// Adjacent missing pages are read together (node->readpages if available)
+// Prefetched pages start unreferenced, so unused ones are evicted first
+// Returns the number of pages read
+unsigned int pagecache_readahead(vfs_node_t* node, unsigned int index, unsigned int count);
+
+// Read file data through the cache
+// Returns bytes read (0 at end of file), or -1 on error
+int pagecache_read(vfs_node_t* node, unsigned int offset, unsigned int size, unsigned char* buffer);
+
+// Write file data into the cache (write-back)
+// Disk blocks are reserved up front through node->bmap so out-of-space errors
+// are reported here; the data reaches the disk when the page is flushed
+// Returns bytes written, or -1 on error
+int pagecache_write(vfs_node_t* node, unsigned int offset, unsigned int size, const unsigned char* buffer);
+
+// Write back dirty pages of one file (node != NULL) or of every file
+// Pages go out in disk block order; afterwards the metadata of each file
+// whose pages were all written is handed to the file system
+// Returns 0 on success, -1 if a page could not be written
+int pagecache_flush(vfs_node_t* node);
+
+// Start the flusher kernel thread (needs the scheduler)
+void pagecache_start_flusher(void);
+
+// Timer hook: wakes the flusher every PAGECACHE_FLUSH_TICKS, which writes
+// back dirty pages and commits the file systems' metadata even when no data
+// is dirty (creates and unlinks only touch metadata)
+void pagecache_tick(void);
+
+// Drop every cached page of a file (before the node goes away)
+void pagecache_invalidate_node(vfs_node_t* node);
+
+// Release up to count clean pages to the PMM (memory pressure)
+// Called by the flusher when free frames drop below PAGECACHE_LOW_FREE
+// Returns the number of pages freed
+unsigned int pagecache_shrink(unsigned int count);
+
+// Get cache statistics
+void pagecache_get_stats(pagecache_stats_t* stats);
+
+#endif // PAGECACHE_H
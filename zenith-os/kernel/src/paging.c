@@ -1,6 +1,7 @@
 #include "paging.h"
 #include "pmm.h"
 #include "memory.h"
+#include "string.h"
 
 // Current page directory
 static page_directory_t* g_page_directory = 0;
@@ -35,9 +36,7 @@ void paging_init(void) {
     g_page_directory = (page_directory_t*)dir_phys;
     
     // Clear page directory
-    for (int i = 0; i < 1024; i++) {
-        g_page_directory->entries[i] = 0;
-    }
+    clear_page(g_page_directory);
     
     // Identity map first 4MB (1024 pages) for kernel
     // This includes kernel code, data, and initial page tables
@@ -54,9 +53,7 @@ void paging_init(void) {
     page_table_t* page_table = (page_table_t*)table_phys;
     
     // Clear the page table
-    for (int j = 0; j < 1024; j++) {
-        page_table->entries[j] = 0;
-    }
+    clear_page(page_table);
     
     // Identity map all 1024 pages in this table
     for (int j = 0; j < 1024; j++) {
@@ -81,6 +78,7 @@ void paging_init(void) {
     unsigned int cr0;
     asm volatile ("mov %%cr0, %0" : "=r"(cr0));
     cr0 |= 0x80000000;  // Set PG bit (bit 31)
+    cr0 |= 0x00010000;  // Set WP bit (bit 16) so kernel writes honour read-only (COW) pages
     asm volatile ("mov %0, %%cr0" : : "r"(cr0));
 }
 
@@ -91,7 +89,12 @@ page_directory_t* paging_get_directory(void) {
 
 // Map a virtual address to a physical address
 int paging_map_page(unsigned int virtual_addr, unsigned int physical_addr, unsigned int flags) {
-    if (!g_page_directory) {
+    return paging_map_page_dir(g_page_directory, virtual_addr, physical_addr, flags);
+}
+
+// Map a virtual address in a specific page directory
+int paging_map_page_dir(page_directory_t* dir, unsigned int virtual_addr, unsigned int physical_addr, unsigned int flags) {
+    if (!dir) {
         return -1;
     }
     
@@ -101,7 +104,7 @@ int paging_map_page(unsigned int virtual_addr, unsigned int physical_addr, unsig
     // Get or create page table
     page_table_t* page_table = 0;
     
-    if (!(g_page_directory->entries[pde_idx] & PAGE_PRESENT)) {
+    if (!(dir->entries[pde_idx] & PAGE_PRESENT)) {
         // Allocate a new page table
         unsigned long long table_phys = pmm_alloc_page();
         if (!table_phys) {
@@ -111,23 +114,34 @@ int paging_map_page(unsigned int virtual_addr, unsigned int physical_addr, unsig
         page_table = (page_table_t*)table_phys;
         
         // Clear the page table
-        for (int i = 0; i < 1024; i++) {
-            page_table->entries[i] = 0;
-        }
+        clear_page(page_table);
         
         // Set PDE
-        g_page_directory->entries[pde_idx] = ((unsigned int)table_phys) | PAGE_PRESENT | PAGE_WRITABLE;
+        dir->entries[pde_idx] = ((unsigned int)table_phys) | PAGE_PRESENT | PAGE_WRITABLE;
     } else {
         // Get existing page table
-        unsigned int table_phys = g_page_directory->entries[pde_idx] & ~0xFFF;
+        unsigned int table_phys = dir->entries[pde_idx] & ~0xFFF;
         page_table = (page_table_t*)table_phys;
     }
     
+    // User pages need the user bit on the directory entry as well
+    if (flags & PAGE_USER) {
+        dir->entries[pde_idx] |= PAGE_USER;
+    }
+    
+    // Drop the mapping count of whatever frame was mapped here before
+    if (page_table->entries[pte_idx] & PAGE_PRESENT) {
+        pmm_page_remove_map(page_table->entries[pte_idx] & ~0xFFF);
+    }
+    
     // Set PTE
     page_table->entries[pte_idx] = (physical_addr & ~0xFFF) | (flags & 0xFFF);
+    pmm_page_add_map(physical_addr & ~0xFFF);
     
-    // Invalidate TLB entry
-    asm volatile ("invlpg (%0)" : : "r"(virtual_addr) : "memory");
+    // Invalidate TLB entry (only meaningful for the active directory)
+    if (dir == g_page_directory) {
+        asm volatile ("invlpg (%0)" : : "r"(virtual_addr) : "memory");
+    }
     
     return 0;
 }
@@ -148,6 +162,10 @@ void paging_unmap_page(unsigned int virtual_addr) {
     unsigned int table_phys = g_page_directory->entries[pde_idx] & ~0xFFF;
     page_table_t* page_table = (page_table_t*)table_phys;
     
+    if (page_table->entries[pte_idx] & PAGE_PRESENT) {
+        pmm_page_remove_map(page_table->entries[pte_idx] & ~0xFFF);
+    }
+    
     // Clear PTE
     page_table->entries[pte_idx] = 0;
     
@@ -189,6 +207,28 @@ unsigned int paging_alloc_page(unsigned int virtual_addr, unsigned int flags) {
     return (unsigned int)phys;
 }
 
+// Get PTE pointer for a virtual address
+pte_t* paging_get_pte(page_directory_t* dir, unsigned int virtual_addr) {
+    if (!dir) {
+        return 0;
+    }
+    
+    unsigned int pde_idx = get_pde_index(virtual_addr);
+    if (!(dir->entries[pde_idx] & PAGE_PRESENT)) {
+        return 0;
+    }
+    
+    page_table_t* page_table = (page_table_t*)(dir->entries[pde_idx] & ~0xFFF);
+    return &page_table->entries[get_pte_index(virtual_addr)];
+}
+
+// Flush TLB
+void paging_flush_tlb(void) {
+    unsigned int cr3;
+    asm volatile ("mov %%cr3, %0" : "=r"(cr3));
+    asm volatile ("mov %0, %%cr3" : : "r"(cr3) : "memory");
+}
+
 // Get physical address from virtual address
 unsigned int paging_get_physical(unsigned int virtual_addr) {
     if (!g_page_directory) {
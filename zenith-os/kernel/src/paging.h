@@ -17,6 +17,7 @@
 #define PAGE_DIRTY          0x040   // Page has been written to
 #define PAGE_SIZE_4MB       0x080   // 4MB page (for PDE only)
 #define PAGE_GLOBAL         0x100   // Global page (TLB)
+#define PAGE_COW            0x200   // Copy-on-write (AVL bit, PTE only)
 
 // Page Directory Entry (PDE) - points to a page table
 typedef unsigned int pde_t;
@@ -44,6 +45,9 @@ page_directory_t* paging_get_directory(void);
 // Returns 0 on success, -1 on failure
 int paging_map_page(unsigned int virtual_addr, unsigned int physical_addr, unsigned int flags);
 
+// Map a virtual address in a specific page directory (need not be active)
+int paging_map_page_dir(page_directory_t* dir, unsigned int virtual_addr, unsigned int physical_addr, unsigned int flags);
+
 // Unmap a virtual address
 void paging_unmap_page(unsigned int virtual_addr);
 
@@ -53,6 +57,13 @@ int paging_map_range(unsigned int virtual_start, unsigned int physical_start, un
 // Allocate and map a page (allocates physical page and maps it)
 unsigned int paging_alloc_page(unsigned int virtual_addr, unsigned int flags);
 
+// Get a pointer to the PTE for a virtual address in a directory
+// Returns NULL if no page table covers the address
+pte_t* paging_get_pte(page_directory_t* dir, unsigned int virtual_addr);
+
+// Flush the whole TLB (non-global entries) by reloading CR3
+void paging_flush_tlb(void);
+
 // Get physical address from virtual address (if mapped)
 unsigned int paging_get_physical(unsigned int virtual_addr);
 
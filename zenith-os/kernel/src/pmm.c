@@ -1,4 +1,5 @@
 #include "pmm.h"
+#include "string.h"
 
 // Global PMM instance
 static pmm_t g_pmm;
@@ -51,6 +52,129 @@ static inline void set_bitmap_bit(unsigned long long page_index, unsigned char v
     }
 }
 
+// Helper: Mark a run of pages used/free in the bitmap
+static void set_bitmap_range(unsigned int start, unsigned int count, unsigned char value) {
+    for (unsigned int i = 0; i < count; i++) {
+        set_bitmap_bit(start + i, value);
+    }
+}
+
+// Helper: Push a free block onto the list for its order
+static void free_list_push(unsigned int index, unsigned int order) {
+    page_t* page = &g_pmm.pages[index];
+    page->order = order;
+    page->flags |= PG_BUDDY;
+    page->prev = PMM_NO_FRAME;
+    page->next = g_pmm.free_lists[order];
+    
+    if (page->next != PMM_NO_FRAME) {
+        g_pmm.pages[page->next].prev = index;
+    }
+    g_pmm.free_lists[order] = index;
+    g_pmm.free_blocks[order]++;
+    g_pmm.free_mask |= (1u << order);
+}
+
+// Helper: Unlink a free block from the list for its order
+static void free_list_remove(unsigned int index, unsigned int order) {
+    page_t* page = &g_pmm.pages[index];
+    
+    if (page->prev != PMM_NO_FRAME) {
+        g_pmm.pages[page->prev].next = page->next;
+    } else {
+        g_pmm.free_lists[order] = page->next;
+    }
+    if (page->next != PMM_NO_FRAME) {
+        g_pmm.pages[page->next].prev = page->prev;
+    }
+    
+    page->next = PMM_NO_FRAME;
+    page->prev = PMM_NO_FRAME;
+    page->flags &= ~PG_BUDDY;
+    g_pmm.free_blocks[order]--;
+    if (g_pmm.free_lists[order] == PMM_NO_FRAME) {
+        g_pmm.free_mask &= ~(1u << order);
+    }
+}
+
+// Helper: Smallest order whose block holds count pages
+static unsigned int order_for_count(unsigned int count) {
+    unsigned int order = 0;
+    while ((1u << order) < count) {
+        order++;
+    }
+    return order;
+}
+
+// Helper: Insert a free block, merging with its buddy as long as possible
+static void buddy_insert(unsigned int index, unsigned int order) {
+    while (order < PMM_MAX_ORDER - 1) {
+        unsigned int buddy = index ^ (1u << order);
+        if (buddy + (1u << order) > g_pmm.total_pages) {
+            break; // Buddy runs past the end of managed memory
+        }
+        
+        page_t* page = &g_pmm.pages[buddy];
+        if (!(page->flags & PG_BUDDY) || page->order != order) {
+            break; // Buddy is (partially) in use
+        }
+        
+        free_list_remove(buddy, order);
+        if (buddy < index) {
+            index = buddy;
+        }
+        order++;
+    }
+    
+    free_list_push(index, order);
+}
+
+// Helper: Hand a run of free pages to the buddy lists in aligned blocks
+static void buddy_insert_range(unsigned int start, unsigned int count) {
+    while (count > 0) {
+        unsigned int order = 0;
+        while (order < PMM_MAX_ORDER - 1 &&
+               (start & ((2u << order) - 1)) == 0 &&
+               (2u << order) <= count) {
+            order++;
+        }
+        
+        buddy_insert(start, order);
+        start += 1u << order;
+        count -= 1u << order;
+    }
+}
+
+// Helper: Return a run of used pages to the allocator
+static void release_range(unsigned int start, unsigned int count) {
+    if (count == 0) {
+        return;
+    }
+    set_bitmap_range(start, count, 0);
+    g_pmm.free_pages += count;
+    buddy_insert_range(start, count);
+}
+
+// Helper: Take a single free page out of whichever buddy block holds it
+static void buddy_isolate_page(unsigned int index) {
+    for (unsigned int order = 0; order < PMM_MAX_ORDER; order++) {
+        unsigned int head = index & ~((1u << order) - 1);
+        page_t* page = &g_pmm.pages[head];
+        
+        if ((page->flags & PG_BUDDY) && page->order == order) {
+            unsigned int size = 1u << order;
+            free_list_remove(head, order);
+            set_bitmap_range(head, size, 1);
+            g_pmm.free_pages -= size;
+            
+            // Give back everything around the isolated page
+            release_range(head, index - head);
+            release_range(index + 1, head + size - (index + 1));
+            return;
+        }
+    }
+}
+
 // Initialize Physical Memory Manager
 int pmm_init(memory_map_t* mem_map) {
     if (!mem_map || mem_map->count == 0) {
@@ -88,6 +212,10 @@ int pmm_init(memory_map_t* mem_map) {
     // Calculate bitmap size (1 bit per page, rounded up)
     g_pmm.bitmap_size = (g_pmm.total_pages + 7) / 8;
     
+    // Page descriptor array follows the bitmap (4-byte aligned)
+    unsigned long long pages_offset = (g_pmm.bitmap_size + 3) & ~3ULL;
+    unsigned long long meta_size = pages_offset + g_pmm.total_pages * sizeof(page_t);
+    
     // Find a location for the bitmap in usable memory
     // Try to place it at 0x200000 (2MB) first, then find any suitable location
     unsigned long long bitmap_addr = 0x200000;
@@ -98,7 +226,7 @@ int pmm_init(memory_map_t* mem_map) {
         memory_map_entry_t* entry = &mem_map->entries[i];
         if (entry->type == MEMORY_TYPE_USABLE) {
             if (entry->base <= bitmap_addr && 
-                (entry->base + entry->length) >= (bitmap_addr + g_pmm.bitmap_size)) {
+                (entry->base + entry->length) >= (bitmap_addr + meta_size)) {
                 g_pmm.bitmap = (unsigned char*)bitmap_addr;
                 break;
             }
@@ -109,11 +237,11 @@ int pmm_init(memory_map_t* mem_map) {
     if (!g_pmm.bitmap) {
         for (unsigned int i = 0; i < mem_map->count; i++) {
             memory_map_entry_t* entry = &mem_map->entries[i];
-            if (entry->type == MEMORY_TYPE_USABLE && entry->length >= g_pmm.bitmap_size) {
+            if (entry->type == MEMORY_TYPE_USABLE && entry->length >= meta_size) {
                 // Use start of this region, rounded up to page boundary
                 unsigned long long candidate = (entry->base + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
                 // Make sure it's above 1MB and doesn't overlap with kernel
-                if (candidate >= 0x200000 && candidate + g_pmm.bitmap_size <= entry->base + entry->length) {
+                if (candidate >= 0x200000 && candidate + meta_size <= entry->base + entry->length) {
                     g_pmm.bitmap = (unsigned char*)candidate;
                     break;
                 }
@@ -126,9 +254,24 @@ int pmm_init(memory_map_t* mem_map) {
     }
     
     // Initialize bitmap to all free (zero)
-    for (unsigned long long i = 0; i < g_pmm.bitmap_size; i++) {
-        g_pmm.bitmap[i] = 0;
+    memset(g_pmm.bitmap, 0, (unsigned int)g_pmm.bitmap_size);
+    
+    // Initialize page descriptors and empty free lists
+    g_pmm.pages = (page_t*)((unsigned int)g_pmm.bitmap + (unsigned int)pages_offset);
+    for (unsigned long long i = 0; i < g_pmm.total_pages; i++) {
+        g_pmm.pages[i].next = PMM_NO_FRAME;
+        g_pmm.pages[i].prev = PMM_NO_FRAME;
+        g_pmm.pages[i].refcount = 0;
+        g_pmm.pages[i].mapcount = 0;
+        g_pmm.pages[i].flags = 0;
+        g_pmm.pages[i].order = 0;
+    }
+    for (int i = 0; i < PMM_MAX_ORDER; i++) {
+        g_pmm.free_lists[i] = PMM_NO_FRAME;
+        g_pmm.free_blocks[i] = 0;
     }
+    g_pmm.free_mask = 0;
+    g_pmm.buddy_ready = 0;
     
     // Mark all pages as free initially
     g_pmm.free_pages = g_pmm.total_pages;
@@ -154,15 +297,38 @@ int pmm_init(memory_map_t* mem_map) {
     // Mark bootloader regions as reserved (0x7c00-0x90000)
     pmm_mark_reserved_range(0x7c00, 0x90000);
     
+    // Mark real-mode IVT/BIOS data area as reserved (0x0-0x1000)
+    // This also keeps physical address 0 usable as the failure value
+    pmm_mark_reserved_range(0x0, 0x1000);
+    
     // Mark VGA buffer as reserved (0xb8000-0xc0000)
     pmm_mark_reserved_range(0xb8000, 0xc0000);
     
-    // Mark bitmap itself as reserved
+    // Mark bitmap and page descriptors as reserved
     unsigned long long bitmap_start = (unsigned long long)g_pmm.bitmap;
-    unsigned long long bitmap_end = bitmap_start + g_pmm.bitmap_size;
+    unsigned long long bitmap_end = bitmap_start + meta_size;
     bitmap_end = (bitmap_end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1); // Round up
     pmm_mark_reserved_range(bitmap_start, bitmap_end);
     
+    // Build buddy free lists from the remaining free runs
+    unsigned int run_start = 0;
+    unsigned int run_length = 0;
+    for (unsigned int i = 0; i < g_pmm.total_pages; i++) {
+        if (!is_bitmap_set(i)) {
+            if (run_length == 0) {
+                run_start = i;
+            }
+            run_length++;
+        } else if (run_length > 0) {
+            buddy_insert_range(run_start, run_length);
+            run_length = 0;
+        }
+    }
+    if (run_length > 0) {
+        buddy_insert_range(run_start, run_length);
+    }
+    g_pmm.buddy_ready = 1;
+    
     return 0;
 }
 
@@ -186,9 +352,15 @@ void pmm_mark_reserved_range(unsigned long long start, unsigned long long end) {
     
     for (unsigned long long i = start_page; i < end_page; i++) {
         if (!is_bitmap_set(i)) {
-            set_bitmap_bit(i, 1); // Mark as used/reserved
-            if (g_pmm.free_pages > 0) {
-                g_pmm.free_pages--;
+            g_pmm.pages[i].flags |= PG_RESERVED;
+            if (g_pmm.buddy_ready) {
+                // Page currently sits in a free block - split it out
+                buddy_isolate_page((unsigned int)i);
+            } else {
+                set_bitmap_bit(i, 1); // Mark as used/reserved
+                if (g_pmm.free_pages > 0) {
+                    g_pmm.free_pages--;
+                }
             }
         }
     }
@@ -206,65 +378,94 @@ unsigned long long pmm_alloc_page(void) {
 
 // Allocate multiple contiguous page frames
 unsigned long long pmm_alloc_pages(unsigned int count) {
-    if (count == 0 || count > g_pmm.free_pages) {
+    if (count == 0 || count > g_pmm.free_pages || !g_pmm.buddy_ready) {
         return 0; // Invalid request or not enough free pages
     }
     
-    // Simple first-fit allocation
-    unsigned long long consecutive = 0;
-    unsigned long long start_page = 0;
+    unsigned int order = order_for_count(count);
+    if (order >= PMM_MAX_ORDER) {
+        return 0; // Larger than the biggest buddy block
+    }
     
-    for (unsigned long long i = 0; i < g_pmm.total_pages; i++) {
-        if (!is_bitmap_set(i)) { // Page is free
-            if (consecutive == 0) {
-                start_page = i;
-            }
-            consecutive++;
-            
-            if (consecutive >= count) {
-                // Found enough consecutive pages
-                for (unsigned long long j = start_page; j < start_page + count; j++) {
-                    set_bitmap_bit(j, 1); // Mark as used
-                }
-                g_pmm.free_pages -= count;
-                g_pmm.used_pages += count;
-                return page_index_to_addr(start_page);
-            }
-        } else {
-            consecutive = 0;
-        }
+    // Smallest non-empty order that can satisfy the request
+    unsigned int candidates = g_pmm.free_mask & ~((1u << order) - 1);
+    if (!candidates) {
+        return 0; // Not enough contiguous pages found
     }
+    unsigned int block_order = __builtin_ctz(candidates);
+    
+    unsigned int index = g_pmm.free_lists[block_order];
+    free_list_remove(index, block_order);
     
-    return 0; // Not enough contiguous pages found
+    // Split down to the requested order, returning upper halves
+    while (block_order > order) {
+        block_order--;
+        free_list_push(index + (1u << block_order), block_order);
+    }
+    
+    unsigned int size = 1u << order;
+    set_bitmap_range(index, size, 1);
+    g_pmm.free_pages -= size;
+    
+    // Give back the unused tail of a non power-of-two request
+    release_range(index + count, size - count);
+    
+    // Each page starts out with a single reference held by the caller
+    for (unsigned int i = index; i < index + count; i++) {
+        g_pmm.pages[i].refcount = 1;
+        g_pmm.pages[i].mapcount = 0;
+        g_pmm.pages[i].flags = 0;
+    }
+    
+    g_pmm.used_pages += count;
+    return page_index_to_addr(index);
 }
 
-// Free a single page frame
+// Drop a reference on a single page frame
 void pmm_free_page(unsigned long long addr) {
     pmm_free_pages(addr, 1);
 }
 
-// Free multiple contiguous page frames
+// Drop a reference on multiple contiguous page frames
 void pmm_free_pages(unsigned long long addr, unsigned int count) {
     if (addr < g_pmm.mem_start || addr >= g_pmm.mem_end) {
         return; // Invalid address
     }
     
-    unsigned long long start_page = addr_to_page_index(addr);
+    unsigned int start_page = (unsigned int)addr_to_page_index(addr);
+    if (start_page + count > g_pmm.total_pages) {
+        count = g_pmm.total_pages - start_page;
+    }
+    
+    // Release each run of pages whose last reference drops
+    // (pages that are free or reserved have no references and are skipped)
+    unsigned int run_start = start_page;
+    unsigned int run_length = 0;
+    unsigned int released = 0;
     
-    for (unsigned int i = 0; i < count; i++) {
-        unsigned long long page_index = start_page + i;
-        if (page_index >= g_pmm.total_pages) {
-            break;
-        }
-        
-        if (is_bitmap_set(page_index)) {
-            set_bitmap_bit(page_index, 0); // Mark as free
-            g_pmm.free_pages++;
-            if (g_pmm.used_pages > 0) {
-                g_pmm.used_pages--;
+    for (unsigned int i = start_page; i < start_page + count; i++) {
+        page_t* page = &g_pmm.pages[i];
+        if (page->refcount > 0 && --page->refcount == 0) {
+            page->mapcount = 0;
+            page->flags = 0;
+            if (run_length == 0) {
+                run_start = i;
             }
+            run_length++;
+        } else if (run_length > 0) {
+            release_range(run_start, run_length);
+            released += run_length;
+            run_length = 0;
         }
     }
+    release_range(run_start, run_length);
+    released += run_length;
+    
+    if (g_pmm.used_pages >= released) {
+        g_pmm.used_pages -= released;
+    } else {
+        g_pmm.used_pages = 0;
+    }
 }
 
 // Get statistics
@@ -280,3 +481,64 @@ unsigned long long pmm_get_total_pages(void) {
     return g_pmm.total_pages;
 }
 
+// Get the start of managed memory
+unsigned long long pmm_get_mem_start(void) {
+    return g_pmm.mem_start;
+}
+
+// Get the descriptor for a physical page
+page_t* pmm_get_page(unsigned long long addr) {
+    if (addr < g_pmm.mem_start || addr >= g_pmm.mem_end || !g_pmm.pages) {
+        return 0;
+    }
+    return &g_pmm.pages[addr_to_page_index(addr)];
+}
+
+// Get the physical address described by a page descriptor
+unsigned long long pmm_page_to_addr(page_t* page) {
+    return page_index_to_addr((unsigned long long)(page - g_pmm.pages));
+}
+
+// Take an extra reference on an allocated page
+void pmm_ref_page(unsigned long long addr) {
+    page_t* page = pmm_get_page(addr);
+    if (page && page->refcount > 0) {
+        page->refcount++;
+    }
+}
+
+// Get the reference count of a page
+unsigned int pmm_get_refcount(unsigned long long addr) {
+    page_t* page = pmm_get_page(addr);
+    return page ? page->refcount : 0;
+}
+
+// Record that a page table entry now maps this page
+void pmm_page_add_map(unsigned long long addr) {
+    page_t* page = pmm_get_page(addr);
+    if (page && page->refcount > 0) {
+        page->mapcount++;
+    }
+}
+
+// Record that a page table entry no longer maps this page
+void pmm_page_remove_map(unsigned long long addr) {
+    page_t* page = pmm_get_page(addr);
+    if (page && page->mapcount > 0) {
+        page->mapcount--;
+    }
+}
+
+unsigned long long pmm_get_free_blocks(unsigned int order) {
+    if (order >= PMM_MAX_ORDER) {
+        return 0;
+    }
+    return g_pmm.free_blocks[order];
+}
+
+int pmm_get_largest_free_order(void) {
+    if (!g_pmm.free_mask) {
+        return -1;
+    }
+    return 31 - __builtin_clz(g_pmm.free_mask);
+}
@@ -9,6 +9,32 @@
 
 // Bitmap: 0 = free, 1 = used/reserved
 
+// Buddy allocator: a block of order n is 2^n contiguous pages
+// Orders 0..15 cover blocks from 4KB up to 128MB
+#define PMM_MAX_ORDER 16
+
+// Marks the end of a free list / an unlinked frame
+#define PMM_NO_FRAME 0xFFFFFFFF
+
+// Page descriptor flags
+#define PG_BUDDY     0x01   // Heads a free block in the buddy lists
+#define PG_RESERVED  0x02   // Never handed out (firmware, kernel image, ...)
+#define PG_KERNEL    0x04   // Owned by the kernel
+#define PG_USER      0x08   // Mapped into user space
+#define PG_SHARED    0x10   // Shared between address spaces (e.g. shm)
+#define PG_DIRTY     0x20   // Contents modified since last writeback
+#define PG_LOCKED    0x40   // Pinned (I/O in progress)
+
+// Page descriptor (one per physical frame, indexed by page index)
+typedef struct page {
+    unsigned int next;            // Next free block in the same order list
+    unsigned int prev;            // Previous free block in the same order list
+    unsigned int refcount;        // References held (0 = free or reserved)
+    unsigned short mapcount;      // Page table entries mapping this frame
+    unsigned char flags;          // PG_* flags
+    unsigned char order;          // Block order (valid while PG_BUDDY is set)
+} page_t;
+
 // Physical Memory Manager structure
 typedef struct {
     unsigned char* bitmap;        // Bitmap array (1 bit per page)
@@ -18,6 +44,13 @@ typedef struct {
     unsigned long long used_pages; // Number of used pages
     unsigned long long mem_start;   // Start of managed memory
     unsigned long long mem_end;     // End of managed memory
+    
+    // Buddy allocator state
+    page_t* pages;                               // Page descriptor array
+    unsigned int free_lists[PMM_MAX_ORDER];      // Free list heads per order
+    unsigned long long free_blocks[PMM_MAX_ORDER]; // Free block count per order
+    unsigned int free_mask;                      // Bit n set if order n list is non-empty
+    int buddy_ready;                             // Free lists have been built
 } pmm_t;
 
 // Initialize Physical Memory Manager
@@ -25,20 +58,40 @@ typedef struct {
 int pmm_init(memory_map_t* mem_map);
 
 // Allocate a single page frame (4KB)
+// The page starts with a reference count of 1
 // Returns physical address of allocated page, or 0 on failure
 unsigned long long pmm_alloc_page(void);
 
 // Allocate multiple contiguous page frames
+// The block is carved from the smallest buddy order that fits and the
+// unused tail is returned to the free lists immediately
 // Returns physical address of first page, or 0 on failure
 unsigned long long pmm_alloc_pages(unsigned int count);
 
-// Free a page frame
+// Free a page frame (drops one reference)
+// The frame is only released when its last reference is dropped
 // addr: physical address of page to free
 void pmm_free_page(unsigned long long addr);
 
-// Free multiple contiguous page frames
+// Free multiple contiguous page frames (drops one reference on each)
 void pmm_free_pages(unsigned long long addr, unsigned int count);
 
+// Get the descriptor for a physical page (0 if not managed)
+page_t* pmm_get_page(unsigned long long addr);
+
+// Get the physical address described by a page descriptor
+unsigned long long pmm_page_to_addr(page_t* page);
+
+// Take an extra reference on an allocated page
+void pmm_ref_page(unsigned long long addr);
+
+// Get the reference count of a page
+unsigned int pmm_get_refcount(unsigned long long addr);
+
+// Track page table entries that map a page
+void pmm_page_add_map(unsigned long long addr);
+void pmm_page_remove_map(unsigned long long addr);
+
 // Mark a page as reserved (cannot be allocated)
 void pmm_mark_reserved(unsigned long long addr);
 
@@ -50,5 +103,14 @@ unsigned long long pmm_get_free_pages(void);
 unsigned long long pmm_get_used_pages(void);
 unsigned long long pmm_get_total_pages(void);
 
+// Get number of free blocks of the given order (fragmentation statistics)
+unsigned long long pmm_get_free_blocks(unsigned int order);
+
+// Get the largest order with a free block, or -1 if memory is exhausted
+int pmm_get_largest_free_order(void);
+
+// Get the start of managed memory (buddy blocks are aligned relative to it)
+unsigned long long pmm_get_mem_start(void);
+
 #endif // PMM_H
 
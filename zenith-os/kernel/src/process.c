@@ -5,10 +5,17 @@
 #include "scheduler.h"
 #include "vfs.h"
 #include "elf.h"
+#include "slab.h"
+#include "string.h"
+#include "gdt.h"
+#include "idt.h"
+#include "cpu.h"
+#include "vdso.h"
 
-// External assembly functions
-extern void save_context(process_t* proc);
-extern void restore_context(process_t* proc);
+// External assembly functions (process_asm.s)
+extern void switch_to(unsigned int* old_esp, unsigned int new_esp);
+extern void user_thread_start(void);
+extern void kernel_thread_start(void);
 
 // Process management globals (exported for scheduler)
 process_t* g_process_list = 0;
@@ -16,27 +23,336 @@ static process_t* g_current_process = 0;
 static pid_t g_next_pid = 1;
 static unsigned int g_process_count = 0;
 
+// Boot context (kernel_main/shell): runs whenever no process is current
+static unsigned int g_boot_esp = 0;             // Saved ESP while a process runs
+static page_directory_t* g_kernel_dir = 0;     // Directory used by the boot context and kernel threads
+
+// Exited process with no parent to reap it; freed once we are off its stack
+static process_t* g_reap_process = 0;
+
+// Slab cache for process control blocks
+static kmem_cache_t* g_process_cache = 0;
+
+// Constructor: process control blocks start out zeroed
+static void process_ctor(void* obj) {
+    memset(obj, 0, sizeof(process_t));
+}
+
+// Drop every user frame mapped in a page directory, then its page tables
+// (entry 0 is the shared kernel mapping and is left alone)
+void process_free_user_space(page_directory_t* dir) {
+    for (int i = 1; i < 1024; i++) {
+        if (!(dir->entries[i] & PAGE_PRESENT)) {
+            continue;
+        }
+        
+        page_table_t* table = (page_table_t*)(dir->entries[i] & ~0xFFF);
+        for (int j = 0; j < 1024; j++) {
+            if (table->entries[j] & PAGE_PRESENT) {
+                unsigned int frame = table->entries[j] & ~0xFFF;
+                pmm_page_remove_map(frame);
+                pmm_free_page(frame); // Released once no one else shares it
+                table->entries[j] = 0;
+            }
+        }
+        
+        pmm_free_page((unsigned long long)table);
+        dir->entries[i] = 0;
+    }
+}
+
+// Map a zero-filled frame at a lazily reserved user address
+static int map_zero_page(process_t* proc, unsigned int addr) {
+    unsigned long long frame = pmm_alloc_page();
+    if (!frame) {
+        return -1;
+    }
+    
+    clear_page((void*)(unsigned int)frame);
+    pmm_get_page(frame)->flags |= PG_USER;
+    if (paging_map_page_dir(proc->page_dir, addr & ~(PAGE_SIZE - 1), (unsigned int)frame,
+                            PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER) != 0) {
+        pmm_free_page(frame);
+        return -1;
+    }
+    
+    return 0;
+}
+
+// Duplicate the user half of src into dst (entry 0 is the shared kernel mapping)
+// With cow set, private writable pages are shared read-only and marked PAGE_COW
+// in both directories; otherwise every private page is copied immediately.
+// On failure dst is left empty.
+int process_clone_user_space(page_directory_t* dst, page_directory_t* src, int cow) {
+    for (int i = 1; i < 1024; i++) {
+        if (!(src->entries[i] & PAGE_PRESENT)) {
+            continue;
+        }
+        
+        // Allocate new page table
+        unsigned long long table_phys = pmm_alloc_page();
+        if (!table_phys) {
+            process_free_user_space(dst);
+            return -1;
+        }
+        
+        page_table_t* src_table = (page_table_t*)(src->entries[i] & ~0xFFF);
+        page_table_t* dst_table = (page_table_t*)table_phys;
+        
+        clear_page(dst_table);
+        dst->entries[i] = (unsigned int)table_phys | (src->entries[i] & 0xFFF);
+        
+        for (int j = 0; j < 1024; j++) {
+            pte_t entry = src_table->entries[j];
+            if (!(entry & PAGE_PRESENT)) {
+                continue;
+            }
+            
+            unsigned int frame = entry & ~0xFFF;
+            page_t* page = pmm_get_page(frame);
+            
+            // Shared frames (e.g. shm segments) keep their mapping as-is
+            if (page && (page->flags & PG_SHARED)) {
+                pmm_ref_page(frame);
+                pmm_page_add_map(frame);
+                dst_table->entries[j] = entry;
+                continue;
+            }
+            
+            if (cow) {
+                // Both sides lose write access until the first write fault
+                if (entry & (PAGE_WRITABLE | PAGE_COW)) {
+                    entry = (entry & ~PAGE_WRITABLE) | PAGE_COW;
+                    src_table->entries[j] = entry;
+                }
+                pmm_ref_page(frame);
+                pmm_page_add_map(frame);
+                dst_table->entries[j] = entry;
+                continue;
+            }
+            
+            // Allocate new physical page
+            unsigned long long page_phys = pmm_alloc_page();
+            if (!page_phys) {
+                process_free_user_space(dst);
+                return -1;
+            }
+            
+            copy_page((void*)(unsigned int)page_phys, (void*)frame);
+            
+            pmm_get_page(page_phys)->flags |= PG_USER;
+            pmm_page_add_map(page_phys);
+            dst_table->entries[j] = (unsigned int)page_phys | (entry & 0xFFF);
+        }
+    }
+    
+    // The source may have lost write access to pages it has cached in the TLB
+    if (cow && src == paging_get_directory()) {
+        paging_flush_tlb();
+    }
+    
+    return 0;
+}
+
+// Whether a not-present page lies in a region that is mapped on first touch
+// (the stack below its top down to the guard page, and the heap up to the
+// page holding the break)
+static int demand_zero_region(process_t* proc, unsigned int addr) {
+    if (addr >= proc->stack_guard && addr < proc->stack_bottom) {
+        return 0; // Stack overflow into the guard page
+    }
+    
+    unsigned int heap_limit = (proc->heap_end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    return (addr >= proc->stack_bottom && addr < proc->stack_top) ||
+           (addr >= proc->heap_start && addr < heap_limit);
+}
+
+// Check that the kernel may write [addr, addr + size) on behalf of the
+// current process: every page must be a writable or copy-on-write user page,
+// or lie in a demand-zero region, so a kernel write never takes a fatal fault
+int process_user_writable(unsigned int addr, unsigned int size) {
+    process_t* proc = g_current_process;
+    if (!proc || proc->page_dir != paging_get_directory() || size == 0 || addr + size < addr) {
+        return 0;
+    }
+    
+    unsigned int last = (addr + size - 1) & ~(PAGE_SIZE - 1);
+    for (unsigned int page = addr & ~(PAGE_SIZE - 1); ; page += PAGE_SIZE) {
+        pte_t* pte = paging_get_pte(proc->page_dir, page);
+        if (pte && (*pte & PAGE_PRESENT)) {
+            if (!(*pte & PAGE_USER) || !(*pte & (PAGE_WRITABLE | PAGE_COW))) {
+                return 0;
+            }
+        } else if (!demand_zero_region(proc, page)) {
+            return 0;
+        }
+        
+        if (page == last) {
+            return 1;
+        }
+    }
+}
+
+// Resolve a page fault in the current address space
+// Returns 0 if the fault was a demand-paging or copy-on-write fault and has been handled
+int process_handle_page_fault(unsigned int fault_addr, unsigned int error_code) {
+    // Not-present faults inside a reserved region get a fresh zero page
+    if (!(error_code & PF_PRESENT)) {
+        process_t* proc = g_current_process;
+        if (!proc || proc->page_dir != paging_get_directory() || !demand_zero_region(proc, fault_addr)) {
+            return -1;
+        }
+        return map_zero_page(proc, fault_addr);
+    }
+    
+    // Only write faults on present pages can be COW faults
+    if (!(error_code & PF_WRITE)) {
+        return -1;
+    }
+    
+    pte_t* pte = paging_get_pte(paging_get_directory(), fault_addr);
+    if (!pte || !(*pte & PAGE_PRESENT) || !(*pte & PAGE_COW)) {
+        return -1;
+    }
+    
+    unsigned int frame = *pte & ~0xFFF;
+    unsigned int flags = (*pte & 0xFFF & ~PAGE_COW) | PAGE_WRITABLE;
+    
+    if (pmm_get_refcount(frame) > 1) {
+        // Still shared: take a private copy and drop our reference
+        unsigned long long copy = pmm_alloc_page();
+        if (!copy) {
+            return -1;
+        }
+        
+        copy_page((void*)(unsigned int)copy, (void*)frame);
+        pmm_get_page(copy)->flags |= PG_USER;
+        pmm_page_add_map(copy);
+        
+        pmm_page_remove_map(frame);
+        pmm_free_page(frame);
+        frame = (unsigned int)copy;
+    }
+    
+    // Last user of the frame simply regains write access
+    *pte = frame | flags;
+    asm volatile ("invlpg (%0)" : : "r"(fault_addr) : "memory");
+    
+    return 0;
+}
+
+// Allocate a process's kernel stack
+static int kernel_stack_alloc(process_t* proc) {
+    unsigned long long base = pmm_alloc_pages(KERNEL_STACK_PAGES);
+    if (!base) {
+        return -1;
+    }
+    
+    proc->kernel_stack = (unsigned int)base;
+    proc->kernel_esp = 0;
+    return 0;
+}
+
+// Free a process's kernel stack
+static void kernel_stack_free(process_t* proc) {
+    if (proc->kernel_stack) {
+        pmm_free_pages(proc->kernel_stack, KERNEL_STACK_PAGES);
+        proc->kernel_stack = 0;
+    }
+}
+
+// User trap frame: always the first thing pushed on an empty kernel stack
+static trap_frame_t* process_user_frame(process_t* proc) {
+    return (trap_frame_t*)(proc->kernel_stack + KERNEL_STACK_SIZE - sizeof(trap_frame_t));
+}
+
+// Lay out a switch_to frame below top so the first switch "returns" to start
+// (pop order in switch_to: EFLAGS, EDI, ESI, EBX, EBP, return address)
+static void process_init_switch_frame(process_t* proc, unsigned int top, void (*start)(void),
+                                      unsigned int ebx, unsigned int esi) {
+    unsigned int* sp = (unsigned int*)top;
+    
+    *--sp = (unsigned int)start;  // Return address
+    *--sp = 0;                    // EBP
+    *--sp = ebx;                  // EBX
+    *--sp = esi;                  // ESI
+    *--sp = 0;                    // EDI
+    *--sp = 0x002;                // EFLAGS (IF clear until the start stub is done)
+    
+    proc->kernel_esp = (unsigned int)sp;
+}
+
+// Link a new process into the global process list
+static void process_list_add(process_t* proc) {
+    proc->next = g_process_list;
+    if (g_process_list) {
+        g_process_list->prev = proc;
+    }
+    g_process_list = proc;
+    proc->prev = 0;
+}
+
+// Switch stacks to next (NULL = back to the boot context)
+// Must be called with interrupts disabled
+static void context_switch(process_t* next) {
+    process_t* prev = g_current_process;
+    unsigned int* save_esp = prev ? &prev->kernel_esp : &g_boot_esp;
+    
+    g_current_process = next;
+    vdso_set_pid(next ? next->pid : 0);
+    if (next) {
+        scheduler_remove(next);
+        next->state = PROCESS_STATE_RUNNING;
+        
+        // Ring 3 -> ring 0 transitions land on the top of next's kernel stack
+        gdt_set_kernel_stack(next->kernel_stack + KERNEL_STACK_SIZE);
+        paging_switch_directory(next->page_dir ? next->page_dir : g_kernel_dir);
+    } else {
+        paging_switch_directory(g_kernel_dir);
+    }
+    
+    // Lazy FPU: set CR0.TS so the first FPU/SSE instruction traps (#NM),
+    // unless the new process's state is still live in the registers
+    fpu_switch_to(next);
+    
+    switch_to(save_esp, next ? next->kernel_esp : g_boot_esp);
+    
+    // Running on prev's stack again, possibly much later
+    process_finish_switch();
+}
+
+// Bookkeeping after landing on a new stack
+void process_finish_switch(void) {
+    if (g_reap_process && g_reap_process != g_current_process) {
+        process_t* dead = g_reap_process;
+        g_reap_process = 0;
+        process_destroy(dead);
+    }
+}
+
 // Initialize process management
 void process_init(void) {
     g_process_list = 0;
     g_current_process = 0;
     g_next_pid = 1;
     g_process_count = 0;
+    g_boot_esp = 0;
+    g_reap_process = 0;
+    g_kernel_dir = paging_get_directory();
+    
+    if (!g_process_cache) {
+        g_process_cache = kmem_cache_create("process", sizeof(process_t), process_ctor);
+    }
 }
 
 // Create a new process
 process_t* process_create(const char* name, void (*entry_point)(void), unsigned int stack_size) {
-    // Allocate process structure
-    process_t* proc = (process_t*)pmm_alloc_page();
+    // Allocate process structure (zeroed by the cache constructor)
+    process_t* proc = (process_t*)kmem_cache_alloc(g_process_cache);
     if (!proc) {
         return 0;
     }
     
-    // Clear process structure
-    for (unsigned int i = 0; i < sizeof(process_t); i++) {
-        ((unsigned char*)proc)[i] = 0;
-    }
-    
     // Set basic information
     proc->pid = g_next_pid++;
     proc->ppid = g_current_process ? g_current_process->pid : 0;
@@ -59,11 +375,12 @@ process_t* process_create(const char* name, void (*entry_point)(void), unsigned
     // Allocate page directory for process
     unsigned long long dir_phys = pmm_alloc_page();
     if (!dir_phys) {
-        pmm_free_page((unsigned long long)proc);
+        kmem_cache_free(g_process_cache, proc);
         return 0;
     }
     
     proc->page_dir = (page_directory_t*)dir_phys;
+    clear_page(proc->page_dir);
     
     // Copy kernel mappings from current page directory
     if (g_current_process && g_current_process->page_dir) {
@@ -77,6 +394,14 @@ process_t* process_create(const char* name, void (*entry_point)(void), unsigned
         }
     }
     
+    // Map the shared kernel data page (PID, clock) read-only
+    if (vdso_map(proc->page_dir) != 0) {
+        process_free_user_space(proc->page_dir);
+        pmm_free_page(dir_phys);
+        kmem_cache_free(g_process_cache, proc);
+        return 0;
+    }
+    
     // Allocate stack (default 64KB if not specified)
     if (stack_size == 0) {
         stack_size = 64 * 1024; // 64KB
@@ -85,57 +410,61 @@ process_t* process_create(const char* name, void (*entry_point)(void), unsigned
     // Round up to page size
     stack_size = (stack_size + 4095) & ~4095;
     
-    // Allocate stack pages
-    unsigned int stack_virt = 0x400000; // Start at 4MB (after kernel)
-    unsigned int num_stack_pages = stack_size / 4096;
+    // Reserve the stack region; pages are mapped on first touch
+    // The lowest page of the region is a guard page and is never mapped
+    unsigned int stack_virt = USER_STACK_BASE + PAGE_SIZE;
     
+    proc->stack_guard = USER_STACK_BASE;
     proc->stack_bottom = stack_virt;
     proc->stack_top = stack_virt + stack_size;
     
-    for (unsigned int i = 0; i < num_stack_pages; i++) {
-        unsigned long long stack_page = pmm_alloc_page();
-        if (!stack_page) {
-            // Failed to allocate - cleanup
-            process_destroy(proc);
-            return 0;
-        }
-        
-        // Map stack page
-        unsigned int virt_addr = stack_virt + (i * 4096);
-        paging_map_page(virt_addr, (unsigned int)stack_page, PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER);
+    // Allocate kernel stack
+    if (kernel_stack_alloc(proc) != 0) {
+        process_free_user_space(proc->page_dir);
+        pmm_free_page(dir_phys);
+        kmem_cache_free(g_process_cache, proc);
+        return 0;
+    }
+    
+    // Start with an empty descriptor table (console descriptors only)
+    proc->fd_table = vfs_fd_table_create();
+    if (!proc->fd_table) {
+        kernel_stack_free(proc);
+        process_free_user_space(proc->page_dir);
+        pmm_free_page(dir_phys);
+        kmem_cache_free(g_process_cache, proc);
+        return 0;
     }
     
-    // Set up initial CPU context
-    proc->registers.eip = (unsigned int)entry_point;
-    proc->registers.cs = 0x18;  // User code segment (Ring 3) - 0x18 = GDT_USER_CS
-    proc->registers.ds = 0x20;  // User data segment (Ring 3) - 0x20 = GDT_USER_DS
-    proc->registers.es = 0x20;
-    proc->registers.fs = 0x20;
-    proc->registers.gs = 0x20;
-    proc->registers.ss = 0x20;
+    // Set up initial CPU context: a trap frame that irets into ring 3
+    trap_frame_t* frame = process_user_frame(proc);
+    memset(frame, 0, sizeof(trap_frame_t));
+    frame->eip = (unsigned int)entry_point;
+    frame->cs = GDT_USER_CS | GDT_RPL_USER;
+    frame->ds = GDT_USER_DS | GDT_RPL_USER;
+    frame->es = GDT_USER_DS | GDT_RPL_USER;
+    frame->fs = GDT_USER_DS | GDT_RPL_USER;
+    frame->gs = GDT_USER_DS | GDT_RPL_USER;
+    frame->user_ss = GDT_USER_DS | GDT_RPL_USER;
     
     // Set stack pointer (grows downward)
-    proc->registers.esp = proc->stack_top - 16; // Leave some space
-    proc->registers.esp_user = proc->registers.esp;
+    frame->user_esp = proc->stack_top - 16; // Leave some space
+    
+    // Set flags (interrupts enabled, IOPL 0, user mode)
+    frame->eflags = 0x202; // IF bit set
+    
+    // First switch to this process goes through user_thread_start -> iret
+    process_init_switch_frame(proc, (unsigned int)frame, user_thread_start, 0, 0);
     
     // Initialize user heap (starts after stack, grows upward)
     proc->heap_start = proc->stack_top; // Heap starts after stack
     proc->heap_end = proc->heap_start;  // Initially empty
     
-    // Set flags (interrupts enabled, IOPL 0, user mode)
-    proc->registers.eflags = 0x202; // IF bit set
-    
-    // Set time slice (100ms = 10 ticks at 100Hz)
-    proc->time_slice = 10;
+    // Time slice is set from the priority level when the process is queued
     proc->total_time = 0;
     
     // Add to process list
-    proc->next = g_process_list;
-    if (g_process_list) {
-        g_process_list->prev = proc;
-    }
-    g_process_list = proc;
-    proc->prev = 0;
+    process_list_add(proc);
     
     // Add to parent's child list
     if (proc->parent) {
@@ -148,8 +477,51 @@ process_t* process_create(const char* name, void (*entry_point)(void), unsigned
     
     g_process_count++;
     
-    // Set state to ready
-    proc->state = PROCESS_STATE_READY;
+    // Set state to ready and queue at the top priority level
+    scheduler_schedule(proc);
+    
+    return proc;
+}
+
+// Create a kernel thread
+process_t* kthread_create(const char* name, void (*fn)(void* arg), void* arg) {
+    // Allocate process structure (zeroed by the cache constructor)
+    process_t* proc = (process_t*)kmem_cache_alloc(g_process_cache);
+    if (!proc) {
+        return 0;
+    }
+    
+    // Kernel threads have no parent; they are reaped as soon as they exit
+    proc->pid = g_next_pid++;
+    proc->ppid = 0;
+    proc->state = PROCESS_STATE_NEW;
+    proc->priority = 0;
+    proc->kernel_thread = 1;
+    
+    // Copy name
+    int i = 0;
+    while (name[i] && i < 31) {
+        proc->name[i] = name[i];
+        i++;
+    }
+    proc->name[i] = '\0';
+    
+    // No user address space: runs on the kernel page directory
+    proc->page_dir = 0;
+    
+    if (kernel_stack_alloc(proc) != 0) {
+        kmem_cache_free(g_process_cache, proc);
+        return 0;
+    }
+    
+    // First switch lands in kernel_thread_start, which calls fn(arg)
+    process_init_switch_frame(proc, proc->kernel_stack + KERNEL_STACK_SIZE, kernel_thread_start,
+                              (unsigned int)fn, (unsigned int)arg);
+    
+    process_list_add(proc);
+    g_process_count++;
+    
+    scheduler_schedule(proc);
     
     return proc;
 }
@@ -160,34 +532,27 @@ void process_destroy(process_t* proc) {
         return;
     }
     
-    // Free stack pages
-    if (proc->stack_bottom) {
-        unsigned int stack_size = proc->stack_top - proc->stack_bottom;
-        unsigned int num_pages = stack_size / 4096;
-        
-        for (unsigned int i = 0; i < num_pages; i++) {
-            unsigned int virt_addr = proc->stack_bottom + (i * 4096);
-            unsigned int phys_addr = paging_get_physical(virt_addr);
-            if (phys_addr) {
-                paging_unmap_page(virt_addr);
-                pmm_free_page(phys_addr);
-            }
-        }
-    }
+    // Make sure the scheduler can no longer pick it
+    scheduler_remove(proc);
+    
+    // Drop FPU ownership and the save area
+    fpu_release(proc);
+    
+    // Close files the process still holds (normally done by process_exit)
+    vfs_fd_table_destroy(proc->fd_table);
+    proc->fd_table = 0;
     
-    // Free page directory (but keep kernel mappings)
+    // Free user memory (stack, heap, shared mappings) and page tables
+    // Shared frames are only released by their last owner
     if (proc->page_dir) {
-        // Free page tables (except first one which is shared)
-        for (int i = 1; i < 1024; i++) {
-            if (proc->page_dir->entries[i] & PAGE_PRESENT) {
-                unsigned int table_phys = proc->page_dir->entries[i] & ~0xFFF;
-                pmm_free_page(table_phys);
-            }
-        }
+        process_free_user_space(proc->page_dir);
         // Free page directory itself
         pmm_free_page((unsigned long long)proc->page_dir);
     }
     
+    // Free kernel stack (never the one we are running on, see process_exit)
+    kernel_stack_free(proc);
+    
     // Remove from parent's child list
     if (proc->parent) {
         if (proc->prev_sibling) {
@@ -212,7 +577,7 @@ void process_destroy(process_t* proc) {
     }
     
     // Free process structure
-    pmm_free_page((unsigned long long)proc);
+    kmem_cache_free(g_process_cache, proc);
     
     g_process_count--;
 }
@@ -241,33 +606,35 @@ void process_switch(process_t* new_process) {
         return;
     }
     
-    process_t* old_process = g_current_process;
-    
-    // Save old process context (if any)
-    if (old_process) {
-        save_context(old_process);
-        old_process->state = PROCESS_STATE_READY;
-    }
-    
-    // Switch to new process
-    g_current_process = new_process;
-    new_process->state = PROCESS_STATE_RUNNING;
-    new_process->time_slice = 10; // Reset time slice
-    
-    // Switch page directory
-    paging_switch_directory(new_process->page_dir);
-    
-    // Restore CPU context
-    restore_context(new_process);
+    // The outgoing process's state (READY/BLOCKED/TERMINATED) was set by the caller
+    unsigned int flags = cpu_irq_save();
+    context_switch(new_process);
+    cpu_irq_restore(flags);
 }
 
 // Yield CPU to next process
 void process_yield(void) {
+    unsigned int flags = cpu_irq_save();
+    process_t* current = g_current_process;
+    
+    // A still-runnable current process goes to the back of its level
+    if (current && current->state == PROCESS_STATE_RUNNING) {
+        scheduler_schedule(current);
+    }
+    
     // Trigger scheduler
     process_t* next = scheduler_get_next();
-    if (next && next != g_current_process) {
-        process_switch(next);
+    if (next && next != current) {
+        context_switch(next);
+    } else if (next) {
+        // Nothing better to run: keep going with a fresh quantum
+        next->state = PROCESS_STATE_RUNNING;
+    } else if (current) {
+        // Current process blocked and nothing is ready: back to the boot context
+        context_switch(0);
     }
+    
+    cpu_irq_restore(flags);
 }
 
 // Block current process
@@ -281,34 +648,64 @@ void process_block(void) {
 // Unblock a process
 void process_unblock(process_t* proc) {
     if (proc && proc->state == PROCESS_STATE_BLOCKED) {
-        proc->state = PROCESS_STATE_READY;
-        scheduler_schedule(proc);
+        scheduler_wake(proc);
+    }
+}
+
+// Sleep on an event channel
+void process_sleep(void* channel) {
+    process_t* current = g_current_process;
+    if (!current) {
+        process_yield();
+        return;
+    }
+    
+    current->wait_channel = channel;
+    process_block();
+    current->wait_channel = 0;
+}
+
+// Wake everything sleeping on an event channel
+void process_wakeup(void* channel) {
+    unsigned int flags = cpu_irq_save();
+    for (process_t* proc = g_process_list; proc; proc = proc->next) {
+        if (proc->wait_channel == channel) {
+            proc->wait_channel = 0;
+            process_unblock(proc);
+        }
     }
+    cpu_irq_restore(flags);
 }
 
 // Exit current process
 void process_exit(unsigned int exit_code) {
-    if (g_current_process) {
-        g_current_process->exit_code = exit_code;
-        g_current_process->exit_status = exit_code;
-        g_current_process->state = PROCESS_STATE_TERMINATED;
-        
-        // Unblock parent if waiting
-        if (g_current_process->parent && g_current_process->parent->state == PROCESS_STATE_BLOCKED) {
-            process_unblock(g_current_process->parent);
-        }
-        
-        // Switch to next process
-        process_t* next = scheduler_get_next();
-        if (next) {
-            process_switch(next);
+    process_t* current = g_current_process;
+    if (!current) {
+        return;
+    }
+    
+    cpu_irq_save(); // Not restored: this context never runs again
+    
+    current->exit_code = exit_code;
+    current->exit_status = exit_code;
+    current->state = PROCESS_STATE_TERMINATED;
+    
+    // Close open files now rather than when the parent reaps us
+    vfs_fd_table_destroy(current->fd_table);
+    current->fd_table = 0;
+    
+    // Unblock parent if waiting; it destroys us in process_wait
+    // Orphans are destroyed by whoever runs next, once off this stack
+    if (current->parent) {
+        if (current->parent->state == PROCESS_STATE_BLOCKED) {
+            process_unblock(current->parent);
         }
-        
-        // Destroy terminated process
-        process_t* to_destroy = g_current_process;
-        g_current_process = 0;
-        process_destroy(to_destroy);
+    } else {
+        g_reap_process = current;
     }
+    
+    // Switch to next process (or the boot context if nothing is ready)
+    context_switch(scheduler_get_next());
 }
 
 // Get process count
@@ -319,20 +716,18 @@ unsigned int process_get_count(void) {
 // Fork current process (create a copy)
 pid_t process_fork(void) {
     process_t* parent = g_current_process;
-    if (!parent) {
-        return -1; // No current process
+    if (!parent || parent->kernel_thread) {
+        return -1; // No current user process
     }
     
     // Create new process (child)
-    process_t* child = (process_t*)pmm_alloc_page();
+    process_t* child = (process_t*)kmem_cache_alloc(g_process_cache);
     if (!child) {
         return -1; // Out of memory
     }
     
     // Copy parent's process structure
-    for (unsigned int i = 0; i < sizeof(process_t); i++) {
-        ((unsigned char*)child)[i] = ((unsigned char*)parent)[i];
-    }
+    memcpy(child, parent, sizeof(process_t));
     
     // Set child-specific fields
     child->pid = g_next_pid++;
@@ -342,77 +737,68 @@ pid_t process_fork(void) {
     child->first_child = 0;
     child->next_sibling = 0;
     child->prev_sibling = 0;
+    child->run_next = 0;
+    child->run_prev = 0;
+    child->on_run_queue = 0;
+    child->wait_channel = 0;
+    
+    // Child gets its own kernel stack
+    if (kernel_stack_alloc(child) != 0) {
+        kmem_cache_free(g_process_cache, child);
+        return -1;
+    }
+    
+    // Child inherits a private copy of the FPU state
+    if (fpu_fork(child, parent) != 0) {
+        kernel_stack_free(child);
+        kmem_cache_free(g_process_cache, child);
+        return -1;
+    }
+    
+    // Child shares the parent's open files (and their offsets)
+    child->fd_table = vfs_fd_table_clone(parent->fd_table);
+    if (!child->fd_table) {
+        fpu_release(child);
+        kernel_stack_free(child);
+        kmem_cache_free(g_process_cache, child);
+        return -1;
+    }
     
     // Allocate new page directory for child
     unsigned long long dir_phys = pmm_alloc_page();
     if (!dir_phys) {
-        pmm_free_page((unsigned long long)child);
+        vfs_fd_table_destroy(child->fd_table);
+        fpu_release(child);
+        kernel_stack_free(child);
+        kmem_cache_free(g_process_cache, child);
         return -1;
     }
     
     child->page_dir = (page_directory_t*)dir_phys;
+    clear_page(child->page_dir);
     
     // Copy kernel mappings
     child->page_dir->entries[0] = parent->page_dir->entries[0];
     
-    // Copy parent's page tables (simplified - in real OS, use copy-on-write)
-    for (int i = 1; i < 1024; i++) {
-        if (parent->page_dir->entries[i] & PAGE_PRESENT) {
-            // Allocate new page table
-            unsigned long long table_phys = pmm_alloc_page();
-            if (!table_phys) {
-                // Cleanup
-                pmm_free_page((unsigned long long)child->page_dir);
-                pmm_free_page((unsigned long long)child);
-                return -1;
-            }
-            
-            page_table_t* parent_table = (page_table_t*)(parent->page_dir->entries[i] & ~0xFFF);
-            page_table_t* child_table = (page_table_t*)table_phys;
-            
-            // Copy page table entries
-            for (int j = 0; j < 1024; j++) {
-                if (parent_table->entries[j] & PAGE_PRESENT) {
-                    // Allocate new physical page
-                    unsigned long long page_phys = pmm_alloc_page();
-                    if (!page_phys) {
-                        // Cleanup
-                        pmm_free_page((unsigned long long)child_table);
-                        pmm_free_page((unsigned long long)child->page_dir);
-                        pmm_free_page((unsigned long long)child);
-                        return -1;
-                    }
-                    
-                    // Copy page data
-                    unsigned int parent_virt = (i << 22) | (j << 12);
-                    unsigned int child_virt = parent_virt;
-                    unsigned int parent_phys = parent_table->entries[j] & ~0xFFF;
-                    unsigned char* src = (unsigned char*)parent_phys;
-                    unsigned char* dst = (unsigned char*)page_phys;
-                    
-                    for (int k = 0; k < 4096; k++) {
-                        dst[k] = src[k];
-                    }
-                    
-                    // Map in child's page table
-                    child_table->entries[j] = (unsigned int)page_phys | 
-                                             (parent_table->entries[j] & 0xFFF);
-                }
-            }
-            
-            // Set up page directory entry
-            child->page_dir->entries[i] = (unsigned int)table_phys | 
-                                          (parent->page_dir->entries[i] & 0xFFF);
-        }
+    // Share parent's user pages copy-on-write
+    if (process_clone_user_space(child->page_dir, parent->page_dir, 1) != 0) {
+        vfs_fd_table_destroy(child->fd_table);
+        fpu_release(child);
+        kernel_stack_free(child);
+        pmm_free_page((unsigned long long)child->page_dir);
+        kmem_cache_free(g_process_cache, child);
+        return -1;
     }
     
+    // Child resumes from a copy of the parent's syscall trap frame,
+    // with fork() returning 0
+    trap_frame_t* frame = process_user_frame(child);
+    memcpy(frame, process_user_frame(parent), sizeof(trap_frame_t));
+    frame->eax = 0;
+    process_init_switch_frame(child, (unsigned int)frame, user_thread_start, 0, 0);
+    
     // Add to process list
-    child->next = g_process_list;
-    if (g_process_list) {
-        g_process_list->prev = child;
-    }
-    g_process_list = child;
-    child->prev = 0;
+    process_list_add(child);
     
     // Add to parent's child list
     child->next_sibling = parent->first_child;
@@ -426,15 +812,14 @@ pid_t process_fork(void) {
     // Schedule child
     scheduler_schedule(child);
     
-    // Return child PID in parent, 0 in child
-    // This will be set by the context switch
+    // Return child PID in parent (the child sees 0 from its trap frame)
     return child->pid;
 }
 
 // Execute a new program (replace current process)
 int process_exec(const char* path, char* const argv[]) {
     process_t* proc = g_current_process;
-    if (!proc) {
+    if (!proc || proc->kernel_thread) {
         return -1;
     }
     
@@ -557,10 +942,11 @@ int process_exec(const char* path, char* const argv[]) {
     // Align stack to 16 bytes
     stack_ptr = (stack_ptr & ~0xF);
     
-    // Update process entry point and stack
-    proc->registers.eip = entry_point;
-    proc->registers.esp = stack_ptr;
-    proc->registers.esp_user = stack_ptr;
+    // Update process entry point and stack in the syscall trap frame;
+    // the iret at the end of the syscall enters the new program
+    trap_frame_t* frame = process_user_frame(proc);
+    frame->eip = entry_point;
+    frame->user_esp = stack_ptr;
     
     // Copy name
     int i = 0;
@@ -623,37 +1009,9 @@ unsigned int process_brk(unsigned int new_break) {
         return proc->heap_end; // Too large - return current break
     }
     
-    // If expanding heap, allocate and map new pages
-    if (new_break > proc->heap_end) {
-        unsigned int old_end = proc->heap_end;
-        unsigned int new_end = new_break;
-        
-        // Round up to page boundaries
-        old_end = (old_end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
-        new_end = (new_end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
-        
-        // Allocate and map pages
-        for (unsigned int addr = old_end; addr < new_end; addr += PAGE_SIZE) {
-            unsigned long long page_phys = pmm_alloc_page();
-            if (!page_phys) {
-                // Out of memory - return current break
-                return proc->heap_end;
-            }
-            
-            // Map page in process's address space
-            if (paging_map_page(addr, (unsigned int)page_phys, 
-                               PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER) != 0) {
-                pmm_free_page(page_phys);
-                return proc->heap_end;
-            }
-            
-            // Clear the page
-            unsigned char* page = (unsigned char*)addr;
-            for (int i = 0; i < PAGE_SIZE; i++) {
-                page[i] = 0;
-            }
-        }
-    } else if (new_break < proc->heap_end) {
+    // Growing the heap only moves the break; the page fault handler maps
+    // zero-filled pages on first touch
+    if (new_break < proc->heap_end) {
         // Shrinking heap - unmap and free pages
         unsigned int old_end = proc->heap_end;
         unsigned int new_end = new_break;
@@ -2,6 +2,20 @@
 #define PROCESS_H
 
 #include "paging.h"
+#include "fpu.h"
+#include "vfs.h"
+
+// Page fault error code bits (pushed by the CPU for vector 14)
+#define PF_PRESENT  0x1   // Fault on a present page (protection violation)
+#define PF_WRITE    0x2   // Fault caused by a write
+#define PF_USER     0x4   // Fault happened in user mode
+
+// Base of the user stack region (the lowest page is the guard page)
+#define USER_STACK_BASE 0x400000
+
+// Per-process kernel stack (interrupts, syscalls and switch_to run on it)
+#define KERNEL_STACK_PAGES 2
+#define KERNEL_STACK_SIZE  (KERNEL_STACK_PAGES * 4096)
 
 // Process states
 typedef enum {
@@ -15,31 +29,6 @@ typedef enum {
 // Process ID type
 typedef unsigned int pid_t;
 
-// CPU registers structure (for context switching)
-typedef struct {
-    unsigned int edi;
-    unsigned int esi;
-    unsigned int ebp;
-    unsigned int esp;      // Stack pointer (unused if kernel stack)
-    unsigned int ebx;
-    unsigned int edx;
-    unsigned int ecx;
-    unsigned int eax;
-    
-    // Segment registers
-    unsigned int gs;
-    unsigned int fs;
-    unsigned int es;
-    unsigned int ds;
-    
-    // Control registers
-    unsigned int eip;      // Instruction pointer
-    unsigned int cs;       // Code segment
-    unsigned int eflags;   // Flags register
-    unsigned int esp_user; // User stack pointer (if switching to user mode)
-    unsigned int ss;       // Stack segment
-} cpu_registers_t;
-
 // Task Control Block (Process Control Block)
 typedef struct process {
     pid_t pid;                      // Process ID
@@ -51,19 +40,36 @@ typedef struct process {
     page_directory_t* page_dir;     // Page directory for this process
     unsigned int stack_top;         // Top of process stack
     unsigned int stack_bottom;      // Bottom of process stack
+    unsigned int stack_guard;       // Guard page below the stack (never mapped)
     unsigned int heap_start;        // Start of heap
     unsigned int heap_end;          // End of heap
     
-    // CPU context (registers)
-    cpu_registers_t registers;
+    // Kernel stack and saved context
+    // User registers live in the trap frame at the top of the kernel stack;
+    // kernel_esp points at the switch_to frame while the process is not running
+    unsigned int kernel_stack;      // Base of the kernel stack allocation
+    unsigned int kernel_esp;        // Saved kernel ESP (valid while switched out)
+    int kernel_thread;              // 1 for ring 0 threads with no user space
+    
+    // FPU/SSE context (allocated on first use, see fpu.c)
+    fpu_state_t* fpu_state;         // FXSAVE area, NULL until the first #NM
+    int fpu_used;                   // 1 once fpu_state holds valid state
+    
+    // Open files (shared with the parent's entries after fork)
+    vfs_fd_table_t* fd_table;       // Descriptor table, NULL for kernel threads
     
     // Scheduling
     unsigned long long time_slice;   // Remaining time slice
     unsigned long long total_time;   // Total CPU time used
+    struct process* run_next;       // Next process in run queue
+    struct process* run_prev;       // Previous process in run queue
+    int on_run_queue;               // 1 while linked into a run queue
+    void* wait_channel;             // Event slept on in process_sleep (NULL if none)
     
     // Process information
     char name[32];                  // Process name
     unsigned int exit_code;         // Exit code (when terminated)
+    int strace;                     // 1 to log every system call (systrace.c)
     int exit_status;                 // Exit status (for wait())
     
     // Parent-child relationships
@@ -84,6 +90,11 @@ void process_init(void);
 // Returns process pointer on success, NULL on failure
 process_t* process_create(const char* name, void (*entry_point)(void), unsigned int stack_size);
 
+// Create a kernel thread running fn(arg) in ring 0
+// The thread exits with status 0 when fn returns
+// Returns process pointer on success, NULL on failure
+process_t* kthread_create(const char* name, void (*fn)(void* arg), void* arg);
+
 // Destroy a process
 void process_destroy(process_t* proc);
 
@@ -96,6 +107,10 @@ process_t* process_get_by_pid(pid_t pid);
 // Switch to a different process (context switch)
 void process_switch(process_t* new_process);
 
+// Bookkeeping after a switch lands on a new stack (reaps exited threads)
+// Called from C after switch_to returns and from the thread start stubs
+void process_finish_switch(void);
+
 // Yield CPU to next process
 void process_yield(void);
 
@@ -105,6 +120,14 @@ void process_block(void);
 // Unblock a process
 void process_unblock(process_t* proc);
 
+// Block the current process until process_wakeup(channel)
+// Called with interrupts disabled; the caller re-checks its condition afterwards
+// The boot context cannot block and just yields
+void process_sleep(void* channel);
+
+// Unblock every process sleeping on channel
+void process_wakeup(void* channel);
+
 // Exit current process
 void process_exit(unsigned int exit_code);
 
@@ -124,6 +147,23 @@ unsigned int process_get_count(void);
 // Returns child PID in parent, 0 in child, -1 on error
 pid_t process_fork(void);
 
+// Duplicate the user half of an address space into dst
+// cow != 0 shares private pages copy-on-write, cow == 0 copies them eagerly
+// Returns 0 on success, -1 on failure (dst is left empty)
+int process_clone_user_space(page_directory_t* dst, page_directory_t* src, int cow);
+
+// Release every user page and page table of an address space
+void process_free_user_space(page_directory_t* dir);
+
+// Check that [addr, addr + size) is user memory the kernel can write for the
+// current process (mapped writable, copy-on-write, or demand-zero)
+// Returns 1 if so, 0 if not
+int process_user_writable(unsigned int addr, unsigned int size);
+
+// Handle a page fault (copy-on-write)
+// Returns 0 if handled, -1 if the fault is fatal
+int process_handle_page_fault(unsigned int fault_addr, unsigned int error_code);
+
 // Execute a new program (replace current process)
 // Returns -1 on error, never returns on success
 int process_exec(const char* path, char* const argv[]);
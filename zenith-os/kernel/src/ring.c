@@ -0,0 +1,94 @@
+#include "ring.h"
+#include "syscall.h"
+#include "process.h"
+
+// Lowest address a ring may live at (below is the kernel identity mapping)
+#define RING_USER_MIN 0x400000
+
+// Run one request through the same handlers the individual syscalls use
+static int ring_execute(const ring_sqe_t* sqe) {
+    switch (sqe->opcode) {
+        case RING_OP_NOP:
+            return 0;
+        case RING_OP_READ:
+            return syscall_handler(SYS_READ, (unsigned int)sqe->fd, sqe->addr, sqe->len, 0, 0);
+        case RING_OP_WRITE:
+            return syscall_handler(SYS_WRITE, (unsigned int)sqe->fd, sqe->addr, sqe->len, 0, 0);
+        case RING_OP_OPEN:
+            return syscall_handler(SYS_OPEN, sqe->addr, sqe->len, 0, 0, 0);
+        case RING_OP_CLOSE:
+            return syscall_handler(SYS_CLOSE, (unsigned int)sqe->fd, 0, 0, 0, 0);
+        case RING_OP_SEEK:
+            return syscall_handler(SYS_SEEK, (unsigned int)sqe->fd, sqe->addr, sqe->len, 0, 0);
+        case RING_OP_PIPE:
+            return syscall_handler(SYS_PIPE, sqe->addr, 0, 0, 0, 0);
+        case RING_OP_MSGSND:
+            return syscall_handler(SYS_MSGSND, (unsigned int)sqe->fd, sqe->addr, sqe->len, sqe->op_flags, 0);
+        case RING_OP_MSGRCV:
+            return syscall_handler(SYS_MSGRCV, (unsigned int)sqe->fd, sqe->addr, sqe->len, sqe->arg,
+                                   sqe->op_flags);
+        default:
+            return -1;
+    }
+}
+
+// Consume requests from a ring
+int ring_enter(unsigned int ring_addr, unsigned int to_submit, unsigned int min_complete, unsigned int flags) {
+    process_t* proc = process_get_current();
+    if (!proc || ring_addr < RING_USER_MIN || flags || min_complete) {
+        return -1;
+    }
+    
+    // Header, SQ and CQ are read and written below: reject a ring that is
+    // unmapped or read-only (such as the vDSO page) instead of faulting
+    if (!process_user_writable(ring_addr, sizeof(ring_t))) {
+        return -1;
+    }
+    
+    ring_t* ring = (ring_t*)ring_addr;
+    if (ring->sq_entries != RING_SQ_ENTRIES || ring->cq_entries != RING_CQ_ENTRIES) {
+        return -1;
+    }
+    
+    // Snapshot the indices once; user code may keep queueing meanwhile
+    unsigned int sq_head = ring->sq_head;
+    unsigned int sq_tail = ring->sq_tail;
+    unsigned int cq_tail = ring->cq_tail;
+    
+    // The user cannot have queued more than the SQ holds
+    unsigned int pending = sq_tail - sq_head;
+    if (pending > RING_SQ_ENTRIES) {
+        return -1;
+    }
+    if (to_submit > pending) {
+        to_submit = pending;
+    }
+    
+    unsigned int submitted = 0;
+    while (submitted < to_submit) {
+        // Stop rather than drop completions when the CQ is full
+        if (cq_tail - ring->cq_head >= RING_CQ_ENTRIES) {
+            ring->cq_stalls++;
+            break;
+        }
+        
+        const ring_sqe_t* sqe = &ring->sqes[sq_head & (RING_SQ_ENTRIES - 1)];
+        ring_cqe_t* cqe = &ring->cqes[cq_tail & (RING_CQ_ENTRIES - 1)];
+        
+        cqe->user_data = sqe->user_data;
+        cqe->result = ring_execute(sqe);
+        if (sqe->opcode > RING_OP_MSGRCV) {
+            ring->sq_dropped++;
+        }
+        
+        sq_head++;
+        cq_tail++;
+        submitted++;
+        
+        // Publish progress per entry so completions are visible in order
+        ring->sq_head = sq_head;
+        ring->cq_tail = cq_tail;
+    }
+    
+    return (int)submitted;
+}
@@ -0,0 +1,67 @@
+#ifndef RING_H
+#define RING_H
+
+// Batched system call rings (io_uring-style)
+// A process places a ring_t in its own memory, queues requests in the
+// submission queue (SQ) and calls SYS_RING_ENTER once for the whole batch.
+// Results come back in the completion queue (CQ) and are reaped without
+// another trap. Layout must match user/libc/sys/ring.h
+
+// Queue sizes (powers of two; the CQ is larger so a full SQ always fits)
+#define RING_SQ_ENTRIES 64
+#define RING_CQ_ENTRIES 128
+
+// Request opcodes
+#define RING_OP_NOP     0
+#define RING_OP_READ    1   // fd, addr = buffer, len = count
+#define RING_OP_WRITE   2   // fd, addr = buffer, len = count
+#define RING_OP_OPEN    3   // addr = path, len = open flags
+#define RING_OP_CLOSE   4   // fd
+#define RING_OP_SEEK    5   // fd, addr = offset, len = whence
+#define RING_OP_PIPE    6   // addr = int[2] for the new descriptors
+#define RING_OP_MSGSND  7   // fd = msqid, addr = message, len = size, op_flags = flags
+#define RING_OP_MSGRCV  8   // fd = msqid, addr = buffer, len = size, arg = type, op_flags = flags
+
+// Submission queue entry
+typedef struct {
+    unsigned char opcode;          // RING_OP_*
+    unsigned char flags;           // Reserved (0)
+    unsigned short reserved;
+    int fd;                        // File descriptor / queue ID
+    unsigned int addr;             // Buffer, path or array address
+    unsigned int len;              // Byte count or open flags
+    unsigned int arg;              // Extra argument (message type)
+    unsigned int op_flags;         // Per-operation flags
+    unsigned int user_data;        // Copied unchanged into the completion
+    unsigned int pad;
+} ring_sqe_t;
+
+// Completion queue entry
+typedef struct {
+    unsigned int user_data;        // From the submission
+    int result;                    // Same value the equivalent syscall returns
+} ring_cqe_t;
+
+// Shared ring
+// SQ: user fills sqes[sq_tail & mask] and advances sq_tail; kernel advances sq_head
+// CQ: kernel fills cqes[cq_tail & mask] and advances cq_tail; user advances cq_head
+typedef struct {
+    volatile unsigned int sq_head;
+    volatile unsigned int sq_tail;
+    volatile unsigned int cq_head;
+    volatile unsigned int cq_tail;
+    unsigned int sq_entries;       // Must be RING_SQ_ENTRIES
+    unsigned int cq_entries;       // Must be RING_CQ_ENTRIES
+    unsigned int sq_dropped;       // Invalid entries skipped by the kernel
+    unsigned int cq_stalls;        // Times submission stopped because the CQ was full
+    ring_sqe_t sqes[RING_SQ_ENTRIES];
+    ring_cqe_t cqes[RING_CQ_ENTRIES];
+} ring_t;
+
+// Consume up to to_submit requests from the ring at ring_addr (user memory)
+// Every operation completes before ring_enter returns, so there is nothing
+// to wait for: min_complete and flags are reserved and must be 0
+// Returns the number of requests consumed, or -1 if the ring is invalid
+int ring_enter(unsigned int ring_addr, unsigned int to_submit, unsigned int min_complete, unsigned int flags);
+
+#endif // RING_H
@@ -2,67 +2,138 @@
 #include "process.h"
 #include "timer.h"
 
-// Access to process list (needed by scheduler)
+// Access to process list (needed for priority boosts)
 extern process_t* g_process_list;
 
+// Run queue for one priority level
+typedef struct {
+    process_t* head;
+    process_t* tail;
+    unsigned int count;
+} run_queue_t;
+
 // Scheduler state
 static unsigned long long g_scheduler_ticks = 0;
-static unsigned int g_time_quantum = 10; // 10 ticks = 100ms at 100Hz
+static run_queue_t g_run_queues[SCHED_LEVELS];
+static unsigned int g_ready_bitmap = 0;  // Bit n set if level n has ready processes
+
+// Time quantum per level (ticks): short for interactive, long for CPU-bound
+static const unsigned int g_quantum[SCHED_LEVELS] = { 2, 3, 4, 6, 8, 12, 16, 20 };
+
+// Append a process to the tail of its level's queue
+static void run_queue_push(process_t* proc) {
+    run_queue_t* queue = &g_run_queues[proc->priority];
+    
+    proc->run_next = 0;
+    proc->run_prev = queue->tail;
+    if (queue->tail) {
+        queue->tail->run_next = proc;
+    } else {
+        queue->head = proc;
+    }
+    queue->tail = proc;
+    queue->count++;
+    proc->on_run_queue = 1;
+    
+    g_ready_bitmap |= 1u << proc->priority;
+}
+
+// Unlink a process from its level's queue
+static void run_queue_remove(process_t* proc) {
+    run_queue_t* queue = &g_run_queues[proc->priority];
+    
+    if (proc->run_prev) {
+        proc->run_prev->run_next = proc->run_next;
+    } else {
+        queue->head = proc->run_next;
+    }
+    if (proc->run_next) {
+        proc->run_next->run_prev = proc->run_prev;
+    } else {
+        queue->tail = proc->run_prev;
+    }
+    proc->run_next = 0;
+    proc->run_prev = 0;
+    queue->count--;
+    proc->on_run_queue = 0;
+    
+    if (!queue->head) {
+        g_ready_bitmap &= ~(1u << proc->priority);
+    }
+}
+
+// Move every process back to the top level so CPU-bound tasks cannot starve
+static void priority_boost(void) {
+    for (process_t* proc = g_process_list; proc; proc = proc->next) {
+        if (proc->priority == 0) {
+            continue;
+        }
+        if (proc->on_run_queue) {
+            run_queue_remove(proc);
+            proc->priority = 0;
+            run_queue_push(proc);
+        } else {
+            proc->priority = 0;
+        }
+    }
+}
 
 // Initialize scheduler
 void scheduler_init(void) {
     g_scheduler_ticks = 0;
+    g_ready_bitmap = 0;
+    for (int i = 0; i < SCHED_LEVELS; i++) {
+        g_run_queues[i].head = 0;
+        g_run_queues[i].tail = 0;
+        g_run_queues[i].count = 0;
+    }
 }
 
-// Get next process to run (round-robin)
+// Get next process to run (highest non-empty level, FIFO within a level)
 process_t* scheduler_get_next(void) {
-    process_t* current = process_get_current();
-    process_t* start = current;
-    process_t* next = 0;
-    
-    // If no current process, find first ready process
-    if (!current) {
-        process_t* proc = g_process_list;
-        while (proc) {
-            if (proc->state == PROCESS_STATE_READY) {
-                return proc;
-            }
-            proc = proc->next;
-        }
-        return 0;
+    if (!g_ready_bitmap) {
+        return 0; // No ready processes
     }
     
-    // Round-robin: find next ready process
-    next = current->next;
-    if (!next) {
-        next = g_process_list; // Wrap around
+    process_t* next = g_run_queues[__builtin_ctz(g_ready_bitmap)].head;
+    run_queue_remove(next);
+    return next;
+}
+
+// Schedule a process (add to ready queue)
+void scheduler_schedule(process_t* proc) {
+    if (!proc) {
+        return;
     }
     
-    // Search for next ready process
-    while (next != start) {
-        if (next && next->state == PROCESS_STATE_READY) {
-            return next;
-        }
-        next = next->next;
-        if (!next) {
-            next = g_process_list; // Wrap around
-        }
+    if (proc->priority >= SCHED_LEVELS) {
+        proc->priority = SCHED_LEVELS - 1;
     }
     
-    // If we get here, current process is the only ready one
-    if (current->state == PROCESS_STATE_READY) {
-        return current;
+    proc->state = PROCESS_STATE_READY;
+    proc->time_slice = g_quantum[proc->priority];
+    if (!proc->on_run_queue) {
+        run_queue_push(proc);
+    }
+}
+
+// Wake a blocked process
+void scheduler_wake(process_t* proc) {
+    if (!proc) {
+        return;
     }
     
-    // No ready processes
-    return 0;
+    // Tasks that block before using up their quantum are interactive: boost
+    if (proc->priority > 0) {
+        proc->priority--;
+    }
+    scheduler_schedule(proc);
 }
 
-// Schedule a process (add to ready queue)
-void scheduler_schedule(process_t* proc) {
-    if (proc) {
-        proc->state = PROCESS_STATE_READY;
-        proc->time_slice = g_time_quantum;
+// Remove a process from the run queues
+void scheduler_remove(process_t* proc) {
+    if (proc && proc->on_run_queue) {
+        run_queue_remove(proc);
     }
 }
 
@@ -70,6 +141,10 @@ void scheduler_schedule(process_t* proc) {
 void scheduler_tick(void) {
     g_scheduler_ticks++;
     
+    if (g_scheduler_ticks % SCHED_BOOST_INTERVAL == 0) {
+        priority_boost();
+    }
+    
     process_t* current = process_get_current();
     
     if (current) {
@@ -79,8 +154,14 @@ void scheduler_tick(void) {
         }
         current->total_time++;
         
-        // Time slice expired - yield
         if (current->time_slice == 0) {
+            // Used its whole quantum: CPU-bound, decay one level
+            if (current->priority < SCHED_LEVELS - 1) {
+                current->priority++;
+            }
+            process_yield();
+        } else if (g_ready_bitmap & ((1u << current->priority) - 1)) {
+            // A higher-priority process became ready: preempt
             process_yield();
         }
     } else {
@@ -92,8 +173,23 @@ void scheduler_tick(void) {
     }
 }
 
+// Get time quantum for a level
+unsigned int scheduler_get_quantum(unsigned int priority) {
+    if (priority >= SCHED_LEVELS) {
+        priority = SCHED_LEVELS - 1;
+    }
+    return g_quantum[priority];
+}
+
+// Get queue length for a level
+unsigned int scheduler_get_queue_length(unsigned int priority) {
+    if (priority >= SCHED_LEVELS) {
+        return 0;
+    }
+    return g_run_queues[priority].count;
+}
+
 // Get scheduler statistics
 unsigned long long scheduler_get_ticks(void) {
     return g_scheduler_ticks;
 }
-
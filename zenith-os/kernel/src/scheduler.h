@@ -3,20 +3,36 @@
 
 #include "process.h"
 
+// Multi-level feedback queue configuration
+#define SCHED_LEVELS          8     // Priority levels (0 = highest)
+#define SCHED_BOOST_INTERVAL  100   // Ticks between global priority boosts (1s at 100Hz)
+
 // Initialize scheduler
 void scheduler_init(void);
 
-// Get next process to run (round-robin)
+// Pick the next process to run and remove it from its run queue (O(1))
+// Returns NULL if no process is ready
 process_t* scheduler_get_next(void);
 
-// Schedule a process (add to ready queue)
+// Schedule a process (mark READY and append to its priority's run queue)
 void scheduler_schedule(process_t* proc);
 
+// Wake a blocked process: boost its priority one level and schedule it
+void scheduler_wake(process_t* proc);
+
+// Remove a process from the run queues (no-op if not queued)
+void scheduler_remove(process_t* proc);
+
 // Tick handler (called from timer interrupt)
 void scheduler_tick(void);
 
+// Time quantum (ticks) for a priority level
+unsigned int scheduler_get_quantum(unsigned int priority);
+
+// Number of processes queued at a priority level
+unsigned int scheduler_get_queue_length(unsigned int priority);
+
 // Get scheduler statistics
 unsigned long long scheduler_get_ticks(void);
 
 #endif // SCHEDULER_H
-
@@ -7,6 +7,15 @@
 #include "memory.h"
 #include "pmm.h"
 #include "paging.h"
+#include "bench.h"
+#include "systrace.h"
+#include "pagecache.h"
+#include "dcache.h"
+#include "journal.h"
+#include "slab.h"
+#include "heap.h"
+#include "fs_simple.h"
+#include "ata.h"
 
 #define SHELL_MAX_LINE 256
 #define SHELL_MAX_ARGS 16
@@ -56,6 +65,27 @@ static char* strtok(char* str, const char* delim) {
     return start;
 }
 
+// Print an unsigned decimal number
+static void print_uint(unsigned int value) {
+    char buf[16];
+    int i = 0;
+    if (value == 0) {
+        buf[i++] = '0';
+    } else {
+        char temp[16];
+        int j = 0;
+        while (value > 0) {
+            temp[j++] = '0' + (value % 10);
+            value /= 10;
+        }
+        while (j > 0) {
+            buf[i++] = temp[--j];
+        }
+    }
+    buf[i] = '\0';
+    vga_print(buf);
+}
+
 // Parse command line into arguments
 static int parse_command(char* line, char* argv[], int max_args) {
     int argc = 0;
@@ -80,6 +110,15 @@ static int cmd_help(int argc, char* argv[]) {
     vga_print("  mkdir    - Create directory\n");
     vga_print("  rmdir    - Remove directory\n");
     vga_print("  ps       - List processes\n");
+    vga_print("  meminfo  - Show physical memory statistics\n");
+    vga_print("  slabinfo - Show kernel object cache statistics\n");
+    vga_print("  bench    - Run a kernel benchmark (bench <name>)\n");
+    vga_print("  sysstat  - Show system call counters (sysstat reset)\n");
+    vga_print("  cacheinfo - Show page cache, dentry cache and journal statistics\n");
+    vga_print("  readahead - Show or set the read-ahead limit (readahead [pages])\n");
+    vga_print("  sync     - Write all cached file data to disk\n");
+    vga_print("  mkfs     - Format the disk and mount it at / (mkfs [blocks] [inodes])\n");
+    vga_print("  strace   - Log a process's system calls to serial (strace <pid> [off])\n");
     vga_print("  exit     - Exit shell\n");
     return 0;
 }
@@ -184,8 +223,8 @@ static int cmd_rmdir(int argc, char* argv[]) {
 
 // Command: ps
 static int cmd_ps(int argc, char* argv[]) {
-    vga_print("PID  Name\n");
-    vga_print("---  ----\n");
+    vga_print("PID  Pri  Name\n");
+    vga_print("---  ---  ----\n");
     
     // Iterate through process list
     extern process_t* g_process_list;
@@ -211,6 +250,13 @@ static int cmd_ps(int argc, char* argv[]) {
         pid_str[i] = '\0';
         vga_print(pid_str);
         vga_print("  ");
+        
+        // Print MLFQ priority level (single digit)
+        char pri_str[2];
+        pri_str[0] = '0' + (proc->priority % 10);
+        pri_str[1] = '\0';
+        vga_print(pri_str);
+        vga_print("    ");
         vga_print(proc->name);
         vga_print("\n");
         
@@ -220,6 +266,264 @@ static int cmd_ps(int argc, char* argv[]) {
     return 0;
 }
 
+// Command: meminfo
+static int cmd_meminfo(int argc, char* argv[]) {
+    vga_print("Total pages: ");
+    print_uint((unsigned int)pmm_get_total_pages());
+    vga_print("  Free: ");
+    print_uint((unsigned int)pmm_get_free_pages());
+    vga_print("  Used: ");
+    print_uint((unsigned int)pmm_get_used_pages());
+    vga_print("\n");
+    
+    // Free blocks per buddy order (block size = 4KB << order)
+    vga_print("Free blocks by order:\n");
+    for (unsigned int order = 0; order < PMM_MAX_ORDER; order++) {
+        vga_print("  ");
+        print_uint(order);
+        vga_print(": ");
+        print_uint((unsigned int)pmm_get_free_blocks(order));
+        if (order % 4 == 3) {
+            vga_print("\n");
+        }
+    }
+    vga_print("Largest free order: ");
+    int largest = pmm_get_largest_free_order();
+    if (largest < 0) {
+        vga_print("none\n");
+    } else {
+        print_uint((unsigned int)largest);
+        vga_print("\n");
+    }
+    
+    // Kernel heap (bytes)
+    vga_print("Heap: size ");
+    print_uint(heap_get_total_size());
+    vga_print("  resident ");
+    print_uint(heap_get_resident_size());
+    vga_print("  used ");
+    print_uint(heap_get_used_size());
+    vga_print("  reclaimed ");
+    print_uint(heap_get_reclaimed_size());
+    vga_print("\n");
+    return 0;
+}
+
+// Command: slabinfo
+static int cmd_slabinfo(int argc, char* argv[]) {
+    vga_print("cache       objsize  active/total  slabs  pages/slab  waste\n");
+    for (unsigned int i = 0; i < kmem_cache_count(); i++) {
+        kmem_cache_t* cache = kmem_cache_get(i);
+        vga_print(cache->name);
+        for (int pad = strlen(cache->name); pad < 12; pad++) {
+            vga_print(" ");
+        }
+        print_uint(cache->object_size);
+        vga_print("  ");
+        print_uint(cache->active_objects);
+        vga_print("/");
+        print_uint(cache->total_objects);
+        vga_print("  ");
+        print_uint(cache->num_slabs);
+        vga_print("  ");
+        print_uint(cache->slab_pages);
+        vga_print("  ");
+        print_uint(kmem_cache_get_waste(cache));
+        vga_print("\n");
+    }
+    return 0;
+}
+
+// Command: bench
+static int cmd_bench(int argc, char* argv[]) {
+    if (argc < 2) {
+        bench_list();
+        return 0;
+    }
+    return bench_run(argv[1]);
+}
+
+// Command: cacheinfo
+static int cmd_cacheinfo(int argc, char* argv[]) {
+    pagecache_stats_t pc;
+    pagecache_get_stats(&pc);
+    vga_print("Page cache: pages ");
+    print_uint(pc.pages);
+    vga_print("/");
+    print_uint(PAGECACHE_MAX_PAGES);
+    vga_print("  hits ");
+    print_uint(pc.hits);
+    vga_print("  misses ");
+    print_uint(pc.misses);
+    vga_print("  evictions ");
+    print_uint(pc.evictions);
+    vga_print("  read-ahead ");
+    print_uint(pc.readahead);
+    vga_print("\n");
+    vga_print("            dirty ");
+    print_uint(pc.dirty);
+    vga_print("  written back ");
+    print_uint(pc.written);
+    vga_print("\n");
+    
+    dcache_stats_t dc;
+    dcache_get_stats(&dc);
+    vga_print("Dentry cache: entries ");
+    print_uint(dc.entries);
+    vga_print("/");
+    print_uint(DCACHE_ENTRIES);
+    vga_print("  hits ");
+    print_uint(dc.hits);
+    vga_print("  negative ");
+    print_uint(dc.negative_hits);
+    vga_print("  misses ");
+    print_uint(dc.misses);
+    vga_print("  evictions ");
+    print_uint(dc.evictions);
+    vga_print("\n");
+    
+    journal_stats_t js;
+    journal_get_stats(&js);
+    vga_print("Journal: commits ");
+    print_uint(js.commits);
+    vga_print("  blocks logged ");
+    print_uint(js.logged);
+    vga_print("  absorbed ");
+    print_uint(js.absorbed);
+    vga_print("  checkpoints ");
+    print_uint(js.checkpoints);
+    vga_print("  replayed ");
+    print_uint(js.replayed);
+    vga_print("\n");
+    return 0;
+}
+
+// Parse an unsigned decimal number, returning -1 if it is not one
+static int parse_uint(const char* s) {
+    if (!*s) {
+        return -1;
+    }
+    int value = 0;
+    for (; *s; s++) {
+        if (*s < '0' || *s > '9') {
+            return -1;
+        }
+        value = value * 10 + (*s - '0');
+    }
+    return value;
+}
+
+// Command: sysstat
+static int cmd_sysstat(int argc, char* argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "reset") == 0) {
+        systrace_reset();
+        return 0;
+    }
+    
+    vga_print("syscall      calls  errors  avg cyc  max cyc\n");
+    for (unsigned int num = 0; num < SYSTRACE_MAX_SYSCALLS; num++) {
+        const syscall_stat_t* stat = systrace_get_stat(num);
+        if (!stat->calls) {
+            continue;
+        }
+        const char* name = systrace_name(num);
+        vga_print(name);
+        for (int pad = strlen(name); pad < 12; pad++) {
+            vga_print(" ");
+        }
+        print_uint(stat->calls);
+        vga_print("  ");
+        print_uint(stat->errors);
+        vga_print("  ");
+        print_uint(systrace_get_avg_cycles(num));
+        vga_print("  ");
+        print_uint(stat->max_cycles > 0xFFFFFFFFULL ? 0xFFFFFFFF : (unsigned int)stat->max_cycles);
+        vga_print("\n");
+    }
+    return 0;
+}
+
+// Command: readahead
+static int cmd_readahead(int argc, char* argv[]) {
+    if (argc >= 2) {
+        int pages = parse_uint(argv[1]);
+        if (pages < 0) {
+            vga_print("Usage: readahead [pages]\n");
+            return 0;
+        }
+        vfs_set_readahead_max((unsigned int)pages);
+    }
+    
+    vga_print("Read-ahead limit: ");
+    print_uint(vfs_get_readahead_max());
+    vga_print(" pages\n");
+    return 0;
+}
+
+// Command: sync
+static int cmd_sync(int argc, char* argv[]) {
+    if (vfs_sync() != 0) {
+        vga_print("sync: write error\n");
+    }
+    return 0;
+}
+
+// Sectors on the disk (LBA28 count from IDENTIFY), 0 if unknown
+static unsigned int disk_sectors(void) {
+    unsigned short id[256];
+    vfs_lock();
+    int result = ata_identify((unsigned char*)id);
+    vfs_unlock();
+    if (result != 0) {
+        return 0;
+    }
+    return id[60] | (unsigned int)id[61] << 16;
+}
+
+// Command: mkfs
+static int cmd_mkfs(int argc, char* argv[]) {
+    int blocks = argc >= 2 ? parse_uint(argv[1]) : (int)disk_sectors();
+    int inodes = argc >= 3 ? parse_uint(argv[2]) : blocks / 32;
+    if (blocks <= 0 || inodes < 0) {
+        vga_print("Usage: mkfs [blocks] [inodes]\n");
+        return 0;
+    }
+    if (inodes < 64) {
+        inodes = 64;
+    }
+    
+    if (simple_fs_format((unsigned int)blocks, (unsigned int)inodes) != 0) {
+        vga_print("mkfs: cannot format (already mounted, disk too small or write error)\n");
+        return 0;
+    }
+    if (vfs_mount("ata0", "/", "simple") != 0) {
+        vga_print("mkfs: formatted, but the mount failed\n");
+        return 0;
+    }
+    
+    vga_print("mkfs: ");
+    print_uint((unsigned int)blocks);
+    vga_print(" blocks, ");
+    print_uint((unsigned int)inodes);
+    vga_print(" inodes, mounted at /\n");
+    return 0;
+}
+
+// Command: strace
+static int cmd_strace(int argc, char* argv[]) {
+    if (argc < 2) {
+        vga_print("Usage: strace <pid> [off]\n");
+        return 0;
+    }
+    
+    int pid = parse_uint(argv[1]);
+    int enable = !(argc >= 3 && strcmp(argv[2], "off") == 0);
+    if (pid < 0 || systrace_set((pid_t)pid, enable) != 0) {
+        vga_print("strace: no such user process\n");
+    }
+    return 0;
+}
+
 // Command: exit
 static int cmd_exit(int argc, char* argv[]) {
     return 1; // Signal to exit shell
@@ -260,6 +564,24 @@ int shell_execute_command(const char* command) {
         return cmd_rmdir(argc, argv);
     } else if (strcmp(argv[0], "ps") == 0) {
         return cmd_ps(argc, argv);
+    } else if (strcmp(argv[0], "meminfo") == 0) {
+        return cmd_meminfo(argc, argv);
+    } else if (strcmp(argv[0], "slabinfo") == 0) {
+        return cmd_slabinfo(argc, argv);
+    } else if (strcmp(argv[0], "bench") == 0) {
+        return cmd_bench(argc, argv);
+    } else if (strcmp(argv[0], "cacheinfo") == 0) {
+        return cmd_cacheinfo(argc, argv);
+    } else if (strcmp(argv[0], "readahead") == 0) {
+        return cmd_readahead(argc, argv);
+    } else if (strcmp(argv[0], "sync") == 0) {
+        return cmd_sync(argc, argv);
+    } else if (strcmp(argv[0], "mkfs") == 0) {
+        return cmd_mkfs(argc, argv);
+    } else if (strcmp(argv[0], "sysstat") == 0) {
+        return cmd_sysstat(argc, argv);
+    } else if (strcmp(argv[0], "strace") == 0) {
+        return cmd_strace(argc, argv);
     } else if (strcmp(argv[0], "exit") == 0) {
         return cmd_exit(argc, argv);
     } else {
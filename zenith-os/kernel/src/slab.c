@@ -0,0 +1,266 @@
+#include "slab.h"
+#include "paging.h"
+
+// Object alignment
+#define KMEM_ALIGN 8
+
+// Slab header alignment (objects whose size is a multiple of 16 stay 16-byte aligned,
+// as FXSAVE areas require)
+#define KMEM_HEADER_ALIGN 16
+
+// Minimum objects per slab before a larger slab is used
+#define KMEM_MIN_OBJECTS 8
+
+// Largest slab (in pages)
+#define KMEM_MAX_SLAB_PAGES 16
+
+// Registered caches
+static kmem_cache_t g_caches[KMEM_MAX_CACHES];
+static unsigned int g_cache_count = 0;
+
+// Free objects are linked through their first word
+typedef struct kmem_free_object {
+    struct kmem_free_object* next;
+} kmem_free_object_t;
+
+// Align header so the first object is aligned as well
+static unsigned int slab_header_size(void) {
+    return (sizeof(kmem_slab_t) + KMEM_HEADER_ALIGN - 1) & ~(KMEM_HEADER_ALIGN - 1);
+}
+
+// Remove a slab from a list
+static void slab_list_remove(kmem_slab_t** list, kmem_slab_t* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        *list = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->next = 0;
+    slab->prev = 0;
+}
+
+// Push a slab onto a list
+static void slab_list_push(kmem_slab_t** list, kmem_slab_t* slab) {
+    slab->prev = 0;
+    slab->next = *list;
+    if (*list) {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+// Find the slab an object lives in (slabs are buddy blocks, aligned to their
+// size relative to the start of managed memory, not to physical address 0)
+static kmem_slab_t* slab_of(kmem_cache_t* cache, void* obj) {
+    unsigned int slab_bytes = cache->slab_pages * PAGE_SIZE;
+    unsigned int start = (unsigned int)pmm_get_mem_start();
+    return (kmem_slab_t*)(start + (((unsigned int)obj - start) & ~(slab_bytes - 1)));
+}
+
+// Allocate a new slab and thread its objects onto the slab free list
+static kmem_slab_t* slab_create(kmem_cache_t* cache) {
+    unsigned long long phys = pmm_alloc_pages(cache->slab_pages);
+    if (!phys) {
+        return 0;
+    }
+    
+    for (unsigned int i = 0; i < cache->slab_pages; i++) {
+        pmm_get_page(phys + i * PAGE_SIZE)->flags |= PG_KERNEL;
+    }
+    
+    kmem_slab_t* slab = (kmem_slab_t*)(unsigned int)phys;
+    slab->next = 0;
+    slab->prev = 0;
+    slab->cache = cache;
+    slab->in_use = 0;
+    slab->free = 0;
+    
+    // Build the free list back to front so objects are handed out in address order
+    unsigned char* base = (unsigned char*)slab + slab_header_size();
+    for (unsigned int i = cache->objects_per_slab; i > 0; i--) {
+        kmem_free_object_t* obj = (kmem_free_object_t*)(base + (i - 1) * cache->object_size);
+        obj->next = (kmem_free_object_t*)slab->free;
+        slab->free = obj;
+    }
+    
+    cache->num_slabs++;
+    cache->total_objects += cache->objects_per_slab;
+    return slab;
+}
+
+// Return a slab's pages to the PMM
+static void slab_destroy(kmem_cache_t* cache, kmem_slab_t* slab) {
+    cache->num_slabs--;
+    cache->total_objects -= cache->objects_per_slab;
+    pmm_free_pages((unsigned long long)(unsigned int)slab, cache->slab_pages);
+}
+
+// Create an object cache
+kmem_cache_t* kmem_cache_create(const char* name, unsigned int size, void (*ctor)(void* obj)) {
+    if (g_cache_count >= KMEM_MAX_CACHES || size == 0) {
+        return 0;
+    }
+    
+    // Objects must be able to hold the free list link
+    if (size < sizeof(kmem_free_object_t)) {
+        size = sizeof(kmem_free_object_t);
+    }
+    size = (size + KMEM_ALIGN - 1) & ~(KMEM_ALIGN - 1);
+    
+    // Smallest power-of-two slab that holds enough objects
+    unsigned int slab_pages = 1;
+    while (slab_pages < KMEM_MAX_SLAB_PAGES &&
+           (slab_pages * PAGE_SIZE - slab_header_size()) / size < KMEM_MIN_OBJECTS) {
+        slab_pages <<= 1;
+    }
+    
+    unsigned int objects = (slab_pages * PAGE_SIZE - slab_header_size()) / size;
+    if (objects == 0) {
+        return 0; // Object too large for a slab
+    }
+    
+    kmem_cache_t* cache = &g_caches[g_cache_count++];
+    
+    int i = 0;
+    while (name[i] && i < KMEM_NAME_LEN - 1) {
+        cache->name[i] = name[i];
+        i++;
+    }
+    cache->name[i] = '\0';
+    
+    cache->object_size = size;
+    cache->slab_pages = slab_pages;
+    cache->objects_per_slab = objects;
+    cache->ctor = ctor;
+    cache->partial = 0;
+    cache->full = 0;
+    cache->empty = 0;
+    cache->active_objects = 0;
+    cache->total_objects = 0;
+    cache->num_slabs = 0;
+    cache->allocs = 0;
+    cache->frees = 0;
+    
+    return cache;
+}
+
+// Allocate an object
+void* kmem_cache_alloc(kmem_cache_t* cache) {
+    if (!cache) {
+        return 0;
+    }
+    
+    // Prefer partially used slabs, then empty ones, then a fresh slab
+    kmem_slab_t* slab = cache->partial;
+    if (!slab) {
+        slab = cache->empty;
+        if (slab) {
+            slab_list_remove(&cache->empty, slab);
+        } else {
+            slab = slab_create(cache);
+            if (!slab) {
+                return 0; // Out of memory
+            }
+        }
+        slab_list_push(&cache->partial, slab);
+    }
+    
+    kmem_free_object_t* obj = (kmem_free_object_t*)slab->free;
+    slab->free = obj->next;
+    slab->in_use++;
+    
+    if (!slab->free) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_push(&cache->full, slab);
+    }
+    
+    cache->active_objects++;
+    cache->allocs++;
+    
+    if (cache->ctor) {
+        cache->ctor(obj);
+    }
+    
+    return obj;
+}
+
+// Free an object
+void kmem_cache_free(kmem_cache_t* cache, void* obj) {
+    if (!cache || !obj) {
+        return;
+    }
+    
+    kmem_slab_t* slab = slab_of(cache, obj);
+    if (slab->cache != cache || slab->in_use == 0) {
+        return; // Not ours (or double free)
+    }
+    
+    // A full slab moves back to the partial list
+    if (!slab->free) {
+        slab_list_remove(&cache->full, slab);
+        slab_list_push(&cache->partial, slab);
+    }
+    
+    kmem_free_object_t* free_obj = (kmem_free_object_t*)obj;
+    free_obj->next = (kmem_free_object_t*)slab->free;
+    slab->free = free_obj;
+    slab->in_use--;
+    
+    cache->active_objects--;
+    cache->frees++;
+    
+    if (slab->in_use == 0) {
+        slab_list_remove(&cache->partial, slab);
+        
+        // Keep one empty slab around to absorb alloc/free churn
+        if (cache->empty) {
+            slab_destroy(cache, slab);
+        } else {
+            slab_list_push(&cache->empty, slab);
+        }
+    }
+}
+
+// Release empty slabs
+unsigned int kmem_cache_shrink(kmem_cache_t* cache) {
+    if (!cache) {
+        return 0;
+    }
+    
+    unsigned int released = 0;
+    while (cache->empty) {
+        kmem_slab_t* slab = cache->empty;
+        slab_list_remove(&cache->empty, slab);
+        slab_destroy(cache, slab);
+        released += cache->slab_pages;
+    }
+    
+    return released;
+}
+
+// Bytes lost to slab headers and unusable slab tails
+unsigned int kmem_cache_get_waste(kmem_cache_t* cache) {
+    if (!cache) {
+        return 0;
+    }
+    
+    unsigned int slab_bytes = cache->slab_pages * PAGE_SIZE;
+    unsigned int per_slab = slab_bytes - cache->objects_per_slab * cache->object_size;
+    return cache->num_slabs * per_slab;
+}
+
+// Get number of caches
+unsigned int kmem_cache_count(void) {
+    return g_cache_count;
+}
+
+// Get cache by index
+kmem_cache_t* kmem_cache_get(unsigned int index) {
+    if (index >= g_cache_count) {
+        return 0;
+    }
+    return &g_caches[index];
+}
@@ -0,0 +1,64 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "pmm.h"
+
+// Maximum number of object caches
+#define KMEM_MAX_CACHES 16
+
+// Maximum length of a cache name (including terminator)
+#define KMEM_NAME_LEN 24
+
+// Slab header, stored at the start of every slab
+typedef struct kmem_slab {
+    struct kmem_slab* next;       // Next slab on the same list
+    struct kmem_slab* prev;       // Previous slab on the same list
+    struct kmem_cache* cache;     // Owning cache
+    void* free;                   // First free object in this slab
+    unsigned int in_use;          // Allocated objects in this slab
+} kmem_slab_t;
+
+// Object cache: slabs of equally sized objects
+typedef struct kmem_cache {
+    char name[KMEM_NAME_LEN];     // Cache name (for statistics)
+    unsigned int object_size;     // Size of each object (aligned)
+    unsigned int slab_pages;      // Pages per slab (power of two)
+    unsigned int objects_per_slab; // Objects that fit in one slab
+    void (*ctor)(void* obj);      // Constructor run on every allocation (optional)
+    
+    kmem_slab_t* partial;         // Slabs with free and used objects
+    kmem_slab_t* full;            // Slabs with no free objects
+    kmem_slab_t* empty;           // Slabs with no used objects
+    
+    // Statistics
+    unsigned int active_objects;  // Objects currently allocated
+    unsigned int total_objects;   // Object capacity of all slabs
+    unsigned int num_slabs;       // Slabs owned by the cache
+    unsigned long long allocs;    // Total allocations
+    unsigned long long frees;     // Total frees
+} kmem_cache_t;
+
+// Create an object cache
+// size: object size in bytes, ctor: optional constructor (NULL for none)
+// Returns cache pointer on success, NULL on failure
+kmem_cache_t* kmem_cache_create(const char* name, unsigned int size, void (*ctor)(void* obj));
+
+// Allocate an object from a cache (O(1) unless a new slab is needed)
+// Returns object pointer, or NULL if out of memory
+void* kmem_cache_alloc(kmem_cache_t* cache);
+
+// Return an object to its cache
+void kmem_cache_free(kmem_cache_t* cache, void* obj);
+
+// Release all empty slabs of a cache back to the PMM
+// Returns number of pages released
+unsigned int kmem_cache_shrink(kmem_cache_t* cache);
+
+// Bytes of slab memory that can never hold an object (headers and tails)
+unsigned int kmem_cache_get_waste(kmem_cache_t* cache);
+
+// Get number of caches and a cache by index (for statistics)
+unsigned int kmem_cache_count(void);
+kmem_cache_t* kmem_cache_get(unsigned int index);
+
+#endif // SLAB_H
@@ -0,0 +1,97 @@
+#include "string.h"
+#include "cpu.h"
+#include "fpu.h"
+
+// Selected implementations (rep movsd/stosd until string_init runs)
+static int g_has_sse2 = 0;
+
+// Pick implementations by CPUID
+void string_init(void) {
+    unsigned int features = cpu_features_edx();
+    
+    if ((features & CPUID_EDX_SSE2) && (features & CPUID_EDX_FXSR)) {
+        // Enable SSE: no x87 emulation, FXSAVE/FXRSTOR and SIMD exceptions supported
+        cpu_write_cr0((cpu_read_cr0() & ~CR0_EM) | CR0_MP);
+        cpu_write_cr4(cpu_read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+        
+        g_has_sse2 = 1;
+    }
+}
+
+// Check for SSE2
+int string_has_sse2(void) {
+    return g_has_sse2;
+}
+
+// Copy memory
+void* memcpy(void* dst, const void* src, unsigned int n) {
+    if (g_has_sse2 && n >= STRING_NT_THRESHOLD) {
+        unsigned int flags = kernel_fpu_begin();
+        memcpy_sse2_nt(dst, src, n);
+        kernel_fpu_end(flags);
+    } else {
+        memcpy_rep(dst, src, n);
+    }
+    return dst;
+}
+
+// Copy possibly overlapping memory
+void* memmove(void* dst, const void* src, unsigned int n) {
+    unsigned int d = (unsigned int)dst;
+    unsigned int s = (unsigned int)src;
+    
+    // Forward copy is safe unless dst starts inside src
+    if (d <= s || d >= s + n) {
+        memcpy_rep(dst, src, n);
+    } else {
+        memmove_backward(dst, src, n);
+    }
+    return dst;
+}
+
+// Fill memory
+void* memset(void* dst, int c, unsigned int n) {
+    if (g_has_sse2 && n >= STRING_NT_THRESHOLD) {
+        unsigned int flags = kernel_fpu_begin();
+        memset_sse2_nt(dst, c, n);
+        kernel_fpu_end(flags);
+    } else {
+        memset_rep(dst, c, n);
+    }
+    return dst;
+}
+
+// Compare memory
+int memcmp(const void* a, const void* b, unsigned int n) {
+    const unsigned char* pa = (const unsigned char*)a;
+    const unsigned char* pb = (const unsigned char*)b;
+    
+    for (unsigned int i = 0; i < n; i++) {
+        if (pa[i] != pb[i]) {
+            return pa[i] - pb[i];
+        }
+    }
+    return 0;
+}
+
+// Copy one page
+void copy_page(void* dst, const void* src) {
+    if (g_has_sse2) {
+        unsigned int flags = kernel_fpu_begin();
+        copy_page_sse2_nt(dst, src);
+        kernel_fpu_end(flags);
+    } else {
+        copy_page_rep(dst, src);
+    }
+}
+
+// Clear one page
+void clear_page(void* dst) {
+    if (g_has_sse2) {
+        unsigned int flags = kernel_fpu_begin();
+        clear_page_sse2_nt(dst);
+        kernel_fpu_end(flags);
+    } else {
+        clear_page_rep(dst);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef STRING_H
+#define STRING_H
+
+// Copies at least this large use non-temporal stores when SSE2 is available
+#define STRING_NT_THRESHOLD (64 * 1024)
+
+// Select the memory primitives for this CPU (CPUID) and enable SSE if present
+// Before this runs, the rep movsd/stosd versions are used
+void string_init(void);
+
+// Returns 1 if the SSE2 variants are in use
+int string_has_sse2(void);
+
+// Copy n bytes (regions must not overlap)
+void* memcpy(void* dst, const void* src, unsigned int n);
+
+// Copy n bytes (regions may overlap)
+void* memmove(void* dst, const void* src, unsigned int n);
+
+// Fill n bytes with c
+void* memset(void* dst, int c, unsigned int n);
+
+// Compare n bytes; returns <0, 0 or >0
+int memcmp(const void* a, const void* b, unsigned int n);
+
+// Copy / clear one page (both pointers page aligned)
+void copy_page(void* dst, const void* src);
+void clear_page(void* dst);
+
+// Individual implementations (string_asm.s), exposed for benchmarking
+void memcpy_rep(void* dst, const void* src, unsigned int n);
+void memcpy_sse2_nt(void* dst, const void* src, unsigned int n);
+void memmove_backward(void* dst, const void* src, unsigned int n);
+void memset_rep(void* dst, int c, unsigned int n);
+void memset_sse2_nt(void* dst, int c, unsigned int n);
+void copy_page_rep(void* dst, const void* src);
+void copy_page_sse2_nt(void* dst, const void* src);
+void clear_page_rep(void* dst);
+void clear_page_sse2_nt(void* dst);
+
+#endif // STRING_H
@@ -0,0 +1,253 @@
+# Kernel memory copy/fill primitives
+# All functions use the cdecl calling convention and preserve EBX, ESI, EDI, EBP.
+# The SSE2 variants use non-temporal stores (they bypass the cache) and save
+# and restore the XMM registers they touch, so they never disturb user FPU state.
+
+# void memcpy_rep(void* dst, const void* src, unsigned int n)
+.global memcpy_rep
+memcpy_rep:
+    push %esi
+    push %edi
+    mov 12(%esp), %edi      # dst
+    mov 16(%esp), %esi      # src
+    mov 20(%esp), %ecx      # n
+    mov %ecx, %edx
+    shr $2, %ecx
+    cld
+    rep movsl               # Bulk copy in dwords
+    mov %edx, %ecx
+    and $3, %ecx
+    rep movsb               # Remaining 0-3 bytes
+    pop %edi
+    pop %esi
+    ret
+
+# void memmove_backward(void* dst, const void* src, unsigned int n)
+# Copies from the end down, for overlapping moves with dst > src
+.global memmove_backward
+memmove_backward:
+    push %esi
+    push %edi
+    mov 12(%esp), %edi      # dst
+    mov 16(%esp), %esi      # src
+    mov 20(%esp), %ecx      # n
+    lea -1(%edi,%ecx), %edi # Last byte of dst
+    lea -1(%esi,%ecx), %esi # Last byte of src
+    mov %ecx, %edx
+    and $3, %ecx
+    std
+    rep movsb               # Trailing 0-3 bytes first
+    sub $3, %esi            # Point at the last whole dword
+    sub $3, %edi
+    mov %edx, %ecx
+    shr $2, %ecx
+    rep movsl
+    cld
+    pop %edi
+    pop %esi
+    ret
+
+# void memset_rep(void* dst, int c, unsigned int n)
+.global memset_rep
+memset_rep:
+    push %edi
+    mov 8(%esp), %edi       # dst
+    movzbl 12(%esp), %eax   # c (byte)
+    imul $0x01010101, %eax  # Replicate into all four bytes
+    mov 16(%esp), %ecx      # n
+    mov %ecx, %edx
+    shr $2, %ecx
+    cld
+    rep stosl
+    mov %edx, %ecx
+    and $3, %ecx
+    rep stosb
+    pop %edi
+    ret
+
+# void copy_page_rep(void* dst, const void* src)
+.global copy_page_rep
+copy_page_rep:
+    push %esi
+    push %edi
+    mov 12(%esp), %edi
+    mov 16(%esp), %esi
+    mov $1024, %ecx
+    cld
+    rep movsl
+    pop %edi
+    pop %esi
+    ret
+
+# void clear_page_rep(void* dst)
+.global clear_page_rep
+clear_page_rep:
+    push %edi
+    mov 8(%esp), %edi
+    xor %eax, %eax
+    mov $1024, %ecx
+    cld
+    rep stosl
+    pop %edi
+    ret
+
+# Save/restore XMM0-XMM3 in a 64-byte stack area (stack may be unaligned)
+.macro SAVE_XMM
+    sub $64, %esp
+    movdqu %xmm0, 0(%esp)
+    movdqu %xmm1, 16(%esp)
+    movdqu %xmm2, 32(%esp)
+    movdqu %xmm3, 48(%esp)
+.endm
+
+.macro RESTORE_XMM
+    movdqu 0(%esp), %xmm0
+    movdqu 16(%esp), %xmm1
+    movdqu 32(%esp), %xmm2
+    movdqu 48(%esp), %xmm3
+    add $64, %esp
+.endm
+
+# void memcpy_sse2_nt(void* dst, const void* src, unsigned int n)
+# Intended for large copies (n >= 64); smaller sizes still work
+.global memcpy_sse2_nt
+memcpy_sse2_nt:
+    push %esi
+    push %edi
+    mov 12(%esp), %edi      # dst
+    mov 16(%esp), %esi      # src
+    mov 20(%esp), %edx      # n
+    cld
+    
+    # Byte-copy until dst is 16-byte aligned
+    mov %edi, %ecx
+    neg %ecx
+    and $15, %ecx
+    cmp %edx, %ecx
+    jbe 1f
+    mov %edx, %ecx
+1:
+    sub %ecx, %edx
+    rep movsb
+    
+    mov %edx, %ecx
+    shr $6, %ecx            # 64-byte chunks
+    jz 3f
+    SAVE_XMM
+2:
+    movdqu 0(%esi), %xmm0
+    movdqu 16(%esi), %xmm1
+    movdqu 32(%esi), %xmm2
+    movdqu 48(%esi), %xmm3
+    movntdq %xmm0, 0(%edi)
+    movntdq %xmm1, 16(%edi)
+    movntdq %xmm2, 32(%edi)
+    movntdq %xmm3, 48(%edi)
+    add $64, %esi
+    add $64, %edi
+    dec %ecx
+    jnz 2b
+    sfence                  # Order the streaming stores before returning
+    RESTORE_XMM
+3:
+    mov %edx, %ecx
+    and $63, %ecx
+    rep movsb               # Tail
+    pop %edi
+    pop %esi
+    ret
+
+# void memset_sse2_nt(void* dst, int c, unsigned int n)
+.global memset_sse2_nt
+memset_sse2_nt:
+    push %edi
+    mov 8(%esp), %edi       # dst
+    movzbl 12(%esp), %eax
+    imul $0x01010101, %eax
+    mov 16(%esp), %edx      # n
+    cld
+    
+    # Byte-fill until dst is 16-byte aligned
+    mov %edi, %ecx
+    neg %ecx
+    and $15, %ecx
+    cmp %edx, %ecx
+    jbe 1f
+    mov %edx, %ecx
+1:
+    sub %ecx, %edx
+    rep stosb
+    
+    mov %edx, %ecx
+    shr $6, %ecx
+    jz 3f
+    SAVE_XMM
+    movd %eax, %xmm0
+    pshufd $0, %xmm0, %xmm0 # Broadcast the fill pattern
+2:
+    movntdq %xmm0, 0(%edi)
+    movntdq %xmm0, 16(%edi)
+    movntdq %xmm0, 32(%edi)
+    movntdq %xmm0, 48(%edi)
+    add $64, %edi
+    dec %ecx
+    jnz 2b
+    sfence
+    RESTORE_XMM
+3:
+    mov %edx, %ecx
+    and $63, %ecx
+    rep stosb
+    pop %edi
+    ret
+
+# void copy_page_sse2_nt(void* dst, const void* src)
+# Both pointers must be page aligned
+.global copy_page_sse2_nt
+copy_page_sse2_nt:
+    push %esi
+    push %edi
+    mov 12(%esp), %edi
+    mov 16(%esp), %esi
+    SAVE_XMM
+    mov $64, %ecx           # 4096 / 64
+1:
+    movdqa 0(%esi), %xmm0
+    movdqa 16(%esi), %xmm1
+    movdqa 32(%esi), %xmm2
+    movdqa 48(%esi), %xmm3
+    movntdq %xmm0, 0(%edi)
+    movntdq %xmm1, 16(%edi)
+    movntdq %xmm2, 32(%edi)
+    movntdq %xmm3, 48(%edi)
+    add $64, %esi
+    add $64, %edi
+    dec %ecx
+    jnz 1b
+    sfence
+    RESTORE_XMM
+    pop %edi
+    pop %esi
+    ret
+
+# void clear_page_sse2_nt(void* dst)
+# dst must be page aligned
+.global clear_page_sse2_nt
+clear_page_sse2_nt:
+    push %edi
+    mov 8(%esp), %edi
+    SAVE_XMM
+    pxor %xmm0, %xmm0
+    mov $64, %ecx
+1:
+    movntdq %xmm0, 0(%edi)
+    movntdq %xmm0, 16(%edi)
+    movntdq %xmm0, 32(%edi)
+    movntdq %xmm0, 48(%edi)
+    add $64, %edi
+    dec %ecx
+    jnz 1b
+    sfence
+    RESTORE_XMM
+    pop %edi
+    ret
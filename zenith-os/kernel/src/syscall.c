@@ -3,19 +3,55 @@
 #include "idt.h"
 #include "memory.h"
 #include "vfs.h"
-#include "vga.h"
 #include "ipc.h"
+#include "ring.h"
+#include "gdt.h"
+#include "cpu.h"
+#include "systrace.h"
+
+// SYSENTER entry point (syscall_asm.s)
+extern void sysenter_entry(void);
 
 // Array of system call handlers
 static syscall_handler_t syscall_handlers[256];
+static syscall_handler5_t syscall_handlers5[256];
+
+// Program the SYSENTER MSRs if the CPU supports the instruction
+static void sysenter_init(void) {
+    unsigned int eax, ebx, ecx, edx;
+    cpu_cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_EDX_SEP) || !(edx & CPUID_EDX_MSR)) {
+        return;
+    }
+    
+    // Early Pentium Pro parts report SEP without implementing it
+    unsigned int family = (eax >> 8) & 0xF;
+    unsigned int model = (eax >> 4) & 0xF;
+    unsigned int stepping = eax & 0xF;
+    if (family == 6 && model < 3 && stepping < 3) {
+        return;
+    }
+    
+    // SYSENTER: CS = kernel code, SS = CS + 8 (kernel data)
+    // SYSEXIT:  CS = CS + 16 (user code), SS = CS + 24 (user data)
+    // ESP points at TSS.esp0 so the entry stub can load the running
+    // process's kernel stack without an MSR write per context switch
+    cpu_wrmsr(MSR_SYSENTER_CS, GDT_KERNEL_CS);
+    cpu_wrmsr(MSR_SYSENTER_ESP, (unsigned int)gdt_get_kernel_stack_slot());
+    cpu_wrmsr(MSR_SYSENTER_EIP, (unsigned int)sysenter_entry);
+}
 
 // Initialize system call interface
 void syscall_init(void) {
     // Clear all handlers
     for (int i = 0; i < 256; i++) {
         syscall_handlers[i] = 0;
+        syscall_handlers5[i] = 0;
     }
     
+    // Fast entry path (int $0x80 stays available as the fallback)
+    sysenter_init();
+    
     // Register system calls
     syscall_register(SYS_EXIT, sys_exit);
     syscall_register(SYS_WRITE, sys_write);
@@ -35,7 +71,7 @@ void syscall_init(void) {
     syscall_register(SYS_PIPE, sys_pipe);
     syscall_register(SYS_MSGGET, sys_msgget);
     syscall_register(SYS_MSGSND, sys_msgsnd);
-    syscall_register(SYS_MSGRCV, sys_msgrcv);
+    syscall_register5(SYS_MSGRCV, sys_msgrcv);
     syscall_register(SYS_MSGCTL, sys_msgctl);
     syscall_register(SYS_SHMGET, sys_shmget);
     syscall_register(SYS_SHMAT, sys_shmat);
@@ -44,6 +80,12 @@ void syscall_init(void) {
     syscall_register(SYS_SIGNAL, sys_signal);
     syscall_register(SYS_KILL, sys_kill);
     syscall_register(SYS_UNLINK, sys_unlink);
+    syscall_register(SYS_RING_ENTER, sys_ring_enter);
+    syscall_register(SYS_DUP, sys_dup);
+    syscall_register(SYS_DUP2, sys_dup2);
+    syscall_register(SYS_FSYNC, sys_fsync);
+    syscall_register(SYS_SYNC, sys_sync);
+    syscall_register(SYS_FALLOCATE, sys_fallocate);
 }
 
 // Register a system call handler
@@ -53,15 +95,39 @@ void syscall_register(unsigned int syscall_num, syscall_handler_t handler) {
     }
 }
 
+// Register a system call handler taking five arguments
+void syscall_register5(unsigned int syscall_num, syscall_handler5_t handler) {
+    if (syscall_num < 256) {
+        syscall_handlers5[syscall_num] = handler;
+    }
+}
+
 // System call handler (called from assembly)
-int syscall_handler(unsigned int syscall_num, unsigned int arg1, unsigned int arg2, unsigned int arg3, unsigned int arg4) {
+int syscall_handler(unsigned int syscall_num, unsigned int arg1, unsigned int arg2, unsigned int arg3,
+                    unsigned int arg4, unsigned int arg5) {
     // Check if system call number is valid
-    if (syscall_num >= 256 || !syscall_handlers[syscall_num]) {
+    if (syscall_num >= 256 || (!syscall_handlers[syscall_num] && !syscall_handlers5[syscall_num])) {
         return -1; // Invalid system call
     }
     
-    // Call the registered handler
-    return syscall_handlers[syscall_num](arg1, arg2, arg3, arg4);
+    // Call the registered handler, timing it for the per-syscall counters
+    unsigned long long start = cpu_rdtsc();
+    int result;
+    if (syscall_handlers5[syscall_num]) {
+        result = syscall_handlers5[syscall_num](arg1, arg2, arg3, arg4, arg5);
+    } else {
+        result = syscall_handlers[syscall_num](arg1, arg2, arg3, arg4);
+    }
+    systrace_account(syscall_num, arg1, arg2, arg3, arg4, result, cpu_rdtsc() - start);
+    
+    return result;
+}
+
+// System call entry (called from assembly with the saved trap frame)
+void syscall_dispatch(trap_frame_t* frame) {
+    // Number in EAX, arguments in EBX, ECX, EDX, ESI (EDI); result goes back in EAX
+    frame->eax = (unsigned int)syscall_handler(frame->eax, frame->ebx, frame->ecx, frame->edx, frame->esi,
+                                               frame->edi);
 }
 
 // System call: exit
@@ -72,36 +138,14 @@ int sys_exit(unsigned int exit_code, unsigned int arg2, unsigned int arg3, unsig
 
 // System call: write
 int sys_write(unsigned int fd, unsigned int buf, unsigned int count, unsigned int arg4) {
-    // For now, only support stdout (fd = 1) and stderr (fd = 2)
-    if (fd != 1 && fd != 2) {
-        return -1;
-    }
-    
-    // Get current process
-    process_t* proc = process_get_current();
-    if (!proc) {
-        return -1;
-    }
-    
-    // Use VGA driver for output
-    char* src = (char*) buf;
-    unsigned char color = (fd == 2) ? VGA_COLOR(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK) : VGA_DEFAULT_COLOR;
-    
-    for (unsigned int i = 0; i < count; i++) {
-        vga_putchar_color(src[i], color);
-    }
-    
-    return count;
+    // Every descriptor goes to the VFS; 1 and 2 start out on the console
+    // files, and dup2 can point them elsewhere and back
+    return vfs_write((int)fd, (const void*)buf, count);
 }
 
 // System call: read
 int sys_read(unsigned int fd, unsigned int buf, unsigned int count, unsigned int arg4) {
-    // Validate file descriptor
-    if (fd < 0 || fd >= 256) {
-        return -1;
-    }
-    
-    // Read from file
+    // Read from file (vfs_read rejects descriptors without an open file)
     int bytes_read = vfs_read(fd, (void*)buf, count);
     return bytes_read;
 }
@@ -177,10 +221,7 @@ int sys_fork(unsigned int arg1, unsigned int arg2, unsigned int arg3, unsigned i
     }
     
     // In parent, return child PID
-    // In child, return 0 (this is handled by fork implementation)
-    // For now, we return child PID - the actual 0 vs PID distinction
-    // would be handled by the fork implementation setting the return value
-    // in the child's context
+    // The child resumes from a copy of this trap frame with EAX = 0
     return child_pid;
 }
 
@@ -275,3 +316,33 @@ int sys_unlink(unsigned int path, unsigned int arg2, unsigned int arg3, unsigned
     return vfs_unlink(path_str);
 }
 
+// System call: ring_enter
+// Submit up to to_submit queued requests from a shared ring in one trap
+int sys_ring_enter(unsigned int ring, unsigned int to_submit, unsigned int min_complete, unsigned int flags) {
+    return ring_enter(ring, to_submit, min_complete, flags);
+}
+
+// System call: dup
+int sys_dup(unsigned int fd, unsigned int arg2, unsigned int arg3, unsigned int arg4) {
+    return vfs_dup((int)fd);
+}
+
+// System call: dup2
+int sys_dup2(unsigned int fd, unsigned int newfd, unsigned int arg3, unsigned int arg4) {
+    return vfs_dup2((int)fd, (int)newfd);
+}
+
+// System call: fsync
+int sys_fsync(unsigned int fd, unsigned int arg2, unsigned int arg3, unsigned int arg4) {
+    return vfs_fsync((int)fd);
+}
+
+// System call: sync
+int sys_sync(unsigned int arg1, unsigned int arg2, unsigned int arg3, unsigned int arg4) {
+    return vfs_sync();
+}
+
+// System call: fallocate
+int sys_fallocate(unsigned int fd, unsigned int mode, unsigned int offset, unsigned int len) {
+    return vfs_fallocate((int)fd, mode, offset, len);
+}
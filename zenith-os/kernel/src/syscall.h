@@ -1,6 +1,8 @@
 #ifndef SYSCALL_H
 #define SYSCALL_H
 
+#include "idt.h"
+
 // System call numbers
 #define SYS_EXIT    1
 #define SYS_WRITE   2
@@ -30,18 +32,36 @@
 #define SYS_SIGNAL  26
 #define SYS_KILL    27
 #define SYS_UNLINK  28
+#define SYS_RING_ENTER 29
+#define SYS_DUP     30
+#define SYS_DUP2    31
+#define SYS_FSYNC   32
+#define SYS_SYNC    33
+#define SYS_FALLOCATE 34
 
 // System call function pointer type
 typedef int (*syscall_handler_t)(unsigned int arg1, unsigned int arg2, unsigned int arg3, unsigned int arg4);
 
+// Handler of a system call taking a fifth argument (int $0x80 passes it in
+// EDI; the SYSENTER path carries four arguments only)
+typedef int (*syscall_handler5_t)(unsigned int arg1, unsigned int arg2, unsigned int arg3, unsigned int arg4,
+                                  unsigned int arg5);
+
 // Initialize system call interface
 void syscall_init(void);
 
 // Register a system call handler
 void syscall_register(unsigned int syscall_num, syscall_handler_t handler);
+void syscall_register5(unsigned int syscall_num, syscall_handler5_t handler);
+
+// System call handler (dispatch by number)
+// Every system call runs through here, whether trapped or submitted through
+// a ring, so validation and the per-syscall counters are shared
+int syscall_handler(unsigned int syscall_num, unsigned int arg1, unsigned int arg2, unsigned int arg3,
+                    unsigned int arg4, unsigned int arg5);
 
-// System call handler (called from assembly)
-int syscall_handler(unsigned int syscall_num, unsigned int arg1, unsigned int arg2, unsigned int arg3, unsigned int arg4);
+// System call entry (called from assembly with the saved trap frame)
+void syscall_dispatch(trap_frame_t* frame);
 
 // System call implementations
 int sys_exit(unsigned int exit_code, unsigned int arg2, unsigned int arg3, unsigned int arg4);
@@ -71,6 +91,12 @@ int sys_shmctl(unsigned int shmid, unsigned int cmd, unsigned int buf, unsigned
 int sys_signal(unsigned int signum, unsigned int handler, unsigned int arg3, unsigned int arg4);
 int sys_kill(unsigned int pid, unsigned int signum, unsigned int arg3, unsigned int arg4);
 int sys_unlink(unsigned int path, unsigned int arg2, unsigned int arg3, unsigned int arg4);
+int sys_ring_enter(unsigned int ring, unsigned int to_submit, unsigned int min_complete, unsigned int flags);
+int sys_dup(unsigned int fd, unsigned int arg2, unsigned int arg3, unsigned int arg4);
+int sys_dup2(unsigned int fd, unsigned int newfd, unsigned int arg3, unsigned int arg4);
+int sys_fsync(unsigned int fd, unsigned int arg2, unsigned int arg3, unsigned int arg4);
+int sys_sync(unsigned int arg1, unsigned int arg2, unsigned int arg3, unsigned int arg4);
+int sys_fallocate(unsigned int fd, unsigned int mode, unsigned int offset, unsigned int len);
 
 #endif // SYSCALL_H
 
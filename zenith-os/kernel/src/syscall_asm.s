@@ -3,6 +3,10 @@
 
 .global syscall_interrupt
 syscall_interrupt:
+    # Build the same trap frame as the interrupt stubs (error code, vector)
+    push $0
+    push $0x80
+    
     # Save all registers
     pusha
     push %ds
@@ -17,41 +21,74 @@ syscall_interrupt:
     mov %ax, %fs
     mov %ax, %gs
     
-    # Get system call number and arguments from saved registers
-    # Stack after pusha+segs: [GS] [FS] [ES] [DS] [EDI] [ESI] [EBP] [ESP] [EBX] [EDX] [ECX] [EAX]
-    # Offsets from current ESP (pointing to GS):
-    # EAX = 40, ECX = 32, EDX = 28, EBX = 24, ESI = 36
-    
-    # Push arguments in reverse order (C calling convention: arg4, arg3, arg2, arg1, syscall_num)
-    # We need to adjust offsets as we push
-    mov 36(%esp), %eax    # ESI (arg4) - offset 36
-    push %eax
-    mov 28+4(%esp), %eax  # EDX (arg3) - offset 28+4=32 (account for 1 push)
-    push %eax
-    mov 32+8(%esp), %eax  # ECX (arg2) - offset 32+8=40 (account for 2 pushes)
-    push %eax
-    mov 24+12(%esp), %eax # EBX (arg1) - offset 24+12=36 (account for 3 pushes)
-    push %eax
-    mov 40+16(%esp), %eax # EAX (syscall_num) - offset 40+16=56 (account for 4 pushes)
-    push %eax
-    
-    # Call C handler
-    call syscall_handler
-    add $20, %esp         # Remove arguments
-    
-    # Return value is in EAX
-    # Save it because popa will overwrite EAX
-    mov %eax, %ecx        # Save return value in ECX
-    
-    # Restore registers
+    # Call C dispatcher with a pointer to the trap frame
+    # It reads the number/arguments from the saved registers and stores the
+    # return value into the saved EAX, so popa hands it back to the caller
+    push %esp
+    call syscall_dispatch
+    add $4, %esp
+    
+    # Restore registers and iret (shared with the interrupt stubs)
+    jmp trap_return
+
+# Fast system call entry (SYSENTER)
+# User convention (see user/libc/sys/syscall.h):
+#   EAX = number, EBX = arg1, EDI = arg2, EBP = arg3, ESI = arg4
+#   ECX = user ESP, EDX = user return EIP (SYSEXIT needs both)
+# SYSENTER loads CS/SS from the MSRs and clears IF, but does not save
+# anything, so the trap frame is built by hand in the int $0x80 layout
+.global sysenter_entry
+sysenter_entry:
+    # MSR_SYSENTER_ESP points at TSS.esp0: load the current kernel stack top
+    mov (%esp), %esp
+    
+    # Hardware part of the frame, as if ring 3 had executed int $0x80
+    push $0x23            # User SS
+    push %ecx             # User ESP
+    pushf
+    orl $0x200, (%esp)    # IF was set in user mode (SYSENTER cleared it)
+    push $0x1B            # User CS
+    push %edx             # User EIP
+    push $0
+    push $0x80
+    
+    # Move arg2/arg3 to ECX/EDX where syscall_dispatch expects them
+    mov %edi, %ecx
+    mov %ebp, %edx
+    
+    # Save all registers
+    pusha
+    push %ds
+    push %es
+    push %fs
+    push %gs
+    
+    # Load kernel data segments
+    mov $0x10, %ax
+    mov %ax, %ds
+    mov %ax, %es
+    mov %ax, %fs
+    mov %ax, %gs
+    
+    push %esp
+    call syscall_dispatch
+    add $4, %esp
+    
+    # Restore registers (EAX now holds the return value)
     pop %gs
     pop %fs
     pop %es
     pop %ds
-    popa                  # Restore all registers (EAX will be overwritten)
+    popa
     
-    # Restore return value to EAX
-    mov %ecx, %eax
+    # Remove error code and interrupt number
+    add $8, %esp
     
-    # Return from interrupt
-    iret
+    # Return through SYSEXIT using the (possibly updated, e.g. by exec) frame
+    mov (%esp), %edx      # User EIP
+    mov 12(%esp), %ecx    # User ESP
+    andl $~0x200, 8(%esp) # Keep IF clear until the STI right before SYSEXIT
+    add $8, %esp
+    popf
+    sti                   # Takes effect after SYSEXIT (interrupt shadow)
+    sysexit
@@ -0,0 +1,252 @@
+#include "systrace.h"
+#include "syscall.h"
+#include "serial.h"
+#include "string.h"
+#include "cpu.h"
+
+// Per-syscall counters
+static syscall_stat_t g_stats[SYSTRACE_MAX_SYSCALLS];
+
+// Trace ring: the dispatcher produces at tail, the drain thread consumes at head
+static systrace_record_t g_ring[SYSTRACE_RING_SIZE];
+static volatile unsigned int g_ring_head = 0;
+static volatile unsigned int g_ring_tail = 0;
+static unsigned int g_ring_dropped = 0;
+
+// Serial drain thread (created the first time tracing is enabled)
+static process_t* g_drain_thread = 0;
+
+// Printable system call names
+static const char* g_syscall_names[SYSTRACE_MAX_SYSCALLS] = {
+    [SYS_EXIT] = "exit",
+    [SYS_WRITE] = "write",
+    [SYS_READ] = "read",
+    [SYS_OPEN] = "open",
+    [SYS_CLOSE] = "close",
+    [SYS_SEEK] = "seek",
+    [SYS_FORK] = "fork",
+    [SYS_EXEC] = "exec",
+    [SYS_WAIT] = "wait",
+    [SYS_GETPID] = "getpid",
+    [SYS_MKDIR] = "mkdir",
+    [SYS_RMDIR] = "rmdir",
+    [SYS_READDIR] = "readdir",
+    [SYS_BRK] = "brk",
+    [SYS_SBRK] = "sbrk",
+    [SYS_PIPE] = "pipe",
+    [SYS_MSGGET] = "msgget",
+    [SYS_MSGSND] = "msgsnd",
+    [SYS_MSGRCV] = "msgrcv",
+    [SYS_MSGCTL] = "msgctl",
+    [SYS_SHMGET] = "shmget",
+    [SYS_SHMAT] = "shmat",
+    [SYS_SHMDT] = "shmdt",
+    [SYS_SHMCTL] = "shmctl",
+    [SYS_SIGNAL] = "signal",
+    [SYS_KILL] = "kill",
+    [SYS_UNLINK] = "unlink",
+    [SYS_RING_ENTER] = "ring_enter",
+    [SYS_DUP] = "dup",
+    [SYS_DUP2] = "dup2",
+    [SYS_FSYNC] = "fsync",
+    [SYS_SYNC] = "sync",
+    [SYS_FALLOCATE] = "fallocate",
+};
+
+// Write an unsigned decimal number to COM1
+static void serial_put_uint(unsigned int value) {
+    char buf[12];
+    int i = 0;
+    do {
+        buf[i++] = '0' + (value % 10);
+        value /= 10;
+    } while (value);
+    while (i > 0) {
+        serial_putchar(COM1_BASE, buf[--i]);
+    }
+}
+
+// Write a signed decimal number to COM1
+static void serial_put_int(int value) {
+    if (value < 0) {
+        serial_putchar(COM1_BASE, '-');
+        serial_put_uint((unsigned int)-value);
+    } else {
+        serial_put_uint((unsigned int)value);
+    }
+}
+
+// Write a hexadecimal number to COM1
+static void serial_put_hex(unsigned int value) {
+    static const char digits[] = "0123456789abcdef";
+    serial_write(COM1_BASE, "0x");
+    int shift = 28;
+    while (shift > 0 && !((value >> shift) & 0xF)) {
+        shift -= 4;
+    }
+    for (; shift >= 0; shift -= 4) {
+        serial_putchar(COM1_BASE, digits[(value >> shift) & 0xF]);
+    }
+}
+
+// Format one record as "[pid] name(a1, a2, a3, a4) = result <cycles>"
+static void systrace_print(const systrace_record_t* rec) {
+    serial_putchar(COM1_BASE, '[');
+    serial_put_uint(rec->pid);
+    serial_write(COM1_BASE, "] ");
+    serial_write(COM1_BASE, systrace_name(rec->num));
+    serial_putchar(COM1_BASE, '(');
+    for (int i = 0; i < 4; i++) {
+        if (i > 0) {
+            serial_write(COM1_BASE, ", ");
+        }
+        serial_put_hex(rec->args[i]);
+    }
+    serial_write(COM1_BASE, ") = ");
+    serial_put_int(rec->result);
+    serial_write(COM1_BASE, " <");
+    serial_put_uint(rec->cycles);
+    serial_write(COM1_BASE, ">\n");
+}
+
+// Drain thread: copy records out of the ring and write them to COM1
+// Serial output is slow, so it happens here rather than in the traced syscall
+static void systrace_drain_thread(void* arg) {
+    (void)arg;
+    
+    for (;;) {
+        unsigned int flags = cpu_irq_save();
+        while (g_ring_head == g_ring_tail) {
+            process_block();
+        }
+        systrace_record_t rec = g_ring[g_ring_head % SYSTRACE_RING_SIZE];
+        g_ring_head++;
+        unsigned int dropped = g_ring_dropped;
+        g_ring_dropped = 0;
+        cpu_irq_restore(flags);
+        
+        if (dropped) {
+            serial_write(COM1_BASE, "systrace: ");
+            serial_put_uint(dropped);
+            serial_write(COM1_BASE, " records lost\n");
+        }
+        systrace_print(&rec);
+    }
+}
+
+// Append a record for the current process to the trace ring
+static void systrace_log(process_t* proc, unsigned int num, unsigned int arg1, unsigned int arg2,
+                         unsigned int arg3, unsigned int arg4, int result, unsigned long long cycles) {
+    unsigned int flags = cpu_irq_save();
+    
+    if (g_ring_tail - g_ring_head >= SYSTRACE_RING_SIZE) {
+        // Keep the oldest records; the drain thread reports the gap
+        g_ring_dropped++;
+    } else {
+        systrace_record_t* rec = &g_ring[g_ring_tail % SYSTRACE_RING_SIZE];
+        rec->pid = proc->pid;
+        rec->num = num;
+        rec->args[0] = arg1;
+        rec->args[1] = arg2;
+        rec->args[2] = arg3;
+        rec->args[3] = arg4;
+        rec->result = result;
+        rec->cycles = cycles > 0xFFFFFFFFULL ? 0xFFFFFFFF : (unsigned int)cycles;
+        g_ring_tail++;
+    }
+    
+    if (g_drain_thread) {
+        process_unblock(g_drain_thread);
+    }
+    
+    cpu_irq_restore(flags);
+}
+
+// Account one completed system call
+void systrace_account(unsigned int num, unsigned int arg1, unsigned int arg2, unsigned int arg3,
+                      unsigned int arg4, int result, unsigned long long cycles) {
+    if (num >= SYSTRACE_MAX_SYSCALLS) {
+        return;
+    }
+    
+    syscall_stat_t* stat = &g_stats[num];
+    stat->calls++;
+    if (result < 0) {
+        stat->errors++;
+    }
+    stat->cycles += cycles;
+    if (cycles > stat->max_cycles) {
+        stat->max_cycles = cycles;
+    }
+    
+    process_t* proc = process_get_current();
+    if (proc && proc->strace) {
+        systrace_log(proc, num, arg1, arg2, arg3, arg4, result, cycles);
+    }
+}
+
+// Counters for one system call number
+const syscall_stat_t* systrace_get_stat(unsigned int num) {
+    if (num >= SYSTRACE_MAX_SYSCALLS) {
+        return 0;
+    }
+    return &g_stats[num];
+}
+
+// Average cycles per call (saturates at 0xFFFFFFFF)
+unsigned int systrace_get_avg_cycles(unsigned int num) {
+    if (num >= SYSTRACE_MAX_SYSCALLS || !g_stats[num].calls) {
+        return 0;
+    }
+    
+    unsigned long long cycles = g_stats[num].cycles;
+    unsigned int calls = g_stats[num].calls;
+    if ((unsigned int)(cycles >> 32) >= calls) {
+        return 0xFFFFFFFF; // Quotient would not fit in 32 bits
+    }
+    
+    // 64/32 division with divl (no libgcc in the kernel)
+    unsigned int quotient, remainder;
+    asm ("divl %4"
+         : "=a"(quotient), "=d"(remainder)
+         : "a"((unsigned int)cycles), "d"((unsigned int)(cycles >> 32)), "rm"(calls));
+    return quotient;
+}
+
+// Printable name of a system call number
+const char* systrace_name(unsigned int num) {
+    if (num >= SYSTRACE_MAX_SYSCALLS || !g_syscall_names[num]) {
+        return "?";
+    }
+    return g_syscall_names[num];
+}
+
+// Clear all counters
+void systrace_reset(void) {
+    unsigned int flags = cpu_irq_save();
+    memset(g_stats, 0, sizeof(g_stats));
+    cpu_irq_restore(flags);
+}
+
+// Turn strace mode on or off for a process
+int systrace_set(pid_t pid, int enable) {
+    process_t* proc = process_get_by_pid(pid);
+    if (!proc || proc->kernel_thread) {
+        return -1;
+    }
+    
+    if (enable && !g_drain_thread) {
+        g_drain_thread = kthread_create("systrace", systrace_drain_thread, 0);
+        if (!g_drain_thread) {
+            return -1;
+        }
+    }
+    
+    proc->strace = enable ? 1 : 0;
+    return 0;
+}
+
+// Trace records lost because the ring was full
+unsigned int systrace_get_dropped(void) {
+    return g_ring_dropped;
+}
@@ -0,0 +1,54 @@
+#ifndef SYSTRACE_H
+#define SYSTRACE_H
+
+#include "process.h"
+
+// Number of system call slots (matches the dispatch table)
+#define SYSTRACE_MAX_SYSCALLS 256
+
+// Trace records buffered between the dispatcher and the serial drain thread
+#define SYSTRACE_RING_SIZE 256
+
+// Per-syscall counters, updated on every dispatch
+typedef struct {
+    unsigned int calls;              // Completed calls
+    unsigned int errors;             // Calls that returned a negative value
+    unsigned long long cycles;       // Cumulative TSC cycles spent in the handler
+    unsigned long long max_cycles;   // Slowest single call
+} syscall_stat_t;
+
+// One strace record
+typedef struct {
+    pid_t pid;
+    unsigned int num;
+    unsigned int args[4];
+    int result;
+    unsigned int cycles;
+} systrace_record_t;
+
+// Account one completed system call (called by the dispatcher)
+// Logs a trace record as well if the current process is being traced
+void systrace_account(unsigned int num, unsigned int arg1, unsigned int arg2, unsigned int arg3,
+                      unsigned int arg4, int result, unsigned long long cycles);
+
+// Counters for one system call number (NULL if out of range)
+const syscall_stat_t* systrace_get_stat(unsigned int num);
+
+// Average cycles per call for one system call number (saturates at 0xFFFFFFFF)
+unsigned int systrace_get_avg_cycles(unsigned int num);
+
+// Printable name of a system call number ("?" if unknown)
+const char* systrace_name(unsigned int num);
+
+// Clear all counters
+void systrace_reset(void);
+
+// Turn strace mode on or off for a process (children inherit it on fork)
+// Records are written to COM1 by a kernel thread started on first use
+// Returns 0 on success, -1 if there is no such process
+int systrace_set(pid_t pid, int enable);
+
+// Trace records lost because the ring was full
+unsigned int systrace_get_dropped(void);
+
+#endif // SYSTRACE_H
@@ -2,6 +2,8 @@
 #include "idt.h"
 #include "pic.h"
 #include "scheduler.h"
+#include "vdso.h"
+#include "pagecache.h"
 
 // System tick counter
 static volatile unsigned long long g_ticks = 0;
@@ -22,6 +24,12 @@ static inline unsigned char inb(unsigned short port) {
 static void timer_handler(void) {
     g_ticks++;
     
+    // Advance the clock user code reads from the shared data page
+    vdso_tick();
+    
+    // Periodic write-back of dirty file data
+    pagecache_tick();
+    
     // Call scheduler tick
     extern void scheduler_tick(void);
     scheduler_tick();
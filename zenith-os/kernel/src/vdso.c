@@ -0,0 +1,134 @@
+#include "vdso.h"
+#include "pmm.h"
+#include "paging.h"
+#include "timer.h"
+#include "cpu.h"
+#include "string.h"
+
+// Data page (kernel identity mapping) and its frame
+static vdso_data_t* g_vdso = 0;
+static unsigned long long g_vdso_frame = 0;
+
+// TSC calibration state
+static int g_vdso_has_tsc = 0;
+static unsigned long long g_calib_start = 0;
+static unsigned int g_calib_ticks = 0;
+
+// 64-by-32 division (quotient must fit in 32 bits; avoids libgcc's __udivdi3)
+static inline unsigned int div64_32(unsigned long long dividend, unsigned int divisor) {
+    unsigned int quotient, remainder;
+    asm ("divl %4"
+         : "=a"(quotient), "=d"(remainder)
+         : "a"((unsigned int)dividend), "d"((unsigned int)(dividend >> 32)), "rm"(divisor));
+    return quotient;
+}
+
+// Seqlock write side (readers retry while seq is odd or changes)
+static inline void vdso_write_begin(void) {
+    g_vdso->seq++;
+    asm volatile ("" : : : "memory");
+}
+
+static inline void vdso_write_end(void) {
+    asm volatile ("" : : : "memory");
+    g_vdso->seq++;
+}
+
+// Initialize the data page
+int vdso_init(void) {
+    g_vdso_frame = pmm_alloc_page();
+    if (!g_vdso_frame) {
+        return -1;
+    }
+    
+    // Shared frame: fork maps it as-is and the kernel keeps its own reference
+    pmm_get_page(g_vdso_frame)->flags |= PG_SHARED | PG_KERNEL;
+    
+    g_vdso = (vdso_data_t*)(unsigned int)g_vdso_frame;
+    clear_page(g_vdso);
+    
+    g_vdso->version = VDSO_VERSION;
+    g_vdso->tick_hz = TIMER_FREQUENCY;
+    g_vdso->tick_ns = 1000000000 / TIMER_FREQUENCY;
+    
+    g_vdso_has_tsc = (cpu_features_edx() & CPUID_EDX_TSC) != 0;
+    g_calib_ticks = 0;
+    
+    return 0;
+}
+
+// Map the data page into an address space
+int vdso_map(page_directory_t* dir) {
+    if (!g_vdso || !dir) {
+        return -1;
+    }
+    
+    // Read-only for user code: no PAGE_WRITABLE
+    pmm_ref_page(g_vdso_frame);
+    if (paging_map_page_dir(dir, VDSO_DATA_ADDR, (unsigned int)g_vdso_frame, PAGE_PRESENT | PAGE_USER) != 0) {
+        pmm_free_page(g_vdso_frame);
+        return -1;
+    }
+    
+    return 0;
+}
+
+// Publish the running PID
+// The page is shared by all processes; on a single CPU the only reader is
+// the process that is running, so one global value is enough
+void vdso_set_pid(unsigned int pid) {
+    if (g_vdso) {
+        g_vdso->pid = pid;
+    }
+}
+
+// Advance the clock
+void vdso_tick(void) {
+    if (!g_vdso) {
+        return;
+    }
+    
+    unsigned long long tsc = g_vdso_has_tsc ? cpu_rdtsc() : 0;
+    
+    // Calibrate the TSC against the first VDSO_CALIB_TICKS timer ticks
+    unsigned int per_tick = 0;
+    unsigned int mult = 0;
+    if (g_vdso_has_tsc && !g_vdso->tsc_per_tick) {
+        if (g_calib_ticks == 0) {
+            g_calib_start = tsc;
+        } else if (g_calib_ticks == VDSO_CALIB_TICKS) {
+            per_tick = (unsigned int)((tsc - g_calib_start) / VDSO_CALIB_TICKS);
+            
+            // Multiplier must fit in 32 bits (TSC slower than ~250kHz: stay tick-only)
+            unsigned long long scaled = (unsigned long long)g_vdso->tick_ns << VDSO_TSC_SHIFT;
+            if (per_tick > (unsigned int)(scaled >> 32)) {
+                mult = div64_32(scaled, per_tick);
+            } else {
+                per_tick = 0;
+            }
+        }
+        g_calib_ticks++;
+    }
+    
+    vdso_write_begin();
+    
+    g_vdso->ticks++;
+    g_vdso->tsc_at_tick = tsc;
+    if (mult) {
+        g_vdso->tsc_per_tick = per_tick;
+        g_vdso->tsc_mult = mult;
+    }
+    
+    g_vdso->nsec += g_vdso->tick_ns;
+    if (g_vdso->nsec >= 1000000000) {
+        g_vdso->nsec -= 1000000000;
+        g_vdso->sec++;
+    }
+    
+    vdso_write_end();
+}
+
+// Kernel view of the data page
+const vdso_data_t* vdso_get_data(void) {
+    return g_vdso;
+}
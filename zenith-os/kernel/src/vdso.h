@@ -0,0 +1,57 @@
+#ifndef VDSO_H
+#define VDSO_H
+
+#include "paging.h"
+
+// Kernel data page mapped read-only into every process (vDSO-style)
+// User code reads the PID and the clock from here without a system call
+// Layout must match user/libc/sys/vdso.h
+
+// User virtual address of the data page (read-only, user-accessible)
+#define VDSO_DATA_ADDR  0xBFFFF000
+
+// Layout version (bumped whenever vdso_data_t changes)
+#define VDSO_VERSION    1
+
+// Fixed-point shift for TSC -> nanosecond conversion
+// ns = (tsc_delta * tsc_mult) >> VDSO_TSC_SHIFT
+#define VDSO_TSC_SHIFT  20
+
+// Ticks used to calibrate the TSC against the PIT (power of two)
+#define VDSO_CALIB_TICKS 16
+
+// Shared kernel data
+// Fields below seq are protected by a seqlock: the kernel makes seq odd
+// while updating, readers retry if seq was odd or changed during the read
+typedef struct {
+    unsigned int version;              // VDSO_VERSION
+    unsigned int pid;                  // PID of the running process (0 = kernel)
+    volatile unsigned int seq;         // Seqlock sequence counter
+    unsigned int tick_hz;              // Timer frequency
+    unsigned long long ticks;          // Timer ticks since boot
+    unsigned long long tsc_at_tick;    // TSC value at the last tick
+    unsigned int tsc_per_tick;         // Calibrated TSC cycles per tick (0 = not yet)
+    unsigned int tsc_mult;             // TSC -> ns multiplier (see VDSO_TSC_SHIFT)
+    unsigned int tick_ns;              // Nanoseconds per tick
+    unsigned int sec;                  // Seconds since boot at the last tick
+    unsigned int nsec;                 // Nanoseconds within that second
+} vdso_data_t;
+
+// Allocate and initialize the data page
+// Returns 0 on success, -1 on failure
+int vdso_init(void);
+
+// Map the data page read-only into an address space
+// Returns 0 on success, -1 on failure
+int vdso_map(page_directory_t* dir);
+
+// Publish the PID of the process that is about to run
+void vdso_set_pid(unsigned int pid);
+
+// Advance the clock (called from the timer interrupt)
+void vdso_tick(void);
+
+// Kernel view of the data page (NULL before vdso_init)
+const vdso_data_t* vdso_get_data(void);
+
+#endif // VDSO_H
@@ -3,6 +3,13 @@
 #include "pmm.h"
 #include "paging.h"
 #include "timer.h"
+#include "slab.h"
+#include "string.h"
+#include "dcache.h"
+#include "process.h"
+#include "pagecache.h"
+#include "cpu.h"
+#include "vga.h"
 
 // Root file system node
 static vfs_node_t* g_root = 0;
@@ -11,29 +18,250 @@ static vfs_node_t* g_root = 0;
 static mount_point_t g_mount_points[16];
 static int g_mount_count = 0;
 
-// File descriptors
-#define MAX_FDS 256
-static vfs_node_t* g_open_files[MAX_FDS];
-static unsigned int g_fd_positions[MAX_FDS];
-static int g_next_fd = 0;
+// Descriptor table for the boot context and kernel threads
+static vfs_fd_table_t g_kernel_fds;
 
 // Registered file systems
 static vfs_filesystem_t* g_filesystems[16];
 static int g_fs_count = 0;
 
+// File system lock (depth > 0 while held; the owner may be the boot context)
+static process_t* g_fs_owner = 0;
+static unsigned int g_fs_depth = 0;
+
+// Largest read-ahead window (pages)
+static unsigned int g_readahead_max = VFS_READAHEAD_MAX;
+
+// Console devices and the open files behind descriptors 0-2 of every table
+// The VFS keeps its own reference to each file, so they are never freed
+static vfs_node_t g_console_nodes[VFS_CONSOLE_FDS];
+static vfs_file_t* g_console_files[VFS_CONSOLE_FDS];
+
+// Slab caches for VFS nodes, open files and descriptor tables
+static kmem_cache_t* g_node_cache = 0;
+static kmem_cache_t* g_file_cache = 0;
+static kmem_cache_t* g_fd_table_cache = 0;
+
+// Simple string comparison (since we don't have libc)
+static int strcmp(const char* s1, const char* s2) {
+    while (*s1 && *s2 && *s1 == *s2) {
+        s1++;
+        s2++;
+    }
+    return *s1 - *s2;
+}
+
+// Simple string copy
+static void strcpy(char* dest, const char* src) {
+    while (*src) {
+        *dest++ = *src++;
+    }
+    *dest = '\0';
+}
+
+// Constructor: nodes start out zeroed
+static void vfs_node_ctor(void* obj) {
+    memset(obj, 0, sizeof(vfs_node_t));
+}
+
+// Allocate a zeroed VFS node
+vfs_node_t* vfs_alloc_node(void) {
+    return (vfs_node_t*)kmem_cache_alloc(g_node_cache);
+}
+
+// Free a VFS node
+void vfs_free_node(vfs_node_t* node) {
+    kmem_cache_free(g_node_cache, node);
+}
+
+// Reset a descriptor table: everything free except the console descriptors,
+// which share the console files
+static void fd_table_init(vfs_fd_table_t* table) {
+    memset(table, 0, sizeof(vfs_fd_table_t));
+    table->used[0] = (1u << VFS_CONSOLE_FDS) - 1;
+    for (int fd = 0; fd < VFS_CONSOLE_FDS; fd++) {
+        table->files[fd] = g_console_files[fd];
+        if (g_console_files[fd]) {
+            g_console_files[fd]->ref_count++;
+        }
+    }
+}
+
+// Console write: stdout in the default colour, stderr in red
+static int console_write(vfs_node_t* node, unsigned int offset, unsigned int size, unsigned char* buffer) {
+    (void)offset;
+    unsigned char color = node == &g_console_nodes[2] ? VGA_COLOR(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK)
+                                                      : VGA_DEFAULT_COLOR;
+    for (unsigned int i = 0; i < size; i++) {
+        vga_putchar_color((char)buffer[i], color);
+    }
+    return size;
+}
+
+// Create the console nodes and their open files
+// stdin has no read operation (console input goes through the shell)
+static void console_init(void) {
+    static const char* names[VFS_CONSOLE_FDS] = { "stdin", "stdout", "stderr" };
+    for (int fd = 0; fd < VFS_CONSOLE_FDS; fd++) {
+        vfs_node_t* node = &g_console_nodes[fd];
+        strcpy(node->name, names[fd]);
+        node->type = FS_TYPE_CHAR;
+        node->write = fd ? console_write : 0;
+        
+        if (!g_console_files[fd]) {
+            g_console_files[fd] = (vfs_file_t*)kmem_cache_alloc(g_file_cache);
+        }
+        vfs_file_t* file = g_console_files[fd];
+        if (file) {
+            memset(file, 0, sizeof(vfs_file_t));
+            file->node = node;
+            file->flags = fd ? O_WRONLY : O_RDONLY;
+            file->ref_count = 1;
+            node->open_count = 1;
+        }
+    }
+}
+
+// Descriptor table of the running context
+static vfs_fd_table_t* current_fd_table(void) {
+    process_t* proc = process_get_current();
+    if (proc && proc->fd_table) {
+        return proc->fd_table;
+    }
+    return &g_kernel_fds;
+}
+
+// Lowest free descriptor (-1 if the table is full)
+// One ctz per bitmap word, so at most VFS_MAX_FDS / 32 probes
+static int fd_alloc(vfs_fd_table_t* table) {
+    for (int word = 0; word < VFS_MAX_FDS / 32; word++) {
+        unsigned int free_bits = ~table->used[word];
+        if (free_bits) {
+            int fd = word * 32 + __builtin_ctz(free_bits);
+            table->used[word] |= 1u << (fd % 32);
+            return fd;
+        }
+    }
+    return -1;
+}
+
+// Release a descriptor slot
+static void fd_free(vfs_fd_table_t* table, int fd) {
+    table->files[fd] = 0;
+    table->used[fd / 32] &= ~(1u << (fd % 32));
+}
+
+// Check whether a descriptor slot is allocated
+static int fd_in_use(vfs_fd_table_t* table, int fd) {
+    return fd >= 0 && fd < VFS_MAX_FDS && (table->used[fd / 32] & (1u << (fd % 32)));
+}
+
+// Drop one reference to an open file, closing the node with the last one
+// Once its open count reaches zero the node may be unlinked
+static void file_release(vfs_file_t* file) {
+    if (!file || --file->ref_count > 0) {
+        return;
+    }
+    
+    vfs_lock();
+    if (file->node->close) {
+        file->node->close(file->node);
+    }
+    file->node->open_count--;
+    vfs_unlock();
+    kmem_cache_free(g_file_cache, file);
+}
+
+// Open file behind a descriptor of the current process
+vfs_file_t* vfs_get_file(file_descriptor_t fd) {
+    vfs_fd_table_t* table = current_fd_table();
+    if (fd < 0 || fd >= VFS_MAX_FDS) {
+        return 0;
+    }
+    return table->files[fd];
+}
+
+// Create an empty descriptor table
+vfs_fd_table_t* vfs_fd_table_create(void) {
+    vfs_fd_table_t* table = (vfs_fd_table_t*)kmem_cache_alloc(g_fd_table_cache);
+    if (table) {
+        fd_table_init(table);
+    }
+    return table;
+}
+
+// Copy a descriptor table for fork
+vfs_fd_table_t* vfs_fd_table_clone(vfs_fd_table_t* src) {
+    if (!src) {
+        return vfs_fd_table_create();
+    }
+    
+    vfs_fd_table_t* table = (vfs_fd_table_t*)kmem_cache_alloc(g_fd_table_cache);
+    if (!table) {
+        return 0;
+    }
+    
+    memcpy(table, src, sizeof(vfs_fd_table_t));
+    for (int fd = 0; fd < VFS_MAX_FDS; fd++) {
+        if (table->files[fd]) {
+            table->files[fd]->ref_count++;
+        }
+    }
+    return table;
+}
+
+// Close every descriptor in a table and free it
+void vfs_fd_table_destroy(vfs_fd_table_t* table) {
+    if (!table) {
+        return;
+    }
+    
+    for (int fd = 0; fd < VFS_MAX_FDS; fd++) {
+        file_release(table->files[fd]);
+    }
+    kmem_cache_free(g_fd_table_cache, table);
+}
+
+// Take the file system lock
+void vfs_lock(void) {
+    unsigned int flags = cpu_irq_save();
+    process_t* current = process_get_current();
+    while (g_fs_depth && g_fs_owner != current) {
+        process_sleep(&g_fs_depth);
+    }
+    g_fs_owner = current;
+    g_fs_depth++;
+    cpu_irq_restore(flags);
+}
+
+// Release the file system lock, waking its waiters with the last release
+void vfs_unlock(void) {
+    unsigned int flags = cpu_irq_save();
+    if (g_fs_depth && --g_fs_depth == 0) {
+        g_fs_owner = 0;
+        process_wakeup(&g_fs_depth);
+    }
+    cpu_irq_restore(flags);
+}
+
 // Initialize VFS
 void vfs_init(void) {
+    if (!g_node_cache) {
+        g_node_cache = kmem_cache_create("vfs_node", sizeof(vfs_node_t), vfs_node_ctor);
+        g_file_cache = kmem_cache_create("vfs_file", sizeof(vfs_file_t), 0);
+        g_fd_table_cache = kmem_cache_create("fd_table", sizeof(vfs_fd_table_t), 0);
+    }
+    
+    dcache_init();
+    pagecache_init();
+    console_init();
+    
     // Create root node
-    g_root = (vfs_node_t*)pmm_alloc_page();
+    g_root = vfs_alloc_node();
     if (!g_root) {
         return;
     }
     
-    // Clear root node
-    for (unsigned int i = 0; i < sizeof(vfs_node_t); i++) {
-        ((unsigned char*)g_root)[i] = 0;
-    }
-    
     g_root->name[0] = '/';
     g_root->name[1] = '\0';
     g_root->type = FS_TYPE_DIR;
@@ -51,13 +279,9 @@ void vfs_init(void) {
     // Clear mount points
     g_mount_count = 0;
     g_fs_count = 0;
-    g_next_fd = 0;
     
     // Clear file descriptors
-    for (int i = 0; i < MAX_FDS; i++) {
-        g_open_files[i] = 0;
-        g_fd_positions[i] = 0;
-    }
+    fd_table_init(&g_kernel_fds);
 }
 
 // Register a file system driver
@@ -82,17 +306,24 @@ int vfs_mount(const char* device, const char* mountpoint, const char* fstype) {
         return -1; // File system not found
     }
     
+    vfs_lock();
+    
     // Find mount point node
     vfs_node_t* mount_node = vfs_find_node(mountpoint);
     if (!mount_node || mount_node->type != FS_TYPE_DIR) {
+        vfs_unlock();
         return -1; // Invalid mount point
     }
     
     // Call file system mount function
     if (fs->mount && fs->mount(device, mountpoint) != 0) {
+        vfs_unlock();
         return -1; // Mount failed
     }
     
+    // Names under the mount point may have changed (including cached misses)
+    dcache_invalidate_node(mount_node);
+    
     // Add mount point
     if (g_mount_count < 16) {
         strcpy(g_mount_points[g_mount_count].path, mountpoint);
@@ -100,88 +331,423 @@ int vfs_mount(const char* device, const char* mountpoint, const char* fstype) {
         mp->root = mount_node;
         mp->fs = fs;
         g_mount_count++;
+        vfs_unlock();
         return 0;
     }
     
+    vfs_unlock();
     return -1; // Too many mount points
 }
 
+// Look up one name in a directory: dentry cache first, then the directory itself
+// The answer is cached either way, so a repeated miss costs no directory scan
+static vfs_node_t* vfs_lookup_child(vfs_node_t* dir, const char* name, unsigned int name_len) {
+    vfs_node_t* node = 0;
+    if (dcache_lookup(dir, name, name_len, &node)) {
+        return node;
+    }
+    
+    char buf[256];
+    memcpy(buf, name, name_len);
+    buf[name_len] = '\0';
+    
+    if (dir->finddir) {
+        node = dir->finddir(dir, buf);
+    } else {
+        for (node = dir->child; node; node = node->next) {
+            if (strcmp(node->name, buf) == 0) {
+                break;
+            }
+        }
+    }
+    
+    dcache_add(dir, name, name_len, node);
+    return node;
+}
+
+// Walk a path one component at a time from the root
+// With last_name set, stops at the directory holding the final component and
+// returns that component in last_name/last_len (length 0 for "/")
+// Returns NULL if a component is missing or is not a directory
+static vfs_node_t* vfs_walk(const char* path, const char** last_name, unsigned int* last_len) {
+    vfs_node_t* dir = g_root;
+    const char* p = path;
+    
+    for (;;) {
+        while (*p == '/') {
+            p++;
+        }
+        if (!*p) {
+            if (last_name) {
+                *last_name = p;
+                *last_len = 0;
+            }
+            return dir;
+        }
+        
+        // Split off the next component
+        const char* name = p;
+        while (*p && *p != '/') {
+            p++;
+        }
+        unsigned int len = p - name;
+        
+        if (last_name) {
+            const char* rest = p;
+            while (*rest == '/') {
+                rest++;
+            }
+            if (!*rest) {
+                *last_name = name;
+                *last_len = len;
+                return dir;
+            }
+        }
+        
+        if (dir->type != FS_TYPE_DIR || len > 255) {
+            return 0;
+        }
+        
+        if (len == 1 && name[0] == '.') {
+            continue;
+        }
+        if (len == 2 && name[0] == '.' && name[1] == '.') {
+            if (dir->parent) {
+                dir = dir->parent;
+            }
+            continue;
+        }
+        
+        dir = vfs_lookup_child(dir, name, len);
+        if (!dir) {
+            return 0;
+        }
+    }
+}
+
 // Find a node by path
 vfs_node_t* vfs_find_node(const char* path) {
     if (!path || !g_root) {
         return 0;
     }
     
-    // Handle root
-    if (path[0] == '/' && path[1] == '\0') {
-        return g_root;
+    vfs_lock();
+    vfs_node_t* node = vfs_walk(path, 0, 0);
+    vfs_unlock();
+    return node;
+}
+
+// Get file information
+int vfs_stat(const char* path, vfs_node_t* stat) {
+    vfs_node_t* node = vfs_find_node(path);
+    if (!node || !stat) {
+        return -1;
+    }
+    
+    memcpy(stat, node, sizeof(vfs_node_t));
+    return 0;
+}
+
+// Create a file or directory at path
+// The parent's file system creates it when it can (create op); otherwise a
+// directory is made in memory only
+// Returns the new node, or NULL on error (exists, bad name, no support)
+static vfs_node_t* vfs_create(const char* path, unsigned int type) {
+    // Find parent directory and the new name
+    const char* name;
+    unsigned int name_len;
+    vfs_node_t* parent = vfs_walk(path, &name, &name_len);
+    if (!parent || parent->type != FS_TYPE_DIR) {
+        return 0;
+    }
+    if (name_len == 0 || name_len > 255 ||
+        (name[0] == '.' && (name_len == 1 || (name_len == 2 && name[1] == '.')))) {
+        return 0; // Invalid name
+    }
+    
+    // Check if it already exists
+    if (vfs_lookup_child(parent, name, name_len)) {
+        return 0; // Already exists
     }
     
-    // Simple path resolution (for now)
-    // In a full implementation, we'd parse the path and traverse directories
-    // For now, just return root
-    return g_root;
+    vfs_node_t* node;
+    if (parent->create) {
+        node = parent->create(parent, name, name_len, type);
+        if (!node) {
+            return 0;
+        }
+    } else {
+        if (type != FS_TYPE_DIR) {
+            return 0; // Regular files need a file system behind them
+        }
+        
+        node = vfs_alloc_node();
+        if (!node) {
+            return 0;
+        }
+        
+        // Initialize
+        memcpy(node->name, name, name_len);
+        node->name[name_len] = '\0';
+        node->type = FS_TYPE_DIR;
+        node->size = 0;
+        
+        // Set default permissions (rwxr-xr-x)
+        node->permissions = FS_PERM_OWNER | (FS_PERM_READ | FS_PERM_EXEC) << 3 | (FS_PERM_READ | FS_PERM_EXEC) << 6;
+        node->owner = 0; // Root
+        node->group = 0; // Root group
+        
+        // Set timestamps
+        unsigned int current_time = (unsigned int)timer_get_ticks();
+        node->created_time = current_time;
+        node->modified_time = current_time;
+        node->accessed_time = current_time;
+        
+        // Inherit directory operations from parent if available
+        if (parent->readdir) {
+            node->readdir = parent->readdir;
+        }
+        if (parent->finddir) {
+            node->finddir = parent->finddir;
+        }
+    }
+    
+    node->parent = parent;
+    node->next = parent->child;
+    parent->child = node;
+    
+    // Replace the negative entry left by the existence check
+    dcache_add(parent, name, name_len, node);
+    
+    return node;
 }
 
 // Open a file
 file_descriptor_t vfs_open(const char* path, unsigned int flags) {
+    vfs_lock();
     vfs_node_t* node = vfs_find_node(path);
+    if (!node && (flags & O_CREAT) && path && g_root) {
+        node = vfs_create(path, FS_TYPE_FILE);
+    }
     if (!node) {
+        vfs_unlock();
         return -1;
     }
     
-    // Call node's open function if available
-    if (node->open && node->open(node, flags) != 0) {
-        return -1;
-    }
+    // Counted before the lock is dropped, so unlink cannot free the node meanwhile
+    node->open_count++;
+    vfs_unlock();
     
     // Allocate file descriptor
-    if (g_next_fd >= MAX_FDS) {
-        return -1; // Too many open files
+    vfs_fd_table_t* table = current_fd_table();
+    int fd = fd_alloc(table);
+    vfs_file_t* file = fd < 0 ? 0 : (vfs_file_t*)kmem_cache_alloc(g_file_cache);
+    
+    // Call node's open function if available
+    if (!file || (node->open && node->open(node, flags) != 0)) {
+        if (file) {
+            kmem_cache_free(g_file_cache, file);
+        }
+        if (fd >= 0) {
+            fd_free(table, fd);
+        }
+        vfs_lock();
+        node->open_count--;
+        vfs_unlock();
+        return -1; // Too many open files, out of memory, or refused by the file system
     }
     
-    int fd = g_next_fd++;
-    g_open_files[fd] = node;
-    g_fd_positions[fd] = 0;
+    file->node = node;
+    file->offset = 0;
+    file->flags = flags;
+    file->ref_count = 1;
+    file->ra_prev = 0;
+    file->ra_size = 0;
+    file->ra_end = 0;
+    table->files[fd] = file;
     
     return fd;
 }
 
 // Close a file
 int vfs_close(file_descriptor_t fd) {
-    if (fd < 0 || fd >= MAX_FDS || !g_open_files[fd]) {
+    vfs_fd_table_t* table = current_fd_table();
+    if (!fd_in_use(table, fd)) {
         return -1;
     }
     
-    vfs_node_t* node = g_open_files[fd];
+    // Console descriptors drop their reference like any other; the shared
+    // console file stays alive for the other tables
+    file_release(table->files[fd]);
+    fd_free(table, fd);
     
-    // Call node's close function if available
-    if (node->close) {
-        node->close(node);
+    return 0;
+}
+
+// Write a file's cached data and metadata to disk
+int vfs_fsync(file_descriptor_t fd) {
+    vfs_file_t* file = vfs_get_file(fd);
+    if (!file) {
+        return -1;
     }
     
-    g_open_files[fd] = 0;
-    g_fd_positions[fd] = 0;
+    vfs_node_t* node = file->node;
+    vfs_lock();
+    // The inode is only committed once its data is on disk
+    int result = pagecache_flush(node);
+    if (result == 0 && node->fsync && node->fsync(node) != 0) {
+        result = -1;
+    }
+    vfs_unlock();
+    return result;
+}
+
+// Write all cached data and metadata to disk
+int vfs_sync(void) {
+    vfs_lock();
+    int result = pagecache_flush(0);
+    for (int i = 0; i < g_fs_count; i++) {
+        if (g_filesystems[i]->sync && g_filesystems[i]->sync() != 0) {
+            result = -1;
+        }
+    }
+    vfs_unlock();
+    return result;
+}
+
+// Reserve disk space for part of an open file
+int vfs_fallocate(file_descriptor_t fd, unsigned int mode, unsigned int offset, unsigned int len) {
+    vfs_file_t* file = vfs_get_file(fd);
+    if (!file || len == 0 || offset + len < offset) {
+        return -1;
+    }
+    
+    vfs_node_t* node = file->node;
+    vfs_lock();
+    if (!node->fallocate || node->fallocate(node, offset, len) != 0) {
+        vfs_unlock();
+        return -1;
+    }
     
+    if (!(mode & FALLOC_FL_KEEP_SIZE) && offset + len > node->size) {
+        node->size = offset + len;
+        node->modified_time = (unsigned int)timer_get_ticks();
+        node->flags |= VFS_NODE_DIRTY;
+    }
+    vfs_unlock();
     return 0;
 }
 
+// Duplicate a descriptor onto the lowest free one
+file_descriptor_t vfs_dup(file_descriptor_t fd) {
+    vfs_fd_table_t* table = current_fd_table();
+    vfs_file_t* file = vfs_get_file(fd);
+    if (!file) {
+        return -1;
+    }
+    
+    int newfd = fd_alloc(table);
+    if (newfd < 0) {
+        return -1;
+    }
+    
+    file->ref_count++;
+    table->files[newfd] = file;
+    return newfd;
+}
+
+// Duplicate fd onto newfd
+file_descriptor_t vfs_dup2(file_descriptor_t fd, file_descriptor_t newfd) {
+    vfs_fd_table_t* table = current_fd_table();
+    vfs_file_t* file = vfs_get_file(fd);
+    if (!file || newfd < 0 || newfd >= VFS_MAX_FDS) {
+        return -1;
+    }
+    
+    if (newfd == fd) {
+        return newfd;
+    }
+    
+    // Take the new reference before dropping the old one in case both are the same file
+    file->ref_count++;
+    if (fd_in_use(table, newfd)) {
+        file_release(table->files[newfd]);
+    } else {
+        table->used[newfd / 32] |= 1u << (newfd % 32);
+    }
+    table->files[newfd] = file;
+    return newfd;
+}
+
+// Adjust the read-ahead window for a read of [offset, offset + size)
+// Reads that start in or right after the page the last read ended in are
+// sequential: the window doubles (up to the maximum) each time the reader gets
+// within half a window of the prefetched end. Anything else halves it.
+static void vfs_readahead(vfs_file_t* file, unsigned int offset, unsigned int size) {
+    vfs_node_t* node = file->node;
+    if (!node->readpage || size == 0 || offset >= node->size) {
+        return;
+    }
+    
+    unsigned int first = offset / PAGECACHE_PAGE_SIZE;
+    unsigned int last = (offset + size - 1) / PAGECACHE_PAGE_SIZE;
+    int sequential = (first == file->ra_prev || first == file->ra_prev + 1);
+    file->ra_prev = last;
+    
+    if (!sequential) {
+        file->ra_size /= 2;
+        file->ra_end = 0;
+        return;
+    }
+    
+    if (g_readahead_max == 0 || last + 1 + file->ra_size / 2 < file->ra_end) {
+        return; // Disabled, or still well inside the current window
+    }
+    
+    unsigned int window = file->ra_size ? file->ra_size * 2 : VFS_READAHEAD_INIT;
+    if (window > g_readahead_max) {
+        window = g_readahead_max;
+    }
+    
+    // The new window also covers any pages of this read not cached yet,
+    // so they arrive in the same long transfer
+    unsigned int start = file->ra_end > first ? file->ra_end : first;
+    unsigned int end = last + 1 + window;
+    pagecache_readahead(node, start, end - start);
+    
+    file->ra_size = window;
+    file->ra_end = end;
+}
+
+// Set the largest read-ahead window
+void vfs_set_readahead_max(unsigned int pages) {
+    g_readahead_max = pages;
+}
+
+// Get the largest read-ahead window
+unsigned int vfs_get_readahead_max(void) {
+    return g_readahead_max;
+}
+
 // Read from a file
 int vfs_read(file_descriptor_t fd, void* buffer, unsigned int size) {
-    if (fd < 0 || fd >= MAX_FDS || !g_open_files[fd]) {
+    vfs_file_t* file = vfs_get_file(fd);
+    if (!file) {
         return -1;
     }
     
-    vfs_node_t* node = g_open_files[fd];
-    unsigned int pos = g_fd_positions[fd];
-    
-    if (!node->read) {
+    vfs_node_t* node = file->node;
+    int bytes_read;
+    if (node->readpage) {
+        vfs_readahead(file, file->offset, size);
+        bytes_read = pagecache_read(node, file->offset, size, (unsigned char*)buffer);
+    } else if (node->read) {
+        bytes_read = node->read(node, file->offset, size, (unsigned char*)buffer);
+    } else {
         return -1; // Read not supported
     }
-    
-    int bytes_read = node->read(node, pos, size, (unsigned char*)buffer);
     if (bytes_read > 0) {
-        g_fd_positions[fd] += bytes_read;
+        file->offset += bytes_read;
     }
     
     return bytes_read;
@@ -189,20 +755,28 @@ int vfs_read(file_descriptor_t fd, void* buffer, unsigned int size) {
 
 // Write to a file
 int vfs_write(file_descriptor_t fd, const void* buffer, unsigned int size) {
-    if (fd < 0 || fd >= MAX_FDS || !g_open_files[fd]) {
+    vfs_file_t* file = vfs_get_file(fd);
+    if (!file) {
         return -1;
     }
     
-    vfs_node_t* node = g_open_files[fd];
-    unsigned int pos = g_fd_positions[fd];
-    
-    if (!node->write) {
+    vfs_node_t* node = file->node;
+    if (!node->write && !node->writepage) {
         return -1; // Write not supported
     }
     
-    int bytes_written = node->write(node, pos, size, (unsigned char*)buffer);
+    if (file->flags & O_APPEND) {
+        file->offset = node->size;
+    }
+    
+    int bytes_written;
+    if (node->writepage) {
+        bytes_written = pagecache_write(node, file->offset, size, (const unsigned char*)buffer);
+    } else {
+        bytes_written = node->write(node, file->offset, size, (unsigned char*)buffer);
+    }
     if (bytes_written > 0) {
-        g_fd_positions[fd] += bytes_written;
+        file->offset += bytes_written;
     }
     
     return bytes_written;
@@ -210,11 +784,12 @@ int vfs_write(file_descriptor_t fd, const void* buffer, unsigned int size) {
 
 // Seek in a file
 int vfs_seek(file_descriptor_t fd, int offset, int whence) {
-    if (fd < 0 || fd >= MAX_FDS || !g_open_files[fd]) {
+    vfs_file_t* file = vfs_get_file(fd);
+    if (!file) {
         return -1;
     }
     
-    vfs_node_t* node = g_open_files[fd];
+    vfs_node_t* node = file->node;
     unsigned int new_pos = 0;
     
     switch (whence) {
@@ -222,7 +797,7 @@ int vfs_seek(file_descriptor_t fd, int offset, int whence) {
             new_pos = offset;
             break;
         case 1: // SEEK_CUR
-            new_pos = g_fd_positions[fd] + offset;
+            new_pos = file->offset + offset;
             break;
         case 2: // SEEK_END
             new_pos = node->size + offset;
@@ -235,93 +810,20 @@ int vfs_seek(file_descriptor_t fd, int offset, int whence) {
         return -1; // Invalid position
     }
     
-    g_fd_positions[fd] = new_pos;
+    file->offset = new_pos;
     return new_pos;
 }
 
-// Simple string comparison (since we don't have libc)
-static int strcmp(const char* s1, const char* s2) {
-    while (*s1 && *s2 && *s1 == *s2) {
-        s1++;
-        s2++;
-    }
-    return *s1 - *s2;
-}
-
-// Simple string copy
-static void strcpy(char* dest, const char* src) {
-    while (*src) {
-        *dest++ = *src++;
-    }
-    *dest = '\0';
-}
-
-// Simple string length
-static unsigned int strlen(const char* s) {
-    unsigned int len = 0;
-    while (*s++) len++;
-    return len;
-}
-
 // Create a directory
 int vfs_mkdir(const char* path) {
     if (!path || !g_root) {
         return -1;
     }
     
-    // Find parent directory
-    vfs_node_t* parent = g_root;
-    const char* name = path;
-    
-    // Simple implementation: assume path is just a name under root
-    // In a full implementation, we'd parse the path
-    if (path[0] == '/') {
-        name = path + 1;
-    }
-    
-    // Check if directory already exists
-    if (parent->finddir && parent->finddir(parent, name)) {
-        return -1; // Already exists
-    }
-    
-    // Create new directory node
-    vfs_node_t* new_dir = (vfs_node_t*)pmm_alloc_page();
-    if (!new_dir) {
-        return -1;
-    }
-    
-    // Clear and initialize
-    for (unsigned int i = 0; i < sizeof(vfs_node_t); i++) {
-        ((unsigned char*)new_dir)[i] = 0;
-    }
-    
-    strcpy(new_dir->name, name);
-    new_dir->type = FS_TYPE_DIR;
-    new_dir->size = 0;
-    new_dir->parent = parent;
-    new_dir->next = parent->child;
-    parent->child = new_dir;
-    
-    // Set default permissions (rwxr-xr-x)
-    new_dir->permissions = FS_PERM_OWNER | (FS_PERM_READ | FS_PERM_EXEC) << 3 | (FS_PERM_READ | FS_PERM_EXEC) << 6;
-    new_dir->owner = 0; // Root
-    new_dir->group = 0; // Root group
-    
-    // Set timestamps
-    unsigned int current_time = (unsigned int)timer_get_ticks();
-    new_dir->created_time = current_time;
-    new_dir->modified_time = current_time;
-    new_dir->accessed_time = current_time;
-    
-    // Inherit directory operations from parent if available
-    if (parent->readdir) {
-        new_dir->readdir = parent->readdir;
-    }
-    if (parent->finddir) {
-        new_dir->finddir = parent->finddir;
-    }
-    
-    return 0;
+    vfs_lock();
+    vfs_node_t* node = vfs_create(path, FS_TYPE_DIR);
+    vfs_unlock();
+    return node ? 0 : -1;
 }
 
 // Remove a directory
@@ -330,15 +832,25 @@ int vfs_rmdir(const char* path) {
         return -1;
     }
     
+    vfs_lock();
+    
     // Find the directory
     vfs_node_t* dir = vfs_find_node(path);
-    if (!dir || dir->type != FS_TYPE_DIR) {
-        return -1; // Not found or not a directory
+    if (!dir || dir->type != FS_TYPE_DIR || dir == g_root) {
+        vfs_unlock();
+        return -1; // Not found, not a directory, or the root
+    }
+    
+    // Check if directory is empty and no descriptor still refers to it
+    if (dir->child || dir->open_count) {
+        vfs_unlock();
+        return -1; // Directory not empty, or open
     }
     
-    // Check if directory is empty
-    if (dir->child) {
-        return -1; // Directory not empty
+    // Let the file system drop it first (it still needs the parent link)
+    if (dir->unlink && dir->unlink(dir) != 0) {
+        vfs_unlock();
+        return -1;
     }
     
     // Remove from parent's child list
@@ -360,25 +872,31 @@ int vfs_rmdir(const char* path) {
         }
     }
     
-    // Free the node
-    pmm_free_page((unsigned long long)dir);
+    // Forget cached lookups that lead to it, then free the node
+    dcache_invalidate_node(dir);
+    vfs_free_node(dir);
     
+    vfs_unlock();
     return 0;
 }
 
 // Read directory entry
 vfs_node_t* vfs_readdir(file_descriptor_t fd, unsigned int index) {
-    if (fd < 0 || fd >= MAX_FDS || !g_open_files[fd]) {
+    vfs_file_t* file = vfs_get_file(fd);
+    if (!file) {
         return 0;
     }
     
-    vfs_node_t* node = g_open_files[fd];
+    vfs_node_t* node = file->node;
     if (node->type != FS_TYPE_DIR) {
         return 0; // Not a directory
     }
     
     if (node->readdir) {
-        return node->readdir(node, index);
+        vfs_lock();
+        vfs_node_t* entry = node->readdir(node, index);
+        vfs_unlock();
+        return entry;
     }
     
     // Fallback: traverse child list
@@ -398,12 +916,31 @@ int vfs_unlink(const char* path) {
         return -1;
     }
     
+    vfs_lock();
+    
     // Find the file
     vfs_node_t* node = vfs_find_node(path);
     if (!node || node->type != FS_TYPE_FILE) {
+        vfs_unlock();
         return -1; // Not found or not a file
     }
     
+    // Open descriptors (in any process) still point at the node
+    if (node->open_count) {
+        vfs_unlock();
+        return -1;
+    }
+    
+    // Drop cached data first: dirty pages must not be written back to blocks
+    // the file system is about to free
+    pagecache_invalidate_node(node);
+    
+    // Call file system specific unlink if available (it still needs the parent link)
+    if (node->unlink && node->unlink(node) != 0) {
+        vfs_unlock();
+        return -1;
+    }
+    
     // Remove from parent's child list
     if (node->parent) {
         vfs_node_t* current = node->parent->child;
@@ -423,14 +960,11 @@ int vfs_unlink(const char* path) {
         }
     }
     
-    // Call file system specific unlink if available
-    if (node->unlink) {
-        node->unlink(node);
-    }
-    
-    // Free the node
-    pmm_free_page((unsigned long long)node);
+    // Forget cached lookups, then free the node
+    dcache_invalidate_node(node);
+    vfs_free_node(node);
     
+    vfs_unlock();
     return 0;
 }
 
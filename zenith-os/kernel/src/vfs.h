@@ -12,12 +12,18 @@ typedef int file_descriptor_t;
 #define O_TRUNC     0x0010
 #define O_APPEND    0x0020
 
+// fallocate modes
+#define FALLOC_FL_KEEP_SIZE 0x1  // Reserve space without growing the file
+
 // File types
 #define FS_TYPE_FILE    1
 #define FS_TYPE_DIR     2
 #define FS_TYPE_CHAR    3
 #define FS_TYPE_BLOCK   4
 
+// Node flags
+#define VFS_NODE_DIRTY  0x1     // In-memory inode (size, times) newer than on disk
+
 // File permissions
 #define FS_PERM_READ    0x04
 #define FS_PERM_WRITE   0x02
@@ -39,6 +45,7 @@ typedef struct vfs_node {
     unsigned int created_time;    // Creation timestamp
     unsigned int modified_time;   // Modification timestamp
     unsigned int accessed_time;   // Access timestamp
+    unsigned int open_count;      // Open files (vfs_file_t) referring to this node
     
     // File operations
     int (*read)(struct vfs_node* node, unsigned int offset, unsigned int size, unsigned char* buffer);
@@ -47,10 +54,41 @@ typedef struct vfs_node {
     int (*close)(struct vfs_node* node);
     int (*unlink)(struct vfs_node* node);  // Delete file
     
+    // Fill one 4 KB page (index = offset / 4096) for the page cache
+    // Bytes past the end of the file read as zero; returns 0 or -1
+    // Files without it bypass the page cache
+    int (*readpage)(struct vfs_node* node, unsigned int index, unsigned char* page);
+    
+    // Fill count consecutive pages starting at index (optional, used by read-ahead)
+    // Lets the file system merge adjacent blocks into long transfers
+    int (*readpages)(struct vfs_node* node, unsigned int index, unsigned int count, unsigned char** pages);
+    
+    // Write-back support (files with writepage are written through the page cache)
+    // bmap: disk block backing the start of page index, reserving blocks for the
+    //       part of the page inside node->size; 0 if they cannot be allocated
+    // writepage: write one page (the part inside node->size) to its blocks
+    // writepages: write count consecutive pages (optional, merges adjacent blocks)
+    // write_inode: hand the inode to the file system without forcing it out
+    //              (optional; a journaling file system commits it later)
+    // fsync: write the inode and any allocation state it depends on
+    unsigned int (*bmap)(struct vfs_node* node, unsigned int index);
+    int (*writepage)(struct vfs_node* node, unsigned int index, unsigned char* page);
+    int (*writepages)(struct vfs_node* node, unsigned int index, unsigned int count, unsigned char** pages);
+    int (*write_inode)(struct vfs_node* node);
+    int (*fsync)(struct vfs_node* node);
+    
+    // Reserve disk space for bytes [offset, offset + len) without writing data
+    // (optional); the size is left alone, returns 0 or -1
+    int (*fallocate)(struct vfs_node* node, unsigned int offset, unsigned int len);
+    
     // Directory operations
     struct vfs_node* (*readdir)(struct vfs_node* node, unsigned int index);
     struct vfs_node* (*finddir)(struct vfs_node* node, const char* name);
     
+    // Create a file or directory (type FS_TYPE_*) in a directory (optional)
+    // Returns the new node, not yet linked into the tree, or NULL on error
+    struct vfs_node* (*create)(struct vfs_node* dir, const char* name, unsigned int name_len, unsigned int type);
+    
     // File system specific data
     void* fs_data;               // File system private data
     
@@ -60,6 +98,35 @@ typedef struct vfs_node {
     struct vfs_node* child;      // First child (for directories)
 } vfs_node_t;
 
+// Descriptors per process; 0-2 start out on the shared console files
+#define VFS_MAX_FDS       64
+#define VFS_CONSOLE_FDS   3
+
+// Open file description
+// Shared by every descriptor that refers to it (dup, dup2, fork), so they
+// also share the file offset
+typedef struct vfs_file {
+    vfs_node_t* node;            // Open node
+    unsigned int offset;         // Current file position
+    unsigned int flags;          // O_* flags from open
+    unsigned int ref_count;      // Descriptors referring to this file
+    
+    // Read-ahead state (pages)
+    unsigned int ra_prev;        // Last page the previous read touched
+    unsigned int ra_size;        // Current window, 0 until a sequential run starts
+    unsigned int ra_end;         // First page past the prefetched window
+} vfs_file_t;
+
+// Read-ahead window limits (pages)
+#define VFS_READAHEAD_INIT    4
+#define VFS_READAHEAD_MAX     32
+
+// Per-process file descriptor table
+typedef struct vfs_fd_table {
+    vfs_file_t* files[VFS_MAX_FDS];      // Open file per descriptor
+    unsigned int used[VFS_MAX_FDS / 32]; // Allocated descriptors (bit per fd)
+} vfs_fd_table_t;
+
 // Mount point
 typedef struct {
     char path[256];              // Mount path
@@ -73,6 +140,7 @@ typedef struct vfs_filesystem {
     int (*mount)(const char* device, const char* mountpoint);
     int (*unmount)(const char* mountpoint);
     vfs_node_t* (*open)(const char* path);
+    int (*sync)(void);           // Write back file system wide metadata
 } vfs_filesystem_t;
 
 // Initialize VFS
@@ -99,6 +167,48 @@ int vfs_write(file_descriptor_t fd, const void* buffer, unsigned int size);
 // Seek in a file
 int vfs_seek(file_descriptor_t fd, int offset, int whence);
 
+// Write a file's cached data and metadata to disk
+// Returns 0 on success, -1 on error
+int vfs_fsync(file_descriptor_t fd);
+
+// Write all cached data and metadata to disk
+// Returns 0 on success, -1 on error
+int vfs_sync(void);
+
+// Reserve disk space for bytes [offset, offset + len) of an open file
+// The file grows to cover the range unless mode has FALLOC_FL_KEEP_SIZE;
+// reserved space reads as zero until written
+// Returns 0 on success, -1 on error (no support, out of space)
+int vfs_fallocate(file_descriptor_t fd, unsigned int mode, unsigned int offset, unsigned int len);
+
+// Duplicate a descriptor onto the lowest free one
+// Returns the new descriptor, or -1 on error
+file_descriptor_t vfs_dup(file_descriptor_t fd);
+
+// Duplicate fd onto newfd, closing whatever newfd referred to
+// Returns newfd, or -1 on error
+file_descriptor_t vfs_dup2(file_descriptor_t fd, file_descriptor_t newfd);
+
+// Get the open file behind a descriptor of the current process (NULL if none)
+vfs_file_t* vfs_get_file(file_descriptor_t fd);
+
+// Create an empty descriptor table (console descriptors open)
+// Returns NULL if out of memory
+vfs_fd_table_t* vfs_fd_table_create(void);
+
+// Copy a descriptor table for fork; both tables share the open files
+// Returns NULL if out of memory
+vfs_fd_table_t* vfs_fd_table_clone(vfs_fd_table_t* src);
+
+// Close every descriptor in a table and free it
+void vfs_fd_table_destroy(vfs_fd_table_t* table);
+
+// Set the largest read-ahead window in pages (0 disables read-ahead)
+void vfs_set_readahead_max(unsigned int pages);
+
+// Get the largest read-ahead window in pages
+unsigned int vfs_get_readahead_max(void);
+
 // Get file information
 int vfs_stat(const char* path, vfs_node_t* stat);
 
@@ -108,6 +218,12 @@ void vfs_register_filesystem(vfs_filesystem_t* fs);
 // Find a node by path
 vfs_node_t* vfs_find_node(const char* path);
 
+// Allocate a zeroed node from the VFS node cache (NULL if out of memory)
+vfs_node_t* vfs_alloc_node(void);
+
+// Return a node to the VFS node cache
+void vfs_free_node(vfs_node_t* node);
+
 // Directory operations
 int vfs_mkdir(const char* path);
 int vfs_rmdir(const char* path);
@@ -116,5 +232,11 @@ vfs_node_t* vfs_readdir(file_descriptor_t fd, unsigned int index);
 // File operations
 int vfs_unlink(const char* path);  // Delete a file
 
+// File system lock: serializes everything that reaches a file system driver
+// (lookups, metadata updates, page cache fills and write-back) so disk I/O can
+// run with interrupts enabled. Recursive; other callers sleep until it is free
+void vfs_lock(void);
+void vfs_unlock(void);
+
 #endif // VFS_H
 
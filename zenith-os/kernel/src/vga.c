@@ -1,4 +1,5 @@
 #include "vga.h"
+#include "string.h"
 
 // VGA ports
 #define VGA_CRTC_INDEX 0x3D4
@@ -77,16 +78,13 @@ void vga_scroll(void) {
     char* video = (char*)VGA_MEMORY;
     
     // Move all lines up by one
-    for (int i = 0; i < (VGA_HEIGHT - 1) * VGA_WIDTH; i++) {
-        video[i * 2] = video[(i + VGA_WIDTH) * 2];
-        video[i * 2 + 1] = video[(i + VGA_WIDTH) * 2 + 1];
-    }
+    memmove(video, video + VGA_WIDTH * 2, (VGA_HEIGHT - 1) * VGA_WIDTH * 2);
     
-    // Clear last line
-    int last_line_start = (VGA_HEIGHT - 1) * VGA_WIDTH;
+    // Clear last line (one 16-bit character cell at a time)
+    unsigned short* last_line = (unsigned short*)video + (VGA_HEIGHT - 1) * VGA_WIDTH;
+    unsigned short blank = (unsigned short)(' ' | (g_text_color << 8));
     for (int i = 0; i < VGA_WIDTH; i++) {
-        video[(last_line_start + i) * 2] = ' ';
-        video[(last_line_start + i) * 2 + 1] = g_text_color;
+        last_line[i] = blank;
     }
     
     // Move cursor up if it was on the last line
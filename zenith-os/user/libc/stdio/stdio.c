@@ -23,6 +23,26 @@ int seek(int fd, int offset, int whence) {
     return syscall(SYS_SEEK, fd, offset, whence, 0);
 }
 
+int dup(int fd) {
+    return syscall(SYS_DUP, fd, 0, 0, 0);
+}
+
+int dup2(int fd, int newfd) {
+    return syscall(SYS_DUP2, fd, newfd, 0, 0);
+}
+
+int fsync(int fd) {
+    return syscall(SYS_FSYNC, fd, 0, 0, 0);
+}
+
+void sync(void) {
+    syscall(SYS_SYNC, 0, 0, 0, 0);
+}
+
+int fallocate(int fd, int mode, unsigned int offset, unsigned int len) {
+    return syscall(SYS_FALLOCATE, fd, mode, offset, len);
+}
+
 // Character I/O
 int putchar(int c) {
     char ch = (char)c;
@@ -16,12 +16,20 @@
 #define O_TRUNC     0x0010
 #define O_APPEND    0x0020
 
+// fallocate modes (must match kernel/src/vfs.h)
+#define FALLOC_FL_KEEP_SIZE 0x1
+
 // File operations
 int open(const char* path, int flags);
 int close(int fd);
 int read(int fd, void* buf, size_t count);
 int write(int fd, const void* buf, size_t count);
 int seek(int fd, int offset, int whence);
+int dup(int fd);
+int dup2(int fd, int newfd);
+int fsync(int fd);
+void sync(void);
+int fallocate(int fd, int mode, unsigned int offset, unsigned int len);
 
 // Formatted output
 int printf(const char* format, ...);
@@ -1,5 +1,6 @@
 #include "stdlib.h"
 #include "../sys/syscall.h"
+#include "../sys/vdso.h"
 
 // Simple heap management using sbrk
 // This is a very basic implementation - a real malloc would use a more sophisticated algorithm
@@ -294,3 +295,8 @@ void exit(int status) {
     while (1) {}
 }
 
+// Get process ID
+// The kernel keeps the running PID in the shared data page
+int getpid(void) {
+    return (int)vdso_data()->pid;
+}
@@ -19,6 +19,9 @@ char* ltoa(long value, char* str, int base);
 int abs(int x);
 void exit(int status);
 
+// Process ID of the caller (no system call: reads the kernel data page)
+int getpid(void);
+
 // Constants
 #define NULL ((void*)0)
 
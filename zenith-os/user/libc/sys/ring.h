@@ -0,0 +1,120 @@
+#ifndef RING_H
+#define RING_H
+
+#include "syscall.h"
+
+// Batched system call ring (io_uring-style)
+// Queue requests with ring_get_sqe(), submit them all with one ring_submit()
+// and reap the results with ring_peek_cqe()/ring_cqe_seen().
+// Layout must match kernel/src/ring.h
+
+#define RING_SQ_ENTRIES 64
+#define RING_CQ_ENTRIES 128
+
+// Request opcodes
+#define RING_OP_NOP     0
+#define RING_OP_READ    1   // fd, addr = buffer, len = count
+#define RING_OP_WRITE   2   // fd, addr = buffer, len = count
+#define RING_OP_OPEN    3   // addr = path, len = open flags
+#define RING_OP_CLOSE   4   // fd
+#define RING_OP_SEEK    5   // fd, addr = offset, len = whence
+#define RING_OP_PIPE    6   // addr = int[2] for the new descriptors
+#define RING_OP_MSGSND  7   // fd = msqid, addr = message, len = size, op_flags = flags
+#define RING_OP_MSGRCV  8   // fd = msqid, addr = buffer, len = size, arg = type, op_flags = flags
+
+// Submission queue entry
+typedef struct {
+    unsigned char opcode;          // RING_OP_*
+    unsigned char flags;           // Reserved (0)
+    unsigned short reserved;
+    int fd;                        // File descriptor / queue ID
+    unsigned int addr;             // Buffer, path or array address
+    unsigned int len;              // Byte count or open flags
+    unsigned int arg;              // Extra argument (message type)
+    unsigned int op_flags;         // Per-operation flags
+    unsigned int user_data;        // Copied unchanged into the completion
+    unsigned int pad;
+} ring_sqe_t;
+
+// Completion queue entry
+typedef struct {
+    unsigned int user_data;        // From the submission
+    int result;                    // Same value the equivalent syscall returns
+} ring_cqe_t;
+
+// Shared ring
+// SQ: user fills sqes[sq_tail & mask] and advances sq_tail; kernel advances sq_head
+// CQ: kernel fills cqes[cq_tail & mask] and advances cq_tail; user advances cq_head
+typedef struct {
+    volatile unsigned int sq_head;
+    volatile unsigned int sq_tail;
+    volatile unsigned int cq_head;
+    volatile unsigned int cq_tail;
+    unsigned int sq_entries;       // Must be RING_SQ_ENTRIES
+    unsigned int cq_entries;       // Must be RING_CQ_ENTRIES
+    unsigned int sq_dropped;       // Invalid entries skipped by the kernel
+    unsigned int cq_stalls;        // Times submission stopped because the CQ was full
+    ring_sqe_t sqes[RING_SQ_ENTRIES];
+    ring_cqe_t cqes[RING_CQ_ENTRIES];
+} ring_t;
+
+// Prepare an empty ring
+static inline void ring_init(ring_t* ring) {
+    ring->sq_head = 0;
+    ring->sq_tail = 0;
+    ring->cq_head = 0;
+    ring->cq_tail = 0;
+    ring->sq_entries = RING_SQ_ENTRIES;
+    ring->cq_entries = RING_CQ_ENTRIES;
+    ring->sq_dropped = 0;
+    ring->cq_stalls = 0;
+}
+
+// Get the next free submission entry (zeroed), or NULL if the SQ is full
+static inline ring_sqe_t* ring_get_sqe(ring_t* ring) {
+    if (ring->sq_tail - ring->sq_head >= RING_SQ_ENTRIES) {
+        return 0;
+    }
+    
+    ring_sqe_t* sqe = &ring->sqes[ring->sq_tail & (RING_SQ_ENTRIES - 1)];
+    unsigned int* words = (unsigned int*)sqe;
+    for (unsigned int i = 0; i < sizeof(ring_sqe_t) / sizeof(unsigned int); i++) {
+        words[i] = 0;
+    }
+    
+    ring->sq_tail++;
+    return sqe;
+}
+
+// Fill in a request
+static inline void ring_prep(ring_sqe_t* sqe, unsigned char opcode, int fd, const void* addr,
+                             unsigned int len, unsigned int user_data) {
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (unsigned int)addr;
+    sqe->len = len;
+    sqe->user_data = user_data;
+}
+
+// Submit every queued request in one system call
+// Requests complete synchronously: their completions are in the CQ on return
+// Returns the number of requests the kernel consumed, or -1 on error
+static inline int ring_submit(ring_t* ring) {
+    unsigned int pending = ring->sq_tail - ring->sq_head;
+    return syscall(SYS_RING_ENTER, (unsigned int)ring, pending, 0, 0);
+}
+
+// Next completion, or NULL if none is ready
+static inline ring_cqe_t* ring_peek_cqe(ring_t* ring) {
+    if (ring->cq_head == ring->cq_tail) {
+        return 0;
+    }
+    return &ring->cqes[ring->cq_head & (RING_CQ_ENTRIES - 1)];
+}
+
+// Mark the completion returned by ring_peek_cqe() as consumed
+static inline void ring_cqe_seen(ring_t* ring) {
+    ring->cq_head++;
+}
+
+#endif // RING_H
@@ -0,0 +1,35 @@
+#include "syscall.h"
+
+// CPUID.1:EDX feature bits
+#define CPUID_EDX_MSR (1 << 5)
+#define CPUID_EDX_SEP (1 << 11)
+
+// 1 if SYSENTER is usable, 0 if not, -1 until probed
+static int g_syscall_sysenter = -1;
+
+// Probe CPUID once for SYSENTER support
+// Mirrors the kernel's sysenter_init, which programs the SYSENTER MSRs only
+// when CPUID reports both SEP and MSR
+int syscall_use_sysenter(void) {
+    if (g_syscall_sysenter >= 0) {
+        return g_syscall_sysenter;
+    }
+    
+    unsigned int eax, ebx, ecx, edx;
+    asm volatile ("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1), "c"(0));
+    g_syscall_sysenter = 0;
+    if (!(edx & CPUID_EDX_SEP) || !(edx & CPUID_EDX_MSR)) {
+        return 0;
+    }
+    
+    // Early Pentium Pro parts report SEP without implementing it
+    unsigned int family = (eax >> 8) & 0xF;
+    unsigned int model = (eax >> 4) & 0xF;
+    unsigned int stepping = eax & 0xF;
+    if (family == 6 && model < 3 && stepping < 3) {
+        return 0;
+    }
+    
+    g_syscall_sysenter = 1;
+    return 1;
+}
@@ -29,10 +29,16 @@
 #define SYS_SIGNAL  26
 #define SYS_KILL    27
 #define SYS_UNLINK  28
+#define SYS_RING_ENTER 29
+#define SYS_DUP     30
+#define SYS_DUP2    31
+#define SYS_FSYNC   32
+#define SYS_SYNC    33
+#define SYS_FALLOCATE 34
 
-// System call wrapper macro
+// Legacy system call path (always available)
 // EAX = syscall number, EBX = arg1, ECX = arg2, EDX = arg3, ESI = arg4
-static inline int syscall(int num, unsigned int arg1, unsigned int arg2, unsigned int arg3, unsigned int arg4) {
+static inline int syscall_int80(int num, unsigned int arg1, unsigned int arg2, unsigned int arg3, unsigned int arg4) {
     int result;
     asm volatile (
         "int $0x80"
@@ -43,5 +49,38 @@ static inline int syscall(int num, unsigned int arg1, unsigned int arg2, unsigne
     return result;
 }
 
-#endif // SYSCALL_H
+// Fast system call path (SYSENTER/SYSEXIT)
+// SYSEXIT returns with ECX = user ESP and EDX = return EIP, so arg2/arg3
+// travel in EDI/EBP instead: EAX = number, EBX = arg1, EDI = arg2,
+// EBP = arg3, ESI = arg4 (EBP is saved around the call on the user stack)
+static inline int syscall_sysenter(int num, unsigned int arg1, unsigned int arg2, unsigned int arg3, unsigned int arg4) {
+    int result;
+    asm volatile (
+        "push %%ebp\n\t"
+        "mov %%ecx, %%edi\n\t"
+        "mov %%edx, %%ebp\n\t"
+        "mov %%esp, %%ecx\n\t"
+        "lea 1f, %%edx\n\t"
+        "sysenter\n"
+        "1:\n\t"
+        "pop %%ebp"
+        : "=a" (result), "+c" (arg2), "+d" (arg3)
+        : "a" (num), "b" (arg1), "S" (arg4)
+        : "edi", "memory"
+    );
+    return result;
+}
+
+// 1 if SYSENTER can be used, 0 if not (probed once per program)
+int syscall_use_sysenter(void);
+
+// System call wrapper
+// Uses SYSENTER when the CPU supports it, int $0x80 otherwise
+static inline int syscall(int num, unsigned int arg1, unsigned int arg2, unsigned int arg3, unsigned int arg4) {
+    if (syscall_use_sysenter()) {
+        return syscall_sysenter(num, arg1, arg2, arg3, arg4);
+    }
+    return syscall_int80(num, arg1, arg2, arg3, arg4);
+}
 
+#endif // SYSCALL_H
@@ -0,0 +1,30 @@
+#ifndef VDSO_H
+#define VDSO_H
+
+// Kernel data page, mapped read-only into every process
+// Layout must match kernel/src/vdso.h
+
+#define VDSO_DATA_ADDR  0xBFFFF000
+#define VDSO_VERSION    1
+#define VDSO_TSC_SHIFT  20
+
+typedef struct {
+    unsigned int version;              // VDSO_VERSION
+    unsigned int pid;                  // PID of the running process
+    volatile unsigned int seq;         // Seqlock sequence counter (odd = update in progress)
+    unsigned int tick_hz;              // Timer frequency
+    unsigned long long ticks;          // Timer ticks since boot
+    unsigned long long tsc_at_tick;    // TSC value at the last tick
+    unsigned int tsc_per_tick;         // Calibrated TSC cycles per tick (0 = not yet)
+    unsigned int tsc_mult;             // TSC -> ns multiplier (see VDSO_TSC_SHIFT)
+    unsigned int tick_ns;              // Nanoseconds per tick
+    unsigned int sec;                  // Seconds since boot at the last tick
+    unsigned int nsec;                 // Nanoseconds within that second
+} vdso_data_t;
+
+// Pointer to the shared data page
+static inline const volatile vdso_data_t* vdso_data(void) {
+    return (const volatile vdso_data_t*)VDSO_DATA_ADDR;
+}
+
+#endif // VDSO_H
@@ -0,0 +1,74 @@
+#include "time.h"
+#include "../sys/vdso.h"
+
+// Read the time-stamp counter
+static inline unsigned long long rdtsc(void) {
+    unsigned int lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+// Read a clock
+// Seqlock read side: retry if the timer tick updated the page meanwhile
+int clock_gettime(clockid_t clock_id, struct timespec* ts) {
+    if (!ts || (clock_id != CLOCK_REALTIME && clock_id != CLOCK_MONOTONIC)) {
+        return -1;
+    }
+    
+    const volatile vdso_data_t* data = vdso_data();
+    unsigned int seq, sec, nsec, offset;
+    
+    do {
+        seq = data->seq;
+        asm volatile ("" : : : "memory");
+        
+        sec = data->sec;
+        nsec = data->nsec;
+        offset = 0;
+        
+        // Interpolate between ticks with the calibrated TSC
+        if (data->tsc_per_tick) {
+            unsigned long long delta = rdtsc() - data->tsc_at_tick;
+            
+            // Never run past the next tick, so the clock stays monotonic
+            if (delta > data->tsc_per_tick) {
+                delta = data->tsc_per_tick;
+            }
+            offset = (unsigned int)(((unsigned long long)(unsigned int)delta * data->tsc_mult) >> VDSO_TSC_SHIFT);
+        }
+        
+        asm volatile ("" : : : "memory");
+    } while ((seq & 1) || seq != data->seq);
+    
+    nsec += offset;
+    if (nsec >= 1000000000) {
+        nsec -= 1000000000;
+        sec++;
+    }
+    
+    ts->tv_sec = sec;
+    ts->tv_nsec = nsec;
+    return 0;
+}
+
+// Seconds since boot
+unsigned int uptime(void) {
+    return vdso_data()->sec;
+}
+
+// Timer ticks since boot
+unsigned long long uptime_ticks(void) {
+    const volatile vdso_data_t* data = vdso_data();
+    unsigned int seq;
+    unsigned long long ticks;
+    
+    // 64-bit value: read under the seqlock so both halves match
+    do {
+        seq = data->seq;
+        asm volatile ("" : : : "memory");
+        ticks = data->ticks;
+        asm volatile ("" : : : "memory");
+    } while ((seq & 1) || seq != data->seq);
+    
+    return ticks;
+}
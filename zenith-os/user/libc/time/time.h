@@ -0,0 +1,26 @@
+#ifndef TIME_H
+#define TIME_H
+
+// Clock IDs
+// There is no RTC driver yet, so both clocks count from boot
+#define CLOCK_REALTIME  0
+#define CLOCK_MONOTONIC 1
+
+typedef int clockid_t;
+
+typedef struct timespec {
+    unsigned int tv_sec;    // Seconds
+    unsigned int tv_nsec;   // Nanoseconds (0-999999999)
+} timespec_t;
+
+// Read a clock (no system call: reads the kernel data page)
+// Returns 0 on success, -1 for an unknown clock
+int clock_gettime(clockid_t clock_id, struct timespec* ts);
+
+// Seconds since boot (no system call)
+unsigned int uptime(void);
+
+// Timer ticks since boot (no system call)
+unsigned long long uptime_ticks(void);
+
+#endif // TIME_H
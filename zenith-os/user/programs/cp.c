@@ -1,11 +1,16 @@
 #include "../libc/stdio/stdio.h"
 #include "../libc/stdlib/stdlib.h"
 #include "../libc/string/string.h"
+#include "../libc/sys/ring.h"
 
 // Copy file program
 // Usage: cp <source> <destination>
 
 #define BUFFER_SIZE 512
+#define BATCH_BUFFERS 8
+
+static ring_t g_ring;
+static char g_buffers[BATCH_BUFFERS][BUFFER_SIZE];
 
 int main(int argc, char* argv[]) {
     if (argc != 3) {
@@ -32,23 +37,64 @@ int main(int argc, char* argv[]) {
     }
     
     // Copy data
-    char buffer[BUFFER_SIZE];
-    int bytes_read;
+    // Reads are queued BATCH_BUFFERS at a time on the syscall ring and
+    // submitted with one SYS_RING_ENTER, then the matching writes likewise,
+    // so a large copy costs two kernel entries per BATCH_BUFFERS blocks
     int total_copied = 0;
+    int done = 0;
+    int failed = 0;
+    
+    ring_init(&g_ring);
     
-    while ((bytes_read = read(src_fd, buffer, BUFFER_SIZE)) > 0) {
-        int bytes_written = write(dst_fd, buffer, bytes_read);
-        if (bytes_written < 0) {
-            printf("Error: Write failed\n");
-            close(src_fd);
-            close(dst_fd);
-            return 1;
+    while (!done && !failed) {
+        for (int i = 0; i < BATCH_BUFFERS; i++) {
+            ring_sqe_t* sqe = ring_get_sqe(&g_ring);
+            ring_prep(sqe, RING_OP_READ, src_fd, g_buffers[i], BUFFER_SIZE, i);
+        }
+        ring_submit(&g_ring);
+        
+        // Completions arrive in submission order; a short read means EOF
+        int lengths[BATCH_BUFFERS];
+        int filled = 0;
+        ring_cqe_t* cqe;
+        while ((cqe = ring_peek_cqe(&g_ring)) != 0) {
+            if (cqe->result < 0) {
+                printf("Error: Read failed\n");
+                failed = 1;
+            } else if (!done && !failed) {
+                lengths[cqe->user_data] = cqe->result;
+                if (cqe->result > 0) {
+                    filled = cqe->user_data + 1;
+                }
+                if (cqe->result < BUFFER_SIZE) {
+                    done = 1;
+                }
+            }
+            ring_cqe_seen(&g_ring);
+        }
+        
+        if (failed || filled == 0) {
+            break;
+        }
+        
+        for (int i = 0; i < filled; i++) {
+            ring_sqe_t* sqe = ring_get_sqe(&g_ring);
+            ring_prep(sqe, RING_OP_WRITE, dst_fd, g_buffers[i], lengths[i], i);
+        }
+        ring_submit(&g_ring);
+        
+        while ((cqe = ring_peek_cqe(&g_ring)) != 0) {
+            if (cqe->result < 0) {
+                printf("Error: Write failed\n");
+                failed = 1;
+            } else {
+                total_copied += cqe->result;
+            }
+            ring_cqe_seen(&g_ring);
         }
-        total_copied += bytes_written;
     }
     
-    if (bytes_read < 0) {
-        printf("Error: Read failed\n");
+    if (failed) {
         close(src_fd);
         close(dst_fd);
         return 1;
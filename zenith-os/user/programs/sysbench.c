@@ -0,0 +1,65 @@
+#include "../libc/stdio/stdio.h"
+#include "../libc/stdlib/stdlib.h"
+#include "../libc/sys/syscall.h"
+
+// System call latency benchmark
+// Times a null system call (getpid) through int $0x80 and SYSENTER,
+// and the trap-free getpid() that reads the kernel data page
+
+#define ITERATIONS 10000
+
+// Read the time-stamp counter
+static inline unsigned long long rdtsc(void) {
+    unsigned int lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+// Average cycles per call (scaled down so only 32-bit division is needed)
+static unsigned int per_call(unsigned long long cycles, unsigned int calls) {
+    while (cycles >> 32) {
+        cycles >>= 1;
+        calls >>= 1;
+    }
+    return calls ? (unsigned int)cycles / calls : 0;
+}
+
+int main(int argc, char* argv[]) {
+    printf("Null system call (getpid) latency, %d calls\n", ITERATIONS);
+    
+    // Warm up caches and TLB
+    syscall_int80(SYS_GETPID, 0, 0, 0, 0);
+    
+    unsigned long long t0 = rdtsc();
+    for (int i = 0; i < ITERATIONS; i++) {
+        syscall_int80(SYS_GETPID, 0, 0, 0, 0);
+    }
+    unsigned int int80 = per_call(rdtsc() - t0, ITERATIONS);
+    printf("  int $0x80: %u cycles/call\n", int80);
+    
+    if (syscall_use_sysenter()) {
+        syscall_sysenter(SYS_GETPID, 0, 0, 0, 0);
+        
+        t0 = rdtsc();
+        for (int i = 0; i < ITERATIONS; i++) {
+            syscall_sysenter(SYS_GETPID, 0, 0, 0, 0);
+        }
+        unsigned int fast = per_call(rdtsc() - t0, ITERATIONS);
+        printf("  sysenter:  %u cycles/call\n", fast);
+        
+        if (fast) {
+            printf("  speedup:   %u.%u%ux\n", int80 / fast, (int80 * 10 / fast) % 10, (int80 * 100 / fast) % 10);
+        }
+    } else {
+        printf("  sysenter:  not supported by this CPU\n");
+    }
+    
+    // Data page read (volatile load, so the loop is not optimized away)
+    t0 = rdtsc();
+    for (int i = 0; i < ITERATIONS; i++) {
+        getpid();
+    }
+    printf("  data page: %u cycles/call\n", per_call(rdtsc() - t0, ITERATIONS));
+    
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include "../libc/stdio/stdio.h"
 #include "../libc/stdlib/stdlib.h"
 #include "../libc/sys/syscall.h"
+#include "../libc/time/time.h"
 
 // System information program
 // Displays system statistics
@@ -25,9 +26,11 @@ int main(int argc, char* argv[]) {
     printf("\nKernel Version:\n");
     printf("  Zenith OS v0.1\n");
     
-    // Uptime (would need time system calls)
+    // Uptime (read from the kernel data page, no system call)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
     printf("\nUptime:\n");
-    printf("  (Uptime requires RTC/time system calls)\n");
+    printf("  %u.%u seconds since boot\n", ts.tv_sec, ts.tv_nsec / 100000000);
     
     printf("\nNote: Some information requires additional kernel features.\n");
     printf("See FEATURE_GOALS.md for planned enhancements.\n");